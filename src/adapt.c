@@ -0,0 +1,486 @@
+/*
+Adaptive mesh refinement driven by a recovery based error estimator.
+
+Estimation (Zienkiewicz-Zhu): the mean strain (or temperature gradient)
+of each element is averaged to the nodes, weighted by element area, to
+give a smoothed field e* interpolated by the shape functions.  The error
+of an element is measured against the finite element strain e in the
+energy norm,
+     ||err||^2 = t*int (e* - e)^T D (e* - e) dA
+and the global relative error is eta = sqrt(E/(E + U)) where E is the
+sum of the element errors squared and U = t*int e^T D e dA.
+
+Refinement: an element is flagged when its error exceeds the mean error
+allowed by the target, target*sqrt((E + U)/nelements).  Flagged 4-node
+quadrilaterals are split into four through their edge midpoints and
+centre.  Refinement is closed so that every unrefined quadrilateral has
+at most one hanging edge, split only once; that quadrilateral is then
+split into three transition triangles through the hanging node.
+Transitions are merged back into their quadrilateral before the next
+refinement, so they are never refined themselves.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "lib/log.h"
+#include "lib/list.h"
+#include "lib/linalg.h"
+#include "mesh.h"
+#include "element_types.h"
+#include "bc_data.h"
+#include "model.h"
+#include "solver.h"
+#include "shape.h"
+#include "adapt.h"
+
+
+/***********************************************
+ * Error estimation
+ */
+
+
+static int estimated_element(int lib_id){
+  return lib_id == 3 || lib_id == 4 || lib_id == 6 || lib_id == 8 ||
+    lib_id == 13 || lib_id == 14 || lib_id == 16 || lib_id == 18;
+}
+
+
+static double* nodal_values(struct model* running_model){
+  // Solved or prescribed value of every node and dof
+  struct static_soln* sol = running_model->solution;
+  int nnodes = running_model->nodes->nitems, ndof = sol->ndof;
+  double* u = malloc(ndof*nnodes*sizeof(double));
+  int i, j, P;
+  for (i=0; i<nnodes; i++){
+    for (j=0; j<ndof; j++){
+      P = sol->ID->array[i][j];
+      if (P == -1)
+	u[ndof*i+j] = get_essential_bc(running_model->essential_bcs, i, j);
+      else
+	u[ndof*i+j] = sol->U->array[P];
+    }
+  }
+  return u;
+}
+
+
+static void strain(struct element* e, int nenodes, int ndof,
+		   struct matrix* NDERGLB, double* u, double* eps){
+  // eps = B*ue, {ex, ey, gxy} or the gradient {T,x, T,y}
+  double** dN = NDERGLB->array;
+  double* ua;
+  int a;
+  eps[0] = eps[1] = eps[2] = 0.0;
+  for (a=0; a<nenodes; a++){
+    ua = &u[ndof*e->IEN[a]];
+    if (ndof == 2){
+      eps[0] += dN[a][0]*ua[0];
+      eps[1] += dN[a][1]*ua[1];
+      eps[2] += dN[a][1]*ua[0] + dN[a][0]*ua[1];
+    }
+    else{
+      eps[0] += dN[a][0]*ua[0];
+      eps[1] += dN[a][1]*ua[0];
+    }
+  }
+}
+
+
+static double energy(struct matrix* D, double* eps){
+  // eps^T*D*eps
+  double sum = 0.0;
+  int i, j;
+  for (i=0; i<D->nrows; i++){
+    for (j=0; j<D->ncols; j++)
+      sum += eps[i]*D->array[i][j]*eps[j];
+  }
+  return sum;
+}
+
+
+static void free_matrix_list(struct list* l){
+  int i;
+  for (i=0; i<l->nitems; i++)
+    free_matrix(l->array[i]);
+  free_list(l);
+}
+
+
+static void free_vector_list(struct list* l){
+  int i;
+  for (i=0; i<l->nitems; i++)
+    free_vector(l->array[i]);
+  free_list(l);
+}
+
+
+static int et_index(struct list* et_defs, struct et_def* et){
+  int i;
+  for (i=0; i<et_defs->nitems && et_defs->array[i] != et; i++);
+  return i;
+}
+
+
+double estimate_error(struct model* running_model, double* errors){
+  // Returns the relative error eta and each element's error norm,
+  // or -1 if an element has no estimate
+  struct list* nodes = running_model->nodes;
+  struct list* elements = running_model->elements;
+  struct list* et_defs = running_model->et_defs;
+  int nnodes = nodes->nitems, ne = elements->nitems;
+  struct element* e;
+  struct et_def* et;
+  int i, j, k, a, n;
+  for (i=0; i<ne; i++){
+    e = elements->array[i];
+    et = get_et_def(et_defs, e->et_id);
+    if (!estimated_element(et->lib_id)){
+      lprintf("Error: No error estimate for library id %d\n", et->lib_id);
+      return -1.0;
+    }
+  }
+  int ndof = running_model->solution->ndof, ns = ndof == 2 ? 3 : 2;
+  double* u = nodal_values(running_model);
+  double* rec = calloc(3*nnodes, sizeof(double));
+  double* weight = calloc(nnodes, sizeof(double));
+  struct list** Ns = calloc(et_defs->nitems, sizeof(struct list*));
+  double eps[3], mean[3], diff[3], w, A, E = 0.0, U = 0.0, err;
+  struct list *NDERGLBs, *Nk;
+  struct matrix* COORDS;
+  double* N;
+
+  // Element mean strains averaged to the nodes
+  for (i=0; i<ne; i++){
+    e = elements->array[i];
+    et = get_et_def(et_defs, e->et_id);
+    COORDS = construct_COORDS(nodes, e->IEN, et->nenodes);
+    NDERGLBs = construct_NDERGLBs(COORDS, et->sdata->NDERNATs,
+				  et->sdata->nint_pts);
+    A = mean[0] = mean[1] = mean[2] = 0.0;
+    for (k=0; k<et->sdata->nint_pts; k++){
+      w = et->sdata->int_wts[k]*
+	fabs(jacobian(COORDS, et->sdata->NDERNATs->array[k]));
+      strain(e, et->nenodes, ndof, NDERGLBs->array[k], u, eps);
+      for (j=0; j<ns; j++)
+	mean[j] += w*eps[j];
+      A += w;
+    }
+    for (a=0; a<et->nenodes; a++){
+      n = e->IEN[a];
+      for (j=0; j<ns; j++)
+	rec[3*n+j] += mean[j];
+      weight[n] += A;
+    }
+    free_matrix(COORDS), free_matrix_list(NDERGLBs);
+  }
+  for (n=0; n<nnodes; n++){
+    for (j=0; j<ns && weight[n] > 0.0; j++)
+      rec[3*n+j] /= weight[n];
+  }
+
+  // Element errors against the recovered field
+  for (i=0; i<ne; i++){
+    e = elements->array[i];
+    et = get_et_def(et_defs, e->et_id);
+    k = et_index(et_defs, et);
+    if (Ns[k] == NULL)
+      Ns[k] = construct_Ns(et);
+    Nk = Ns[k];
+    COORDS = construct_COORDS(nodes, e->IEN, et->nenodes);
+    NDERGLBs = construct_NDERGLBs(COORDS, et->sdata->NDERNATs,
+				  et->sdata->nint_pts);
+    err = 0.0;
+    for (k=0; k<et->sdata->nint_pts; k++){
+      w = et->consts[1]*et->sdata->int_wts[k]*
+	fabs(jacobian(COORDS, et->sdata->NDERNATs->array[k]));
+      strain(e, et->nenodes, ndof, NDERGLBs->array[k], u, eps);
+      N = ((struct vector*) Nk->array[k])->array;
+      for (j=0; j<ns; j++){
+	diff[j] = -eps[j];
+	for (a=0; a<et->nenodes; a++)
+	  diff[j] += N[a]*rec[3*e->IEN[a]+j];
+      }
+      err += w*energy(et->sdata->D, diff);
+      U += w*energy(et->sdata->D, eps);
+    }
+    errors[i] = sqrt(err);
+    E += err;
+    free_matrix(COORDS), free_matrix_list(NDERGLBs);
+  }
+
+  for (k=0; k<et_defs->nitems; k++){
+    if (Ns[k] != NULL)
+      free_vector_list(Ns[k]);
+  }
+  free(Ns), free(u), free(rec), free(weight);
+  return E + U > 0.0 ? sqrt(E/(E + U)) : 0.0;
+}
+
+
+/***********************************************
+ * Refinement
+ */
+
+
+static int edge_midpoint(struct model* running_model, int a, int b, int ndof){
+  // Node at the midpoint of edge (a, b), created on first use.  A new
+  // node takes the mean prescribed value of dofs constrained at both ends.
+  struct list* bcs = running_model->essential_bcs;
+  int mid = get_edge_node(running_model->midnodes, a, b);
+  struct node *na, *nb;
+  struct essential_bc* ebc;
+  int j;
+  if (mid != -1)
+    return mid;
+  na = running_model->nodes->array[a];
+  nb = running_model->nodes->array[b];
+  new_model_node(running_model, 0.5*(na->x + nb->x), 0.5*(na->y + nb->y));
+  mid = running_model->nodes->nitems-1;
+  set_edge_node(running_model->midnodes, a, b, mid);
+  for (j=0; j<ndof; j++){
+    if (is_constrained(bcs, a, j) && is_constrained(bcs, b, j)){
+      ebc = new_essential_bc(mid, j, 0.5*(get_essential_bc(bcs, a, j) +
+					  get_essential_bc(bcs, b, j)));
+      append(bcs, ebc);
+      print_essential_bc(ebc);
+    }
+  }
+  return mid;
+}
+
+
+static int hanging_edges(struct model* running_model, int* IEN, int* edge,
+			 int* deep){
+  // Counts the edges of an unrefined quadrilateral split by a neighbour.
+  // edge receives the last one, and deep is set if a neighbour split
+  // one of them again.
+  struct edge_map* map = running_model->midnodes;
+  int k, a, b, mid, h = 0;
+  *deep = 0;
+  for (k=0; k<4; k++){
+    a = IEN[k], b = IEN[(k+1)%4];
+    mid = get_edge_node(map, a, b);
+    if (mid != -1){
+      h++, *edge = k;
+      if (get_edge_node(map, a, mid) != -1 || get_edge_node(map, mid, b) != -1)
+	*deep = 1;
+    }
+  }
+  return h;
+}
+
+
+static int transition_et(struct model* running_model, struct et_def* quad){
+  // Finds or creates the linear triangle type with the properties of a
+  // quadrilateral type
+  struct list* et_defs = running_model->et_defs;
+  struct et_def* et;
+  char type_name[8];
+  int i, lib_id = quad->lib_id == 4 ? 3 : 13, user_id = 0;
+  for (i=0; i<et_defs->nitems; i++){
+    et = et_defs->array[i];
+    if (et->lib_id == lib_id && et->opts[1] == quad->opts[1] &&
+	memcmp(et->consts, quad->consts, sizeof(quad->consts)) == 0 &&
+	memcmp(et->mprops, quad->mprops, sizeof(struct matprops)) == 0)
+      return et->user_id;
+    if (et->user_id >= user_id)
+      user_id = et->user_id+1;
+  }
+  strcpy(type_name, lib_id == 3 ? "SPLANE3" : "TPLANE3");
+  new_model_element_type(running_model, user_id, type_name);
+  et = get_et_def(et_defs, user_id);
+  memcpy(et->consts, quad->consts, sizeof(quad->consts));
+  memcpy(et->opts, quad->opts, sizeof(quad->opts));
+  memcpy(et->mprops, quad->mprops, sizeof(struct matprops));
+  return user_id;
+}
+
+
+static void append_element(struct list* elements, int et_id,
+			   int n0, int n1, int n2, int n3, int nenodes){
+  int* IEN = malloc(nenodes*sizeof(int));
+  IEN[0] = n0, IEN[1] = n1, IEN[2] = n2;
+  if (nenodes == 4)
+    IEN[3] = n3;
+  append(elements, new_element(et_id, IEN));
+}
+
+
+static void refine_mesh(struct model* running_model, int* flags){
+  struct list* elements = running_model->elements;
+  struct list* transitions = running_model->transitions;
+  struct list* refined = new_list();
+  int ne = elements->nitems, nq = 0;
+  int (*IEN)[4] = malloc(ne*sizeof(*IEN));
+  int* et_id = malloc(ne*sizeof(int));
+  int* refine = calloc(ne, sizeof(int));
+  int* split = calloc(ne, sizeof(int));
+  int i, k, q, t = 0, changed, h, edge, deep, ndof, mid[4], c, tri_id;
+  struct transition* tr;
+  struct element* e;
+  struct et_def* et;
+  struct node* n;
+  double x, y;
+
+  // The quadrilaterals, with transitions merged back
+  for (i=0; i<ne; nq++){
+    tr = t < transitions->nitems ? transitions->array[t] : NULL;
+    if (tr != NULL && tr->first == i){
+      memcpy(IEN[nq], tr->IEN, sizeof(tr->IEN));
+      et_id[nq] = tr->et_id;
+      refine[nq] = flags[i] || flags[i+1] || flags[i+2];
+      i += 3, t++;
+      continue;
+    }
+    e = elements->array[i];
+    memcpy(IEN[nq], e->IEN, sizeof(IEN[nq]));
+    et_id[nq] = e->et_id;
+    refine[nq] = flags[i];
+    i++;
+  }
+
+  // Close the refinement: a quadrilateral with two hanging edges, or an
+  // edge split twice, is refined too
+  do{
+    changed = 0;
+    for (q=0; q<nq; q++){
+      if (refine[q] && !split[q]){
+	ndof = get_et_def(running_model->et_defs, et_id[q])->ndof;
+	for (k=0; k<4; k++)
+	  edge_midpoint(running_model, IEN[q][k], IEN[q][(k+1)%4], ndof);
+	split[q] = 1;
+      }
+    }
+    for (q=0; q<nq; q++){
+      if (!refine[q] &&
+	  (hanging_edges(running_model, IEN[q], &edge, &deep) > 1 || deep))
+	refine[q] = changed = 1;
+    }
+  } while (changed);
+
+  // Rebuild the element list
+  free_items(transitions, free);
+  free_list(transitions);
+  transitions = running_model->transitions = new_list();
+  for (q=0; q<nq; q++){
+    et = get_et_def(running_model->et_defs, et_id[q]);
+    h = hanging_edges(running_model, IEN[q], &edge, &deep);
+    if (refine[q]){
+      for (k=0; k<4; k++)
+	mid[k] = get_edge_node(running_model->midnodes, IEN[q][k],
+			       IEN[q][(k+1)%4]);
+      x = y = 0.0;
+      for (k=0; k<4; k++){
+	n = running_model->nodes->array[IEN[q][k]];
+	x += 0.25*n->x, y += 0.25*n->y;
+      }
+      new_model_node(running_model, x, y);
+      c = running_model->nodes->nitems-1;
+      append_element(refined, et_id[q], IEN[q][0], mid[0], c, mid[3], 4);
+      append_element(refined, et_id[q], mid[0], IEN[q][1], mid[1], c, 4);
+      append_element(refined, et_id[q], c, mid[1], IEN[q][2], mid[2], 4);
+      append_element(refined, et_id[q], mid[3], c, mid[2], IEN[q][3], 4);
+    }
+    else if (h == 1){
+      // Corners n0..n3 starting at the hanging edge n0-n1
+      int n0 = IEN[q][edge], n1 = IEN[q][(edge+1)%4];
+      int n2 = IEN[q][(edge+2)%4], n3 = IEN[q][(edge+3)%4];
+      int m = get_edge_node(running_model->midnodes, n0, n1);
+      tr = malloc(sizeof(struct transition));
+      tr->first = refined->nitems;
+      tr->et_id = et_id[q];
+      memcpy(tr->IEN, IEN[q], sizeof(tr->IEN));
+      append(transitions, tr);
+      tri_id = transition_et(running_model, et);
+      append_element(refined, tri_id, n0, m, n3, -1, 3);
+      append_element(refined, tri_id, m, n1, n2, -1, 3);
+      append_element(refined, tri_id, m, n2, n3, -1, 3);
+    }
+    else
+      append_element(refined, et_id[q], IEN[q][0], IEN[q][1], IEN[q][2],
+		     IEN[q][3], 4);
+  }
+  free_items(elements, free_element);
+  free_list(elements);
+  running_model->elements = refined;
+  free(IEN), free(et_id), free(refine), free(split);
+}
+
+
+/***********************************************
+ * Adaptive solution
+ */
+
+
+static int refinable_mesh(struct model* running_model){
+  // Every element outside the transition groups is a 4-node quadrilateral
+  struct list* transitions = running_model->transitions;
+  struct transition* tr;
+  struct element* e;
+  struct et_def* et;
+  int i, t = 0;
+  for (i=0; i<running_model->elements->nitems; i++){
+    tr = t < transitions->nitems ? transitions->array[t] : NULL;
+    if (tr != NULL && tr->first == i){
+      i += 2, t++;
+      continue;
+    }
+    e = running_model->elements->array[i];
+    et = get_et_def(running_model->et_defs, e->et_id);
+    if (et->lib_id != 4 && et->lib_id != 14){
+      lprintf("Error: Adaptive refinement needs 4-node quadrilaterals, "
+	     "element %d has library id %d\n", i, et->lib_id);
+      return 0;
+    }
+  }
+  return 1;
+}
+
+
+int adaptive_solve(struct model* running_model, double target,
+		   int max_cycles, int s_type){
+  // Solves and refines until the estimated relative error is at most
+  // target, or max_cycles refinements have been made.  Returns 1 if the
+  // mesh cannot be refined or a solve fails.
+  double *errors, eta, allowed, E;
+  int *flags, cycle, i, ne, nflagged;
+  if (!refinable_mesh(running_model))
+    return 1;
+  for (cycle=0; ; cycle++){
+    if (solve_model(running_model, 0, s_type) != 0)
+      return 1;
+    ne = running_model->elements->nitems;
+    errors = malloc(ne*sizeof(double));
+    eta = estimate_error(running_model, errors);
+    if (eta < 0.0){
+      free(errors);
+      return 1;
+    }
+    lprintf("Adaptive cycle %d: %d nodes, %d elements, %d equations, "
+	   "estimated error %.4g%%\n", cycle, running_model->nodes->nitems,
+	   ne, running_model->free_dof, 100.0*eta);
+    if (eta <= target){
+      lprintf("Target error of %g%% reached\n", 100.0*target);
+      free(errors);
+      return 0;
+    }
+    if (cycle == max_cycles){
+      lprintf("Target error of %g%% not reached after %d refinements\n",
+	     100.0*target, max_cycles);
+      free(errors);
+      return 0;
+    }
+    // Mean error allowed per element, target*sqrt((E + U)/ne)
+    for (E=0.0, i=0; i<ne; i++)
+      E += errors[i]*errors[i];
+    allowed = target*sqrt(E/(eta*eta)/ne);
+    flags = malloc(ne*sizeof(int));
+    for (nflagged=0, i=0; i<ne; i++)
+      nflagged += flags[i] = errors[i] > allowed;
+    lprintf("Refining %d of %d elements\n", nflagged, ne);
+    refine_mesh(running_model, flags);
+    free(errors), free(flags);
+  }
+}
@@ -0,0 +1,21 @@
+/*
+Adaptive mesh refinement.  The model is solved, the error of each
+element is estimated by Zienkiewicz-Zhu strain recovery, and flagged
+4-node quadrilaterals are split into four until the estimated global
+error reaches the target.  Quadrilaterals left with a single hanging
+edge are split into three transition triangles to keep the mesh
+conforming.
+*/
+
+// Three transition triangles standing in for an unrefined quadrilateral.
+// They are merged back into the quadrilateral before each refinement.
+struct transition{
+  int first;    // Element index of the first of the three triangles
+  int et_id;    // Type of the quadrilateral
+  int IEN[4];   // Nodes of the quadrilateral
+};
+
+
+double estimate_error(struct model* running_model, double* errors);
+int adaptive_solve(struct model* running_model, double target,
+		   int max_cycles, int s_type);
@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "lib/log.h"
+#include "lib/list.h"
+#include "model.h"
+#include "mesh.h"
+#include "element_types.h"
+#include "interpreter.h"
+#include "ke_batch.h"
+#include "batch.h"
+
+
+#define MAXLINE 1000
+
+
+struct batch{
+  struct list* scripts;
+  int next;             // Next job to hand out
+  int failed;
+  pthread_mutex_t lock;
+};
+
+
+static struct list* read_manifest(FILE* file){
+  struct list* scripts = new_list();
+  char line[MAXLINE];
+  char *start, *end, *script;
+  while (fgets(line, MAXLINE, file) != NULL){
+    start = line + strspn(line, " \t");
+    end = start + strcspn(start, "\r\n");
+    while (end > start && (end[-1] == ' ' || end[-1] == '\t'))
+      end--;
+    if (end == start || *start == '!')
+      continue;
+    script = malloc(end-start+1);
+    memcpy(script, start, end-start);
+    script[end-start] = '\0';
+    append(scripts, script);
+  }
+  return scripts;
+}
+
+
+static char* log_name(char* script){
+  // script.txt -> script.log, keeping any directory
+  char* name = malloc(strlen(script)+5);
+  char* dot = strrchr(script, '.');
+  char* slash = strrchr(script, '/');
+  int n = dot != NULL && (slash == NULL || dot > slash) ?
+    dot-script : strlen(script);
+  memcpy(name, script, n);
+  strcpy(name+n, ".log");
+  return name;
+}
+
+
+static int run_job(char* script){
+  // Returns 0 if the script ran to its end
+  char* log_file = log_name(script);
+  FILE *script_file, *log;
+  int status;
+  script_file = fopen(script, "r");
+  log = script_file != NULL ? fopen(log_file, "w") : NULL;
+  if (script_file == NULL || log == NULL){
+    lprintf("Error: Could not open %s\n",
+	    script_file == NULL ? script : log_file);
+    if (script_file != NULL)
+      fclose(script_file);
+    if (log != NULL)
+      fclose(log);
+    free(log_file);
+    return 1;
+  }
+  // Line buffered, so the log keeps the reason if the process dies
+  setvbuf(log, NULL, _IOLBF, 0);
+  set_log_stream(log);
+  status = run_script(new_model(), script_file);
+  set_log_stream(NULL);
+  fclose(log);
+  fclose(script_file);
+  lprintf("%s %s, log in %s\n", script, status == 0 ? "finished" : "failed",
+	  log_file);
+  free(log_file);
+  return status;
+}
+
+
+static void* batch_worker(void* arg){
+  struct batch* b = arg;
+  int job;
+  while (1){
+    pthread_mutex_lock(&b->lock);
+    job = b->next++;
+    pthread_mutex_unlock(&b->lock);
+    if (job >= b->scripts->nitems)
+      break;
+    if (run_job(b->scripts->array[job]) != 0){
+      pthread_mutex_lock(&b->lock);
+      b->failed++;
+      pthread_mutex_unlock(&b->lock);
+    }
+  }
+  return NULL;
+}
+
+
+int run_batch(char* manifest, int nworkers){
+  // Returns the number of scripts that failed.  nworkers = 0 uses one
+  // worker per online processor.
+  struct batch b;
+  pthread_t* workers;
+  int i, started;
+  FILE* file = fopen(manifest, "r");
+  if (file == NULL){
+    lprintf("Error: Could not open manifest %s\n", manifest);
+    return 1;
+  }
+  b.scripts = read_manifest(file);
+  fclose(file);
+  b.next = 0;
+  b.failed = 0;
+  pthread_mutex_init(&b.lock, NULL);
+  if (nworkers <= 0)
+    nworkers = sysconf(_SC_NPROCESSORS_ONLN);
+  if (nworkers > b.scripts->nitems)
+    nworkers = b.scripts->nitems;
+  if (nworkers < 1)
+    nworkers = 1;
+  lprintf("Running %d scripts on %d workers\n", b.scripts->nitems, nworkers);
+  // Detected once here rather than raced for by the first assemblies
+  ke_batch_width();
+  workers = malloc(nworkers*sizeof(pthread_t));
+  for (started=0; started<nworkers; started++){
+    if (pthread_create(&workers[started], NULL, batch_worker, &b) != 0)
+      break;
+  }
+  if (started == 0)
+    batch_worker(&b);  // No threads to be had, run the jobs here
+  for (i=0; i<started; i++)
+    pthread_join(workers[i], NULL);
+  lprintf("%d of %d scripts failed\n", b.failed, b.scripts->nitems);
+  free(workers);
+  pthread_mutex_destroy(&b.lock);
+  free_items(b.scripts, free);
+  free_list(b.scripts);
+  return b.failed;
+}
@@ -0,0 +1,10 @@
+/*
+Batch mode.  A manifest lists script files, one per line, with blank
+lines and lines starting with ! skipped.  Each script is run on its own
+model by a pool of worker threads in this process, and its output goes
+to a log beside it with the extension replaced by .log.  Result files
+are those the scripts name themselves.  A script that fails stops at
+the failing line, and the others run on.
+*/
+
+int run_batch(char* manifest, int nworkers);
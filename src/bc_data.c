@@ -1,5 +1,6 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include "lib/log.h"
 #include "lib/list.h"
 #include "bc_data.h"
 
@@ -23,6 +24,7 @@ struct nodal_force* new_nodal_force(int node_id, int dof, double value){
 
 
 double get_essential_bc(struct list* essential_bcs, int node_id, int dof){
+  // 0.0 on a free dof, like get_nodal_force on an unloaded one
   int i;
   struct essential_bc* ebc;
   for (i=0; i<essential_bcs->nitems; i++){
@@ -30,9 +32,7 @@ double get_essential_bc(struct list* essential_bcs, int node_id, int dof){
     if (ebc->node_id == node_id && ebc->dof == dof)
       return ebc->value;
   }
-  printf("Error: No boundary condition found for node %d at dof %d\n",
-	 node_id, dof);
-  exit(1);
+  return 0.0;
 }
 
 
@@ -49,13 +49,13 @@ double get_nodal_force(struct list* nodal_forces, int node_id, int dof){
 
 
 void print_essential_bc(struct essential_bc* ebc){
-  printf("Essential boundary condition: Node=%d, Dof=%d, Value=%g\n",
+  lprintf("Essential boundary condition: Node=%d, Dof=%d, Value=%g\n",
 	 ebc->node_id, ebc->dof, ebc->value);
 }
 
 
 void print_nodal_force(struct nodal_force* ndf){
-  printf("Nodal force: Node=%d, Dof=%d, Value=%g\n",
+  lprintf("Nodal force: Node=%d, Dof=%d, Value=%g\n",
 	 ndf->node_id, ndf->dof, ndf->value);
 }
 
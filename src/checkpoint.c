@@ -0,0 +1,310 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "lib/log.h"
+#include "lib/list.h"
+#include "lib/linalg.h"
+#include "lib/outbuf.h"
+#include "model.h"
+#include "mesh.h"
+#include "element_types.h"
+#include "bc_data.h"
+#include "solver.h"
+#include "adapt.h"
+#include "checkpoint.h"
+
+
+#define NHEADER 10    // int32 header fields after the magic
+#define NREALS 15     // Doubles per type definition
+#define NINTS 12      // int32 per type definition
+#define HEADER_SIZE (8 + NHEADER*sizeof(int32_t))
+
+static const char magic[8] = "FEACHK1";
+
+
+/***********************************************
+ * Writing
+ */
+
+
+static void write_int(struct outbuf* ob, int value){
+  int32_t v = value;
+  outbuf_write(ob, &v, sizeof(int32_t));
+}
+
+
+int write_checkpoint(struct model* running_model, char* filename){
+  struct static_soln* sol = running_model->solution;
+  struct list* et_defs = running_model->et_defs;
+  struct list* elements = running_model->elements;
+  struct list* ebcs = running_model->essential_bcs;
+  struct list* forces = running_model->nodal_forces;
+  struct list* transitions = running_model->transitions;
+  int nnodes = running_model->nodes->nitems, ndof = sol->ndof;
+  int free_dof = sol->U->n, factored = sol->LU != NULL, nconn = 0;
+  struct node* n;
+  struct element* e;
+  struct et_def* et;
+  struct essential_bc* ebc;
+  struct nodal_force* ndf;
+  struct transition* tr;
+  struct outbuf* ob;
+  FILE* file;
+  double reals[NREALS];
+  size_t nbytes;
+  int i, j, status;
+  if (running_model->superelements->nitems > 0){
+    lprintf("Error: Superelement models cannot be checkpointed\n");
+    return 1;
+  }
+  for (i=0; i<elements->nitems; i++){
+    e = elements->array[i];
+    nconn += get_et_def(et_defs, e->et_id)->nenodes;
+  }
+  file = fopen(filename, "wb");
+  if (file == NULL){
+    lprintf("Error: Could not open %s\n", filename);
+    return 1;
+  }
+  ob = new_outbuf(file);
+  outbuf_write(ob, magic, sizeof(magic));
+  write_int(ob, ndof), write_int(ob, nnodes);
+  write_int(ob, elements->nitems), write_int(ob, et_defs->nitems);
+  write_int(ob, ebcs->nitems), write_int(ob, forces->nitems);
+  write_int(ob, transitions->nitems), write_int(ob, free_dof);
+  write_int(ob, factored), write_int(ob, nconn);
+  for (i=0; i<nnodes; i++){
+    n = running_model->nodes->array[i];
+    outbuf_write(ob, &n->x, sizeof(double));
+    outbuf_write(ob, &n->y, sizeof(double));
+  }
+  for (i=0; i<et_defs->nitems; i++){
+    et = et_defs->array[i];
+    memcpy(reals, et->consts, 10*sizeof(double));
+    reals[10] = et->mprops->E, reals[11] = et->mprops->v;
+    reals[12] = et->mprops->K, reals[13] = et->mprops->SY;
+    reals[14] = et->mprops->H;
+    outbuf_write(ob, reals, NREALS*sizeof(double));
+  }
+  for (i=0; i<ebcs->nitems; i++){
+    ebc = ebcs->array[i];
+    outbuf_write(ob, &ebc->value, sizeof(double));
+  }
+  for (i=0; i<forces->nitems; i++){
+    ndf = forces->array[i];
+    outbuf_write(ob, &ndf->value, sizeof(double));
+  }
+  outbuf_write(ob, sol->U->array, free_dof*sizeof(double));
+  if (factored){
+    outbuf_write(ob, sol->F0->array, free_dof*sizeof(double));
+    for (i=0; i<free_dof; i++)
+      outbuf_write(ob, sol->LU->array[i], free_dof*sizeof(double));
+  }
+  for (i=0; i<et_defs->nitems; i++){
+    et = et_defs->array[i];
+    write_int(ob, et->user_id), write_int(ob, et->lib_id);
+    for (j=0; j<10; j++)
+      write_int(ob, et->opts[j]);
+  }
+  for (i=0; i<elements->nitems; i++){
+    e = elements->array[i];
+    write_int(ob, e->et_id);
+  }
+  for (i=0; i<elements->nitems; i++){
+    e = elements->array[i];
+    et = get_et_def(et_defs, e->et_id);
+    for (j=0; j<et->nenodes; j++)
+      write_int(ob, e->IEN[j]);
+  }
+  for (i=0; i<ebcs->nitems; i++){
+    ebc = ebcs->array[i];
+    write_int(ob, ebc->node_id), write_int(ob, ebc->dof);
+  }
+  for (i=0; i<forces->nitems; i++){
+    ndf = forces->array[i];
+    write_int(ob, ndf->node_id), write_int(ob, ndf->dof);
+  }
+  for (i=0; i<transitions->nitems; i++){
+    tr = transitions->array[i];
+    write_int(ob, tr->first), write_int(ob, tr->et_id);
+    for (j=0; j<4; j++)
+      write_int(ob, tr->IEN[j]);
+  }
+  for (i=0; i<nnodes; i++){
+    for (j=0; j<ndof; j++)
+      write_int(ob, sol->ID->array[i][j]);
+  }
+  outbuf_flush(ob);
+  status = ob->error;
+  nbytes = ob->written;
+  free_outbuf(ob);
+  status |= ferror(file) != 0;
+  status |= fclose(file) != 0;
+  if (status){
+    lprintf("Error: Writing %s failed, the checkpoint is incomplete\n",
+	    filename);
+    return 1;
+  }
+  lprintf("Wrote %zu bytes to %s\n", nbytes, filename);
+  return 0;
+}
+
+
+/***********************************************
+ * Reading
+ */
+
+
+static void* take(char** cursor, size_t size){
+  void* p = *cursor;
+  *cursor += size;
+  return p;
+}
+
+
+static struct vector* mapped_vector(double* values, int n){
+  struct vector* v = malloc(sizeof(struct vector));
+  v->array = values;
+  v->n = n;
+  return v;
+}
+
+
+static struct matrix* mapped_matrix(double* values, int n){
+  // Square row major matrix whose rows point into the mapping
+  struct matrix* A = malloc(sizeof(struct matrix));
+  int i;
+  A->array = malloc(n*sizeof(double*));
+  for (i=0; i<n; i++)
+    A->array[i] = values + (size_t) i*n;
+  A->nrows = A->ncols = n;
+  return A;
+}
+
+
+int read_checkpoint(struct model* running_model, char* filename){
+  // Fills an empty model.  The solution keeps the file mapped.
+  struct stat st;
+  struct static_soln* sol;
+  struct et_def* et;
+  struct element* e;
+  struct transition* tr;
+  struct matrix* ID;
+  int32_t h[NHEADER], *ints, *types, *conn;
+  double *xy, *reals, *values, *U, *F0 = NULL, *LU = NULL;
+  int ndof, nnodes, nelems, net_defs, nebcs, nforces, ntransitions;
+  int free_dof, factored, nconn, nc, i, j, k;
+  size_t expected;
+  char *map, *cursor;
+  int fd = open(filename, O_RDONLY);
+  if (fd == -1 || fstat(fd, &st) != 0 || st.st_size < HEADER_SIZE){
+    lprintf("Error: Could not read checkpoint %s\n", filename);
+    if (fd != -1)
+      close(fd);
+    return 1;
+  }
+  // Private and writable, so later load cases can overwrite U in place
+  map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED){
+    lprintf("Error: Could not map checkpoint %s\n", filename);
+    return 1;
+  }
+  memcpy(h, map + sizeof(magic), sizeof(h));
+  ndof = h[0], nnodes = h[1], nelems = h[2], net_defs = h[3];
+  nebcs = h[4], nforces = h[5], ntransitions = h[6], free_dof = h[7];
+  factored = h[8], nconn = h[9];
+  expected = 0;
+  if (memcmp(map, magic, sizeof(magic)) == 0)
+    expected = HEADER_SIZE +
+      sizeof(double)*(2*(size_t) nnodes + NREALS*(size_t) net_defs +
+		      (size_t) nebcs + nforces +
+		      (size_t) free_dof*(factored ? free_dof+2 : 1)) +
+      sizeof(int32_t)*(NINTS*(size_t) net_defs + nelems + nconn +
+		       2*(size_t) nebcs + 2*(size_t) nforces +
+		       6*(size_t) ntransitions + (size_t) nnodes*ndof);
+  if (expected != st.st_size){
+    lprintf("Error: %s is not a valid checkpoint\n", filename);
+    munmap(map, st.st_size);
+    return 1;
+  }
+  cursor = map + HEADER_SIZE;
+  xy = take(&cursor, 2*nnodes*sizeof(double));
+  reals = take(&cursor, NREALS*net_defs*sizeof(double));
+  values = take(&cursor, (nebcs + nforces)*sizeof(double));
+  U = take(&cursor, free_dof*sizeof(double));
+  if (factored){
+    F0 = take(&cursor, free_dof*sizeof(double));
+    LU = take(&cursor, (size_t) free_dof*free_dof*sizeof(double));
+  }
+  ints = take(&cursor, NINTS*net_defs*sizeof(int32_t));
+  types = take(&cursor, nelems*sizeof(int32_t));
+  conn = take(&cursor, nconn*sizeof(int32_t));
+
+  for (i=0; i<nnodes; i++)
+    append(running_model->nodes, new_node(xy[2*i], xy[2*i+1]));
+  for (i=0; i<net_defs; i++, reals += NREALS, ints += NINTS){
+    et = new_et_def(ints[0], (char*) get_type_name(ints[1]));
+    for (j=0; j<10; j++)
+      et->opts[j] = ints[2+j];
+    memcpy(et->consts, reals, 10*sizeof(double));
+    et->mprops->E = reals[10], et->mprops->v = reals[11];
+    et->mprops->K = reals[12], et->mprops->SY = reals[13];
+    et->mprops->H = reals[14];
+    append(running_model->et_defs, et);
+  }
+  for (i=0; i<nelems; i++){
+    et = get_et_def(running_model->et_defs, types[i]);
+    e = new_element(types[i], malloc(et->nenodes*sizeof(int)));
+    for (j=0; j<et->nenodes; j++)
+      e->IEN[j] = *conn++;
+    if (quadratic_element(et->lib_id)){
+      // Shared midside nodes for elements added after the restart
+      nc = et->nenodes/2;
+      for (k=0; k<nc; k++)
+	set_edge_node(running_model->midnodes, e->IEN[k],
+		      e->IEN[(k+1)%nc], e->IEN[nc+k]);
+    }
+    append(running_model->elements, e);
+  }
+  ints = take(&cursor, 2*nebcs*sizeof(int32_t));
+  for (i=0; i<nebcs; i++)
+    append(running_model->essential_bcs,
+	   new_essential_bc(ints[2*i], ints[2*i+1], values[i]));
+  ints = take(&cursor, 2*nforces*sizeof(int32_t));
+  for (i=0; i<nforces; i++)
+    append(running_model->nodal_forces,
+	   new_nodal_force(ints[2*i], ints[2*i+1], values[nebcs+i]));
+  ints = take(&cursor, 6*ntransitions*sizeof(int32_t));
+  for (i=0; i<ntransitions; i++, ints += 6){
+    tr = malloc(sizeof(struct transition));
+    tr->first = ints[0], tr->et_id = ints[1];
+    memcpy(tr->IEN, ints+2, 4*sizeof(int));
+    append(running_model->transitions, tr);
+  }
+  ints = take(&cursor, nnodes*ndof*sizeof(int32_t));
+  ID = new_matrix(nnodes, ndof);
+  for (i=0; i<nnodes; i++){
+    for (j=0; j<ndof; j++)
+      ID->array[i][j] = ints[ndof*i+j];
+  }
+
+  sol = new_static_soln(ndof, ID, mapped_vector(U, free_dof));
+  if (factored){
+    sol->LU = mapped_matrix(LU, free_dof);
+    sol->F0 = mapped_vector(F0, free_dof);
+  }
+  number_constrained_dof(sol, running_model->essential_bcs);
+  sol->map = map;
+  sol->map_size = st.st_size;
+  running_model->solution = sol;
+  lprintf("Read %d nodes, %d elements and %d equations from %s%s\n",
+	 nnodes, nelems, free_dof, filename,
+	 factored ? " with factors" : "");
+  return 0;
+}
@@ -0,0 +1,34 @@
+/*
+Checkpoint files.  A solved model is saved to a single file with its
+mesh, type definitions, boundary conditions, ID map and solution, and
+for the dense direct solver the LU factors of the free dof stiffness
+with the load due to the prescribed values.  On restart the file is
+memory mapped and the solution vector and factors are used in place, so
+post-processing and new load cases need no assembly or factorization.
+
+All values in host byte order, doubles first so they stay aligned in
+the mapping:
+    char    magic[8]                "FEACHK1"
+    int32   ndof, nnodes, nelems, net_defs, nebcs, nforces,
+            ntransitions, free_dof, factored, nconn
+    double  xy[2*nnodes]
+    double  et_reals[15*net_defs]   consts[10], E, v, K, SY, H
+    double  ebc_values[nebcs]
+    double  force_values[nforces]
+    double  U[free_dof]
+    double  F0[free_dof]            Only if factored
+    double  LU[free_dof*free_dof]   Only if factored, row major
+    int32   et_ints[12*net_defs]    user_id, lib_id, opts[10]
+    int32   elem_types[nelems]
+    int32   conn[nconn]             Element nodes in element order
+    int32   ebcs[2*nebcs]           node, dof
+    int32   forces[2*nforces]       node, dof
+    int32   transitions[6*ntransitions]
+    int32   ID[nnodes*ndof]
+
+Superelement models cannot be saved.  The history variables of a
+nonlinear solution are not saved either, only its displacements.
+*/
+
+int write_checkpoint(struct model* running_model, char* filename);
+int read_checkpoint(struct model* running_model, char* filename);
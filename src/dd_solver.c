@@ -0,0 +1,636 @@
+/*
+Iterative substructuring on a single host.
+
+The elements are split into nsub subdomains by recursive coordinate
+bisection.  Nodes touched by more than one subdomain form the interface.
+Each subdomain p is handled by a forked worker that assembles
+
+     K(p) = | KII  KIG |     f(p) = | fI |
+            | KGI  KGG |            | fG |
+
+factors KII once, and then applies its local Schur complement
+     S(p) = KGG - KGI*inv(KII)*KIG
+on request.  The parent runs preconditioned conjugate gradients on the
+assembled interface problem
+     sum S(p) uG = sum (fG - KGI*inv(KII)*fI)
+and finally has every worker recover its interior displacements.
+
+Workers and parent share one anonymous memory mapping holding the
+interface vectors and the solution.  Commands and acknowledgements are
+single bytes sent over pipes.
+*/
+
+#define _GNU_SOURCE  // close_range
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "lib/log.h"
+#include "lib/list.h"
+#include "lib/linalg.h"
+#include "model.h"
+#include "mesh.h"
+#include "element_types.h"
+#include "bc_data.h"
+#include "stiffness.h"
+#include "solver.h"
+#include "shape.h"
+#include "superelement.h"
+#include "dd_solver.h"
+
+
+#define DD_TOL 1e-10
+#define DD_MAXITER 10000
+
+
+/***********************************************
+ * Partitioning
+ */
+
+
+struct keyed_index{
+  double key;
+  int index;
+};
+
+
+static int compare_keys(const void* a, const void* b){
+  double ka = ((struct keyed_index*) a)->key;
+  double kb = ((struct keyed_index*) b)->key;
+  return (ka > kb) - (ka < kb);
+}
+
+
+static void bisect(int* elems, int n, double** centroids, int nparts,
+		   int first_part, int* part){
+  // Recursive coordinate bisection along the longer extent
+  int i, axis, n1, nparts1;
+  if (nparts == 1 || n <= 1){
+    for (i=0; i<n; i++)
+      part[elems[i]] = first_part;
+    return;
+  }
+  double lo[2] = {INFINITY, INFINITY}, hi[2] = {-INFINITY, -INFINITY};
+  for (i=0; i<n; i++){
+    for (axis=0; axis<2; axis++){
+      if (centroids[elems[i]][axis] < lo[axis])
+	lo[axis] = centroids[elems[i]][axis];
+      if (centroids[elems[i]][axis] > hi[axis])
+	hi[axis] = centroids[elems[i]][axis];
+    }
+  }
+  axis = (hi[0]-lo[0] >= hi[1]-lo[1]) ? 0 : 1;
+  struct keyed_index* keys = malloc(n*sizeof(struct keyed_index));
+  for (i=0; i<n; i++){
+    keys[i].key = centroids[elems[i]][axis];
+    keys[i].index = elems[i];
+  }
+  qsort(keys, n, sizeof(struct keyed_index), compare_keys);
+  for (i=0; i<n; i++)
+    elems[i] = keys[i].index;
+  free(keys);
+  nparts1 = nparts/2;
+  n1 = (int) ((long) n*nparts1/nparts);
+  bisect(elems, n1, centroids, nparts1, first_part, part);
+  bisect(elems+n1, n-n1, centroids, nparts-nparts1, first_part+nparts1, part);
+}
+
+
+static int* partition_elements(struct list* nodes, struct list* elements,
+			       struct list* et_defs, int nsub){
+  int i, j, ne = elements->nitems;
+  int* part = malloc(ne*sizeof(int));
+  int* elems = malloc(ne*sizeof(int));
+  double** centroids = malloc(ne*sizeof(double*));
+  struct element* e;
+  struct et_def* et;
+  struct node* n;
+  for (i=0; i<ne; i++){
+    e = elements->array[i];
+    et = get_et_def(et_defs, e->et_id);
+    centroids[i] = calloc(2, sizeof(double));
+    for (j=0; j<et->nenodes; j++){
+      n = nodes->array[e->IEN[j]];
+      centroids[i][0] += n->x/et->nenodes;
+      centroids[i][1] += n->y/et->nenodes;
+    }
+    elems[i] = i;
+  }
+  bisect(elems, ne, centroids, nsub, 0, part);
+  for (i=0; i<ne; i++)
+    free(centroids[i]);
+  free(centroids), free(elems);
+  return part;
+}
+
+
+/***********************************************
+ * Subdomain workers
+ */
+
+
+struct dd_shared{
+  // Views into the memory shared by the parent and all workers
+  double* U;     // Solution, free_dof
+  double* x;     // Interface vector sent to the workers, nG
+  double* y;     // Per subdomain interface results, nsub*nG
+  double* rhs;   // Per subdomain condensed loads, nsub*nG
+  double* diag;  // Per subdomain interface diagonals, nsub*nG
+};
+
+
+struct dd_subdomain{
+  int nI;            // Interior equations
+  int nGp;           // Interface equations touched by the subdomain
+  int* eqns;         // Local equation -> global equation
+  int* gamma;        // Local interface equation -> interface index
+  struct matrix* KII;
+  struct matrix* KIG;
+  struct matrix* KGI;
+  struct matrix* KGG;
+  struct vector* fI;
+  struct vector* fG;
+};
+
+
+static void assemble_subdomain(struct model* running_model, int* part, int p,
+			       struct matrix* ID, int* gamma_index,
+			       struct vector* F, struct dd_subdomain* sd){
+  struct list* nodes = running_model->nodes;
+  struct list* elements = running_model->elements;
+  int free_dof = running_model->free_dof;
+  int i, j, k, l, a, b, P, Q, nloc;
+  int* loc = malloc(free_dof*sizeof(int));
+  struct element* e;
+  struct et_def* et;
+  struct matrix *KE, *COORDS, *K;
+  struct vector *f, *FE = NULL;
+  double g;
+  for (i=0; i<free_dof; i++)
+    loc[i] = -1;
+  // Number the interior equations first, then the interface equations
+  sd->nI = sd->nGp = 0;
+  for (k=0; k<2; k++){
+    for (i=0; i<elements->nitems; i++){
+      if (part[i] != p)
+	continue;
+      e = elements->array[i];
+      et = get_et_def(running_model->et_defs, e->et_id);
+      for (j=0; j<et->nenodes; j++){
+	for (l=0; l<et->ndof; l++){
+	  P = ID->array[e->IEN[j]][l];
+	  if (P == -1 || loc[P] != -1 || (gamma_index[P] != -1) != k)
+	    continue;
+	  loc[P] = k == 0 ? sd->nI++ : sd->nI + sd->nGp++;
+	}
+      }
+    }
+  }
+  nloc = sd->nI + sd->nGp;
+  sd->eqns = malloc(nloc*sizeof(int));
+  sd->gamma = malloc(sd->nGp*sizeof(int));
+  for (i=0; i<free_dof; i++){
+    if (loc[i] != -1){
+      sd->eqns[loc[i]] = i;
+      if (loc[i] >= sd->nI)
+	sd->gamma[loc[i]-sd->nI] = gamma_index[i];
+    }
+  }
+  K = new_matrix(nloc, nloc);
+  f = new_vector(nloc);
+  for (i=0; i<elements->nitems; i++){
+    if (part[i] != p)
+      continue;
+    e = elements->array[i];
+    et = get_et_def(running_model->et_defs, e->et_id);
+    KE = construct_KE(e, et, nodes);
+    if (et->sedata != NULL){
+      COORDS = construct_COORDS(nodes, e->IEN, et->nenodes);
+      FE = Superelement_FE(et->sedata, COORDS);
+      free_matrix(COORDS);
+    }
+    for (a=0; a<et->nenodes*et->ndof; a++){
+      P = ID->array[e->IEN[a/et->ndof]][a%et->ndof];
+      if (P == -1)
+	continue;
+      if (FE != NULL)
+	f->array[loc[P]] += FE->array[a];
+      for (b=0; b<et->nenodes*et->ndof; b++){
+	Q = ID->array[e->IEN[b/et->ndof]][b%et->ndof];
+	if (Q != -1)
+	  K->array[loc[P]][loc[Q]] += KE->array[a][b];
+	else{
+	  g = get_essential_bc(running_model->essential_bcs,
+			       e->IEN[b/et->ndof], b%et->ndof);
+	  f->array[loc[P]] -= KE->array[a][b]*g;
+	}
+      }
+    }
+    free_matrix(KE);
+    if (FE != NULL)
+      free_vector(FE), FE = NULL;
+  }
+  // Nodal loads on the interior belong to this subdomain alone
+  for (i=0; i<sd->nI; i++)
+    f->array[i] += F->array[sd->eqns[i]];
+  // Split into blocks
+  sd->KII = new_matrix(sd->nI, sd->nI);
+  sd->KIG = new_matrix(sd->nI, sd->nGp);
+  sd->KGI = new_matrix(sd->nGp, sd->nI);
+  sd->KGG = new_matrix(sd->nGp, sd->nGp);
+  sd->fI = new_vector(sd->nI);
+  sd->fG = new_vector(sd->nGp);
+  for (i=0; i<nloc; i++){
+    for (j=0; j<nloc; j++){
+      if (i < sd->nI && j < sd->nI)
+	sd->KII->array[i][j] = K->array[i][j];
+      else if (i < sd->nI)
+	sd->KIG->array[i][j-sd->nI] = K->array[i][j];
+      else if (j < sd->nI)
+	sd->KGI->array[i-sd->nI][j] = K->array[i][j];
+      else
+	sd->KGG->array[i-sd->nI][j-sd->nI] = K->array[i][j];
+    }
+    if (i < sd->nI)
+      sd->fI->array[i] = f->array[i];
+    else
+      sd->fG->array[i-sd->nI] = f->array[i];
+  }
+  free_matrix(K), free_vector(f), free(loc);
+}
+
+
+static void apply_KGI_inv_KII(struct dd_subdomain* sd, struct vector* t,
+			      double* out){
+  // out -= KGI*inv(KII)*t, t is overwritten
+  int i, j;
+  if (sd->nI > 0)
+    luLSS(sd->KII, t);
+  for (i=0; i<sd->nGp; i++){
+    for (j=0; j<sd->nI; j++)
+      out[i] -= sd->KGI->array[i][j]*t->array[j];
+  }
+}
+
+
+static void run_worker(struct model* running_model, int* part, int p, int nG,
+		       struct matrix* ID, int* gamma_index, struct vector* F,
+		       struct dd_shared* sh, int cmd_fd, int ack_fd){
+  struct dd_subdomain sd;
+  struct vector *t, *xG;
+  double* out;
+  char cmd;
+  int i, j;
+  assemble_subdomain(running_model, part, p, ID, gamma_index, F, &sd);
+  lprintf("Subdomain %d: %d interior, %d interface equations\n",
+	 p, sd.nI, sd.nGp);
+  if (sd.nI > 0 && luMFA(sd.KII) != 0){
+    // Exiting without the ack fails the solve in the parent
+    lprintf("Error: Zero pivot in the interior of subdomain %d\n", p);
+    fflush(log_stream());
+    _exit(1);
+  }
+  t = new_vector(sd.nI);
+  xG = new_vector(sd.nGp);
+  out = malloc(sd.nGp*sizeof(double));
+  // Condensed loads and interface diagonal
+  for (i=0; i<sd.nI; i++)
+    t->array[i] = sd.fI->array[i];
+  for (i=0; i<sd.nGp; i++)
+    out[i] = sd.fG->array[i];
+  apply_KGI_inv_KII(&sd, t, out);
+  for (i=0; i<sd.nGp; i++){
+    sh->rhs[p*nG+sd.gamma[i]] = out[i];
+    sh->diag[p*nG+sd.gamma[i]] = sd.KGG->array[i][i];
+  }
+  fflush(log_stream());
+  write(ack_fd, "r", 1);
+  while (read(cmd_fd, &cmd, 1) == 1 && cmd != 'q'){
+    for (i=0; i<sd.nGp; i++)
+      xG->array[i] = sh->x[sd.gamma[i]];
+    if (cmd == 'm'){
+      // Local Schur complement product
+      for (i=0; i<sd.nI; i++){
+	t->array[i] = 0.0;
+	for (j=0; j<sd.nGp; j++)
+	  t->array[i] += sd.KIG->array[i][j]*xG->array[j];
+      }
+      for (i=0; i<sd.nGp; i++){
+	out[i] = 0.0;
+	for (j=0; j<sd.nGp; j++)
+	  out[i] += sd.KGG->array[i][j]*xG->array[j];
+      }
+      apply_KGI_inv_KII(&sd, t, out);
+      for (i=0; i<sd.nGp; i++)
+	sh->y[p*nG+sd.gamma[i]] = out[i];
+    }
+    else if (cmd == 's'){
+      // Interior recovery
+      for (i=0; i<sd.nI; i++){
+	t->array[i] = sd.fI->array[i];
+	for (j=0; j<sd.nGp; j++)
+	  t->array[i] -= sd.KIG->array[i][j]*xG->array[j];
+      }
+      if (sd.nI > 0)
+	luLSS(sd.KII, t);
+      for (i=0; i<sd.nI; i++)
+	sh->U[sd.eqns[i]] = t->array[i];
+    }
+    write(ack_fd, &cmd, 1);
+  }
+  fflush(log_stream());
+  _exit(0);
+}
+
+
+/***********************************************
+ * Parent side
+ */
+
+
+static int wait_workers(int nsub, int* ack_fds){
+  // Returns 1 if a worker died instead of acknowledging
+  int p;
+  char ack;
+  for (p=0; p<nsub; p++){
+    if (read(ack_fds[p], &ack, 1) != 1){
+      lprintf("Error: Subdomain worker %d failed\n", p);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+
+static int broadcast(int nsub, int* cmd_fds, int* ack_fds, char cmd){
+  // Sends a command to every worker and waits for all of them to finish
+  int p;
+  for (p=0; p<nsub; p++)
+    write(cmd_fds[p], &cmd, 1);
+  return wait_workers(nsub, ack_fds);
+}
+
+
+static void stop_workers(int nsub, int* cmd_fds, int* ack_fds,
+			 pid_t* pids){
+  // Every worker is told to quit before any is reaped
+  int p;
+  for (p=0; p<nsub; p++)
+    write(cmd_fds[p], "q", 1);
+  for (p=0; p<nsub; p++){
+    close(cmd_fds[p]), close(ack_fds[p]);
+    waitpid(pids[p], NULL, 0);
+  }
+}
+
+
+static void close_other_fds(int* keep, int nkeep){
+  // Closes the descriptors a worker inherited above stderr, but for the
+  // nkeep in keep.  Pipes of other workers, possibly of other solves
+  // running on other threads, then see their ends close when their own
+  // workers exit.
+  int i, j, t, from = 3;
+  for (i=1; i<nkeep; i++){
+    for (j=i; j>0 && keep[j-1] > keep[j]; j--)
+      t = keep[j], keep[j] = keep[j-1], keep[j-1] = t;
+  }
+  for (i=0; i<nkeep; i++){
+    if (keep[i] < from)
+      continue;
+    if (keep[i] > from)
+      close_range(from, keep[i]-1, 0);
+    from = keep[i]+1;
+  }
+  close_range(from, ~0U, 0);
+}
+
+
+static int schur_product(int nsub, int nG, struct dd_shared* sh,
+			 int* cmd_fds, int* ack_fds, double* x, double* y){
+  int i, p;
+  memcpy(sh->x, x, nG*sizeof(double));
+  if (broadcast(nsub, cmd_fds, ack_fds, 'm') != 0)
+    return 1;
+  for (i=0; i<nG; i++){
+    y[i] = 0.0;
+    for (p=0; p<nsub; p++)
+      y[i] += sh->y[p*nG+i];
+  }
+  return 0;
+}
+
+
+static double dot(double* u, double* v, int n){
+  int i;
+  double sum = 0.0;
+  for (i=0; i<n; i++)
+    sum += u[i]*v[i];
+  return sum;
+}
+
+
+static int interface_pcg(int nsub, int nG, struct dd_shared* sh,
+			 int* cmd_fds, int* ack_fds, double* g, double* M,
+			 double* u){
+  // Jacobi preconditioned conjugate gradients on the interface problem.
+  // Returns 1 if a worker failed.
+  double *r = malloc(nG*sizeof(double)), *z = malloc(nG*sizeof(double));
+  double *d = malloc(nG*sizeof(double)), *q = malloc(nG*sizeof(double));
+  double rz, rz_old, alpha, gnorm = sqrt(dot(g, g, nG)), rnorm = 0.0;
+  int i, iter, status = 0;
+  for (i=0; i<nG; i++){
+    u[i] = 0.0;
+    r[i] = g[i];
+    z[i] = r[i]/M[i];
+    d[i] = z[i];
+  }
+  rz = dot(r, z, nG);
+  for (iter=0; iter<DD_MAXITER; iter++){
+    rnorm = sqrt(dot(r, r, nG));
+    if (gnorm == 0.0 || rnorm <= DD_TOL*gnorm)
+      break;
+    status = schur_product(nsub, nG, sh, cmd_fds, ack_fds, d, q);
+    if (status != 0)
+      break;
+    alpha = rz/dot(d, q, nG);
+    for (i=0; i<nG; i++){
+      u[i] += alpha*d[i];
+      r[i] -= alpha*q[i];
+      z[i] = r[i]/M[i];
+    }
+    rz_old = rz;
+    rz = dot(r, z, nG);
+    for (i=0; i<nG; i++)
+      d[i] = z[i] + (rz/rz_old)*d[i];
+  }
+  free(r), free(z), free(d), free(q);
+  if (status != 0)
+    return status;
+  lprintf("Interface solve: %d iterations, relative residual %g\n",
+	 iter, gnorm == 0.0 ? 0.0 : rnorm/gnorm);
+  if (iter == DD_MAXITER)
+    lprintf("Warning: Interface solve did not converge\n");
+  return 0;
+}
+
+
+struct static_soln* dd_static_solver(struct model* running_model, int nsub){
+  // NULL if the solve failed.  Workers already started are reaped.
+  struct list* nodes = running_model->nodes;
+  struct list* elements = running_model->elements;
+  int free_dof = running_model->free_dof, ndof = running_model->ndof;
+  int i, j, k, p, P, nG = 0;
+  if (nsub < 1 || nsub > elements->nitems){
+    lprintf("Error: Invalid number of subdomains: %d\n", nsub);
+    return NULL;
+  }
+  struct matrix* ID = new_matrix(nodes->nitems, ndof);
+  struct vector* F = new_vector(free_dof);
+  precomputations(running_model->et_defs);
+  construct_ID(nodes, ndof, running_model->essential_bcs,
+	       model_node_order(running_model), ID);
+  construct_F(nodes, running_model->nodal_forces, ID, F, ndof);
+
+  // Interface nodes are touched by elements of more than one subdomain
+  int* part = partition_elements(nodes, elements, running_model->et_defs,
+				 nsub);
+  int* node_part = malloc(nodes->nitems*sizeof(int));
+  int* gamma_index = malloc(free_dof*sizeof(int));
+  struct element* e;
+  struct et_def* et;
+  for (i=0; i<nodes->nitems; i++)
+    node_part[i] = -1;
+  for (i=0; i<elements->nitems; i++){
+    e = elements->array[i];
+    et = get_et_def(running_model->et_defs, e->et_id);
+    for (j=0; j<et->nenodes; j++){
+      k = e->IEN[j];
+      if (node_part[k] == -1)
+	node_part[k] = part[i];
+      else if (node_part[k] != part[i])
+	node_part[k] = nsub;
+    }
+  }
+  for (i=0; i<free_dof; i++)
+    gamma_index[i] = -1;
+  for (i=0; i<nodes->nitems; i++){
+    for (j=0; j<ndof; j++){
+      P = ID->array[i][j];
+      if (P != -1 && node_part[i] == nsub)
+	gamma_index[P] = nG++;
+    }
+  }
+  lprintf("Domain decomposition: %d subdomains, %d interface equations\n",
+	 nsub, nG);
+
+  // Shared memory and workers
+  size_t nshared = free_dof + nG + 3*(size_t) nsub*nG;
+  double* shared = mmap(NULL, (nshared > 0 ? nshared : 1)*sizeof(double),
+			PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+			-1, 0);
+  if (shared == MAP_FAILED){
+    lprintf("Error: Could not map shared memory\n");
+    free(part), free(node_part), free(gamma_index);
+    free_matrix(ID), free_vector(F);
+    return NULL;
+  }
+  struct dd_shared sh;
+  sh.U = shared;
+  sh.x = sh.U + free_dof;
+  sh.y = sh.x + nG;
+  sh.rhs = sh.y + nsub*nG;
+  sh.diag = sh.rhs + nsub*nG;
+  int* cmd_fds = malloc(nsub*sizeof(int));
+  int* ack_fds = malloc(nsub*sizeof(int));
+  pid_t* pids = malloc(nsub*sizeof(pid_t));
+  int cmd_pipe[2], ack_pipe[2], keep[3], nstarted, failed;
+  // Writes to a worker that died fail instead of raising SIGPIPE
+  struct timespec no_wait = {0, 0};
+  sigset_t pipe_set, old_set;
+  sigemptyset(&pipe_set), sigaddset(&pipe_set, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &pipe_set, &old_set);
+  fflush(log_stream());
+  for (p=0; p<nsub; p++){
+    if (pipe(cmd_pipe) != 0){
+      lprintf("Error: Could not create worker pipes\n");
+      break;
+    }
+    if (pipe(ack_pipe) != 0){
+      lprintf("Error: Could not create worker pipes\n");
+      close(cmd_pipe[0]), close(cmd_pipe[1]);
+      break;
+    }
+    pids[p] = fork();
+    if (pids[p] < 0){
+      lprintf("Error: Could not start subdomain worker\n");
+      close(cmd_pipe[0]), close(cmd_pipe[1]);
+      close(ack_pipe[0]), close(ack_pipe[1]);
+      break;
+    }
+    if (pids[p] == 0){
+      keep[0] = cmd_pipe[0], keep[1] = ack_pipe[1];
+      keep[2] = fileno(log_stream());
+      close_other_fds(keep, 3);
+      run_worker(running_model, part, p, nG, ID, gamma_index, F, &sh,
+		 cmd_pipe[0], ack_pipe[1]);
+    }
+    close(cmd_pipe[0]), close(ack_pipe[1]);
+    cmd_fds[p] = cmd_pipe[1];
+    ack_fds[p] = ack_pipe[0];
+  }
+  nstarted = p;
+  failed = nstarted < nsub || wait_workers(nsub, ack_fds) != 0;
+
+  // Interface problem
+  double* g = calloc(nG > 0 ? nG : 1, sizeof(double));
+  double* M = calloc(nG > 0 ? nG : 1, sizeof(double));
+  double* uG = calloc(nG > 0 ? nG : 1, sizeof(double));
+  for (i=0; i<free_dof; i++){
+    if (gamma_index[i] != -1)
+      g[gamma_index[i]] = F->array[i];
+  }
+  for (i=0; i<nG; i++){
+    for (p=0; p<nsub; p++){
+      g[i] += sh.rhs[p*nG+i];
+      M[i] += sh.diag[p*nG+i];
+    }
+  }
+  if (!failed)
+    failed = interface_pcg(nsub, nG, &sh, cmd_fds, ack_fds, g, M, uG);
+
+  // Interior recovery
+  memcpy(sh.x, uG, nG*sizeof(double));
+  if (!failed)
+    failed = broadcast(nsub, cmd_fds, ack_fds, 's');
+  stop_workers(nstarted, cmd_fds, ack_fds, pids);
+  if (!sigismember(&old_set, SIGPIPE)){
+    while (sigtimedwait(&pipe_set, NULL, &no_wait) > 0)
+      ;
+  }
+  pthread_sigmask(SIG_SETMASK, &old_set, NULL);
+  struct vector* U = NULL;
+  if (!failed){
+    U = new_vector(free_dof);
+    for (i=0; i<free_dof; i++){
+      if (gamma_index[i] != -1)
+	U->array[i] = uG[gamma_index[i]];
+      else
+	U->array[i] = sh.U[i];
+    }
+    lprintf("Solution vector:\n"), print_vector(U);
+  }
+  munmap(shared, (nshared > 0 ? nshared : 1)*sizeof(double));
+  free(g), free(M), free(uG), free(part), free(node_part), free(gamma_index);
+  free(cmd_fds), free(ack_fds), free(pids);
+  free_vector(F);
+  if (failed){
+    free_matrix(ID);
+    return NULL;
+  }
+  return new_static_soln(ndof, ID, U);
+}
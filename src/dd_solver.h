@@ -0,0 +1,8 @@
+/*
+Domain decomposition static solver.  Elements are partitioned into
+subdomains, each subdomain is assembled and its interior factored by a
+separate worker process, and the interface (Schur complement) problem
+is solved iteratively by the parent process.
+*/
+
+struct static_soln* dd_static_solver(struct model* running_model, int nsub);
@@ -3,10 +3,13 @@
 #include <string.h>
 #include <assert.h>
 
+#include "lib/log.h"
 #include "lib/list.h"
 #include "lib/geom.h"
 #include "lib/linalg.h"
+#include "lib/quadrature.h"
 #include "element_types.h"
+#include "superelement.h"
 
 #define MAXOPT 10
 
@@ -22,7 +25,7 @@
  *  6 = SPLANE6 (6-node structural triangular plane element)
  *  7 = Undefined 
  *  8 = SPLANE8 (8-node structural quadrilateral plane element)
- *  9 = Undefined
+ *  9 = SSUPER (structural superelement, nodes set by its masters)
  * 10 = TRESISTANCE
  * 11 = Undefined
  * 12 = Undefined
@@ -32,7 +35,7 @@
  * 16 = TPLANE6 (6-node thermal triangular plane element)
  * 17 = Undefined 
  * 18 = TPLANE8 (8-node thermal quadrilateral plane element)
- * 19 = Undefined
+ * 19 = TSUPER (thermal superelement, nodes set by its masters)
  */
 
 
@@ -47,31 +50,44 @@ static int get_lib_id(char type_name[]){
     return 3;
   else if (strcmp(type_name, "SPLANE4") == 0)
     return 4;
-  else if (strcmp(type_name, "SPLANE5") == 0)
-    return 5;
   else if (strcmp(type_name, "SPLANE6") == 0)
     return 6;
   else if (strcmp(type_name, "SPLANE8") == 0)
     return 8;
+  else if (strcmp(type_name, "SSUPER") == 0)
+    return 9;
   else if (strcmp(type_name, "TRESISTANCE") == 0)
     return 10;
   else if (strcmp(type_name, "TPLANE3") == 0)
     return 13;
   else if (strcmp(type_name, "TPLANE4") == 0)
     return 14;
-  else if (strcmp(type_name, "TPLANE5") == 0)
-    return 15;
   else if (strcmp(type_name, "TPLANE6") == 0)
     return 16;
   else if (strcmp(type_name, "TPLANE8") == 0)
     return 18;
+  else if (strcmp(type_name, "TSUPER") == 0)
+    return 19;
   else{
-    printf("Error: Invalid element type name: %s\n", type_name);
+    lprintf("Error: Invalid element type name: %s\n", type_name);
     return -1;
   }
 }
 
 
+const char* get_type_name(int lib_id){
+  // Inverse of get_lib_id, for restoring saved type definitions
+  static const char* names[20] = {
+    "SSPRING", "SBAR", "SBEAM", "SPLANE3", "SPLANE4", NULL,
+    "SPLANE6", NULL, "SPLANE8", "SSUPER", "TRESISTANCE", NULL, NULL,
+    "TPLANE3", "TPLANE4", NULL, "TPLANE6", NULL, "TPLANE8", "TSUPER"};
+  if (lib_id >= 0 && lib_id < 20 && names[lib_id] != NULL)
+    return names[lib_id];
+  lprintf("Error: Invalid library element id\n");
+  return NULL;
+}
+
+
 static int get_nenodes(int lib_id){
   if (lib_id == 0 || lib_id == 1 || lib_id == 2 || lib_id == 10)
     return 2;
@@ -85,7 +101,9 @@ static int get_nenodes(int lib_id){
     return 6;
   else if (lib_id == 8 || lib_id == 18)
     return 8;
-  printf("Error: Invalid library element id\n");
+  else if (lib_id == 9 || lib_id == 19)
+    return 0;  // Set when a superelement is attached
+  lprintf("Error: Invalid library element id\n");
   return -1;
 }
 
@@ -95,7 +113,7 @@ static int get_ndof(int lib_id){
     return 2;
   else if (lib_id >= 10 && lib_id < 20)
     return 1;
-  printf("Error: Invalid library element id\n");
+  lprintf("Error: Invalid library element id\n");
   return -1;
 }
 
@@ -105,28 +123,38 @@ static struct matprops* new_matprops(){
   m->E = 0;
   m->v = 0;
   m->K = 0;
+  m->SY = 0;
+  m->H = 0;
   return m;
 }
 
 
 static struct solver_data* new_sdata(){
   struct solver_data* sdata = malloc(sizeof(struct solver_data));
+  sdata->nint_pts = 0;
   sdata->int_wts = NULL;
   sdata->int_pts = NULL;
   sdata->NDERNATs = NULL;
   sdata->D = NULL;
+  sdata->H = NULL;
+  sdata->naffine = 0;
   return sdata;
 }
 
 
 struct et_def* new_et_def(int user_id, char* type_name){
+  // NULL for an unknown type name
+  int lib_id = get_lib_id(type_name);
+  if (lib_id == -1)
+    return NULL;
   struct et_def* et = malloc(sizeof(struct et_def));
   et->user_id = user_id;
-  et->lib_id = get_lib_id(type_name);
+  et->lib_id = lib_id;
   et->nenodes = get_nenodes(et->lib_id); 
   et->ndof = get_ndof(et->lib_id);
   et->mprops = new_matprops();
   et->sdata = new_sdata();
+  et->sedata = NULL;
   // Zero out options and constants
   int i;
   for (i=0; i<MAXOPT; i++){
@@ -149,60 +177,94 @@ struct et_def* get_et_def(struct list* et_defs, int user_id){
 }
 
 
-void set_real_constant(struct et_def* et, int const_id, double value){
-  assert(const_id>=0 && const_id < 10 && value > 0);
+int set_real_constant(struct et_def* et, int const_id, double value){
+  if (const_id < 0 || const_id >= MAXOPT || !(value > 0.0)){
+    lprintf("Error: Invalid real constant %d: %g\n", const_id, value);
+    return 1;
+  }
   et->consts[const_id] = value;
+  return 0;
 }
 
 
-void set_keyopt(struct et_def* et, int key, int option){
-  assert(key>=0 && key < 10);
+int set_keyopt(struct et_def* et, int key, int option){
+  // Key 1 selects plane stress (0) or strain (1) of structural plane
+  // elements and key 2 the integration order, checked here so the
+  // solver never meets an option it cannot construct
+  int plane = et->lib_id == 3 || et->lib_id == 4 || et->lib_id == 6 ||
+    et->lib_id == 8;
+  if (key < 0 || key >= MAXOPT ||
+      (key == 1 && plane && option != 0 && option != 1) ||
+      (key == 2 && (option < 0 || option > QUAD_MAXORDER))){
+    lprintf("Error: Invalid key option %d: %d\n", key, option);
+    return 1;
+  }
   et->opts[key] = option;
+  return 0;
+}
+
+
+int set_superelement(struct et_def* et, struct superelement* se){
+  // The superelement is owned by the model, not the element type.  Set
+  // once, as its elements take their node count from it
+  if ((et->lib_id != 9 && et->lib_id != 19) || se->ndof != et->ndof ||
+      et->sedata != NULL){
+    lprintf("Error: Element type %d cannot hold superelement %d\n",
+	   et->user_id, se->se_id);
+    return 1;
+  }
+  et->sedata = se;
+  et->nenodes = se->nmasters;
+  return 0;
 }
 
 
-void set_matprop(struct et_def* et, char* prop_name, double value){
+int set_matprop(struct et_def* et, char* prop_name, double value){
   if (strcmp(prop_name, "E") == 0)
     et->mprops->E = value;
   else if (strcmp(prop_name, "V") == 0)
     et->mprops->v = value;
   else if (strcmp(prop_name, "K") == 0)
     et->mprops->K = value;
-  else
-    printf("Error: Invalid material property name\n");
+  else if (strcmp(prop_name, "SY") == 0)
+    et->mprops->SY = value;
+  else if (strcmp(prop_name, "H") == 0)
+    et->mprops->H = value;
+  else{
+    lprintf("Error: Invalid material property name\n");
+    return 1;
+  }
+  return 0;
 }
 
 
 void print_et_def(struct et_def* et){
   int i;
-  printf("Element type id: %d\n", et->user_id);
-  printf("\tLibrary type id: %d\n", et->lib_id);
-  printf("\tElement nodes: %d\n", et->nenodes);
-  printf("\tDegrees of freedom: %d\n", et->ndof);
-  printf("\tElement key options:");
+  lprintf("Element type id: %d\n", et->user_id);
+  lprintf("\tLibrary type id: %d\n", et->lib_id);
+  lprintf("\tElement nodes: %d\n", et->nenodes);
+  lprintf("\tDegrees of freedom: %d\n", et->ndof);
+  lprintf("\tElement key options:");
   for (i=0; i<MAXOPT; i++)
-    printf(" %d", et->opts[i]);
-  printf("\n");
-  printf("\tElement constants:");
+    lprintf(" %d", et->opts[i]);
+  lprintf("\n");
+  lprintf("\tElement constants:");
   for (i=0; i<MAXOPT; i++)
-    printf(" %g", et->consts[i]);
-  printf("\n");
-  printf("\tMaterial properties:\n");
-  printf("\t\tE = %g\n", et->mprops->E);
-  printf("\t\tv = %g\n", et->mprops->v);
-  printf("\t\tK = %g\n", et->mprops->K);
+    lprintf(" %g", et->consts[i]);
+  lprintf("\n");
+  lprintf("\tMaterial properties:\n");
+  lprintf("\t\tE = %g\n", et->mprops->E);
+  lprintf("\t\tv = %g\n", et->mprops->v);
+  lprintf("\t\tK = %g\n", et->mprops->K);
+  if (et->mprops->SY > 0.0){
+    lprintf("\t\tSY = %g\n", et->mprops->SY);
+    lprintf("\t\tH = %g\n", et->mprops->H);
+  }
 }
 
 
 static void free_solver_data(struct solver_data* sdata){
-  if (sdata->int_wts != NULL)
-    free(sdata->int_wts);
-  
-  if (sdata->int_pts != NULL){
-    free_items(sdata->int_pts, free);
-    free_list(sdata->int_pts);
-  }
-  
+  // Integration points and weights are static tables, not owned
   if (sdata->NDERNATs != NULL){
     int i;
     for (i=0; i<sdata->NDERNATs->nitems; i++)
@@ -213,6 +275,9 @@ static void free_solver_data(struct solver_data* sdata){
   
   if (sdata->D != NULL)
     free_matrix(sdata->D);
+
+  if (sdata->H != NULL)
+    free(sdata->H);
   
   free(sdata);
 }
@@ -231,108 +296,50 @@ void free_et_def(void* et){
  */
 
 
-int get_nint_pts(int lib_id, int integration){
-  // 0 = reduced integration
-  // 1 = full integration
+const struct quad_rule* get_quad_rule(int lib_id, int integration, int order){
+  // integration (key option 0):
+  //   0 = reduced integration
+  //   1 = full integration
+  // order (key option 2):
+  //   0 = the element's default for that integration
+  //   1 to QUAD_MAXORDER = points per direction for quadrilaterals,
+  //                        degree of exactness for triangles
+  // Returns NULL when the element has no rule of that order
+  const struct quad_rule* rule = NULL;
   assert(integrated_element(lib_id));
-  if (lib_id == 4 || lib_id == 14){
-    if (integration == 0)
-      return 1;
-    else
-      return 4;
-  }
-  else if (lib_id == 8 || lib_id == 18){
-    if (integration == 0)
-      return 4;
-    else
-      return 9;
+  if (lib_id == 4 || lib_id == 14 || lib_id == 8 || lib_id == 18){
+    if (order == 0 && (lib_id == 4 || lib_id == 14))
+      order = integration == 0 ? 1 : 2;
+    else if (order == 0)
+      order = integration == 0 ? 2 : 3;
+    rule = gauss_rule(order);
   }
-  printf("Error: Invalid library element id\n");
-  return -1;
-}
-
-
-struct list* get_int_pts(int lib_id, int integration){
-  struct list* int_pts = new_list();
-  if (lib_id == 4 || lib_id == 14){
-    if (integration == 0)
-      append(int_pts, new_point(0.0, 0.0));
-    else{
-      append(int_pts, new_point(-0.57735, -0.57735));
-      append(int_pts, new_point(0.57735, -0.57735));
-      append(int_pts, new_point(0.57735, 0.57735));
-      append(int_pts, new_point(-0.57735, 0.57735));
-    } 
+  else if (lib_id == 3 || lib_id == 13 || lib_id == 6 || lib_id == 16){
+    // The 2nd order rule is exact for the straight sided quadratic triangle
+    if (order == 0)
+      order = lib_id == 3 || lib_id == 13 ? 1 : 2;
+    rule = triangle_rule(order);
   }
-  else if (lib_id == 8 || lib_id == 18){
-    if (integration == 0){
-      append(int_pts, new_point(-0.57735, -0.57735));
-      append(int_pts, new_point(0.57735, -0.57735));
-      append(int_pts, new_point(0.57735, 0.57735));
-      append(int_pts, new_point(-0.57735, 0.57735));
-    }      
-    else{
-      append(int_pts, new_point(-.77460, -0.77460));
-      append(int_pts, new_point(0.0, -0.77460));
-      append(int_pts, new_point(.77460, -0.77460));
-      append(int_pts, new_point(-.77460, 0.0));
-      append(int_pts, new_point(0.0, 0.0));
-      append(int_pts, new_point(.77460, 0.0));
-      append(int_pts, new_point(-.77460, 0.77460));
-      append(int_pts, new_point(0.0, 0.77460));
-      append(int_pts, new_point(.77460, 0.77460));
-    }
-  }
-  return int_pts;
+  if (rule == NULL)
+    lprintf("Error: Invalid integration order %d for library id %d\n",
+	   order, lib_id);
+  return rule;
 }
 
 
-double* get_int_wts(int lib_id, int integration){
-  double* int_wts;
-  if (lib_id == 4 || lib_id == 14){
-    if (integration == 0){
-      int_wts = malloc(sizeof(double));
-      int_wts[0] = 4.0;
-    }
-    else{
-      int_wts = malloc(4*sizeof(double));
-      int_wts[0] = 1.0;
-      int_wts[1] = 1.0;
-      int_wts[2] = 1.0;
-      int_wts[3] = 1.0;
-    } 
-  }
-  else if (lib_id == 8 || lib_id == 18){
-    if (integration == 0){
-      int_wts = malloc(4*sizeof(double));
-      int_wts[0] = 1.0;
-      int_wts[1] = 1.0;
-      int_wts[2] = 1.0;
-      int_wts[3] = 1.0;
-    }      
-    else{
-      int_wts = malloc(9*sizeof(double));
-      int_wts[0] = 0.30864;
-      int_wts[1] = 0.49383;
-      int_wts[2] = 0.30864;
-      int_wts[3] = 0.49383;
-      int_wts[4] = 0.79012;
-      int_wts[5] = 0.49383;
-      int_wts[6] = 0.30864;
-      int_wts[7] = 0.49383;
-      int_wts[8] = 0.30864;
-    }
-  }
-  return int_wts;
+int quadratic_element(int lib_id){
+  // Elements with midside nodes, listed after the corner nodes
+  return lib_id == 6 || lib_id == 8 || lib_id == 16 || lib_id == 18;
 }
 
 
 int integrated_element(int lib_id){
-  if (lib_id == 0 || lib_id == 1 || lib_id == 2 || lib_id == 10)
+  if (lib_id == 0 || lib_id == 1 || lib_id == 2 || lib_id == 10 ||
+      lib_id == 9 || lib_id == 19)
     return 0;
   else
     return 1;
-  printf("Error: Invalid library element id\n");
+  lprintf("Error: Invalid library element id\n");
   return -1;
 }
 
@@ -6,15 +6,19 @@ struct matprops{
   double E;
   double v;
   double K;
+  double SY;     // Yield stress, 0 for elastic (nonlinear analysis only)
+  double H;      // Linear isotropic hardening modulus
 };
 
 
 struct solver_data{
   int nint_pts;
-  double* int_wts;
-  struct list* int_pts;
+  const double* int_wts;        // Static rule tables (lib/quadrature.c)
+  const double (*int_pts)[2];
   struct list* NDERNATs;
   struct matrix* D;
+  double* H;     // Natural derivative integrals for affine elements
+  int naffine;   // Elements assembled by the affine fast path
 };
 
 
@@ -27,20 +31,22 @@ struct et_def{
   double consts[10];
   struct matprops* mprops;
   struct solver_data* sdata;
+  struct superelement* sedata;  // Only for superelement types
 };
 
 struct et_def* new_et_def(int user_id, char* type_name);
 struct et_def* get_et_def(struct list* et_defs, int user_id);
-void set_real_constant(struct et_def* et, int const_id, double value);
-void set_matprop(struct et_def* et, char* prop_name, double value);
-void set_keyopt(struct et_def* et, int key, int option);
+int set_real_constant(struct et_def* et, int const_id, double value);
+int set_matprop(struct et_def* et, char* prop_name, double value);
+int set_keyopt(struct et_def* et, int key, int option);
+int set_superelement(struct et_def* et, struct superelement* se);
 void print_et_def(struct et_def* et);
 void free_et_def(void* et);
 
 
-int get_nint_pts(int lib_id, int integration);
-struct list* get_int_pts(int lib_id, int integration);
-double* get_int_wts(int lib_id, int integration);
+const struct quad_rule* get_quad_rule(int lib_id, int integration, int order);
 int integrated_element(int lib_id);
+int quadratic_element(int lib_id);
+const char* get_type_name(int lib_id);
 
 
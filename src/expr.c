@@ -0,0 +1,287 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <math.h>
+#include "expr.h"
+
+
+#define OP_NUM 0
+#define OP_VAR 1
+#define OP_ADD 2
+#define OP_SUB 3
+#define OP_MUL 4
+#define OP_DIV 5
+#define OP_MOD 6
+#define OP_POW 7
+#define OP_NEG 8
+#define OP_FUNC 9
+
+
+static const struct{
+  const char* name;
+  double (*f)(double);
+} functions[] = {
+  {"ABS", fabs}, {"SQRT", sqrt}, {"EXP", exp}, {"LOG", log},
+  {"SIN", sin}, {"COS", cos}, {"TAN", tan}, {"ATAN", atan},
+  {"FLOOR", floor}, {"CEIL", ceil}
+};
+
+
+/***********************************************
+ * Variables
+ */
+
+
+struct var_table* new_var_table(){
+  struct var_table* vars = malloc(sizeof(struct var_table));
+  vars->n = 0;
+  vars->size = 8;
+  vars->names = malloc(vars->size*sizeof(char*));
+  vars->values = malloc(vars->size*sizeof(double));
+  return vars;
+}
+
+
+int find_var(struct var_table* vars, char* name){
+  int i;
+  for (i=0; i<vars->n; i++){
+    if (strcmp(vars->names[i], name) == 0)
+      return i;
+  }
+  return -1;
+}
+
+
+int define_var(struct var_table* vars, char* name){
+  // Slot of the variable, created at zero if new
+  int i = find_var(vars, name);
+  if (i != -1)
+    return i;
+  if (vars->n == vars->size){
+    vars->size *= 2;
+    vars->names = realloc(vars->names, vars->size*sizeof(char*));
+    vars->values = realloc(vars->values, vars->size*sizeof(double));
+  }
+  vars->names[vars->n] = malloc(strlen(name)+1);
+  strcpy(vars->names[vars->n], name);
+  vars->values[vars->n] = 0.0;
+  return vars->n++;
+}
+
+
+void free_var_table(struct var_table* vars){
+  int i;
+  for (i=0; i<vars->n; i++)
+    free(vars->names[i]);
+  free(vars->names), free(vars->values);
+  free(vars);
+}
+
+
+/***********************************************
+ * Compiling
+ */
+
+
+struct compiler{
+  char* p;                  // Next character
+  struct var_table* vars;
+  struct expr* e;
+  int size;
+  int depth, max_depth;     // Evaluation stack
+  int error;
+};
+
+
+static void emit(struct compiler* c, int type, double value, int var,
+		 double (*f)(double)){
+  struct expr_op* op;
+  if (c->e->n == c->size){
+    c->size *= 2;
+    c->e->ops = realloc(c->e->ops, c->size*sizeof(struct expr_op));
+  }
+  op = c->e->ops + c->e->n++;
+  op->type = type, op->value = value, op->var = var, op->f = f;
+  if (type == OP_NUM || type == OP_VAR)
+    c->depth++;
+  else if (type != OP_NEG && type != OP_FUNC)
+    c->depth--;
+  if (c->depth > c->max_depth)
+    c->max_depth = c->depth;
+}
+
+
+static void compile_sum(struct compiler* c);
+static void compile_unary(struct compiler* c);
+
+
+static void compile_primary(struct compiler* c){
+  char name[64];
+  char* end;
+  double value;
+  int i, n = 0;
+  if (*c->p == '('){
+    c->p++;
+    compile_sum(c);
+    if (*c->p != ')')
+      c->error = 1;
+    c->p++;
+  }
+  else if (isdigit((unsigned char) *c->p) || *c->p == '.'){
+    value = strtod(c->p, &end);
+    if (end == c->p)
+      c->error = 1;
+    c->p = end;
+    emit(c, OP_NUM, value, 0, NULL);
+  }
+  else if (isalpha((unsigned char) *c->p) || *c->p == '_'){
+    while (isalnum((unsigned char) *c->p) || *c->p == '_'){
+      if (n < (int) sizeof(name)-1)
+	name[n++] = *c->p;
+      c->p++;
+    }
+    name[n] = '\0';
+    if (*c->p == '('){
+      for (i=0; i<(int) (sizeof(functions)/sizeof(functions[0])); i++){
+	if (strcasecmp(functions[i].name, name) == 0)
+	  break;
+      }
+      if (i == sizeof(functions)/sizeof(functions[0])){
+	c->error = 1;
+	return;
+      }
+      compile_primary(c);
+      emit(c, OP_FUNC, 0.0, 0, functions[i].f);
+    }
+    else if ((i = find_var(c->vars, name)) != -1)
+      emit(c, OP_VAR, 0.0, i, NULL);
+    else
+      c->error = 1;
+  }
+  else
+    c->error = 1;
+}
+
+
+static void compile_power(struct compiler* c){
+  compile_primary(c);
+  if (!c->error && *c->p == '^'){
+    // Right associative, and binding tighter than a leading minus
+    c->p++;
+    compile_unary(c);
+    emit(c, OP_POW, 0.0, 0, NULL);
+  }
+}
+
+
+static void compile_unary(struct compiler* c){
+  if (*c->p == '-'){
+    c->p++;
+    compile_unary(c);
+    emit(c, OP_NEG, 0.0, 0, NULL);
+  }
+  else if (*c->p == '+'){
+    c->p++;
+    compile_unary(c);
+  }
+  else
+    compile_power(c);
+}
+
+
+static void compile_product(struct compiler* c){
+  char op;
+  compile_unary(c);
+  while (!c->error && (*c->p == '*' || *c->p == '/' || *c->p == '%')){
+    op = *c->p++;
+    compile_unary(c);
+    emit(c, op == '*' ? OP_MUL : op == '/' ? OP_DIV : OP_MOD, 0.0, 0, NULL);
+  }
+}
+
+
+static void compile_sum(struct compiler* c){
+  char op;
+  compile_product(c);
+  while (!c->error && (*c->p == '+' || *c->p == '-')){
+    op = *c->p++;
+    compile_product(c);
+    emit(c, op == '+' ? OP_ADD : OP_SUB, 0.0, 0, NULL);
+  }
+}
+
+
+struct expr* compile_expr(char* text, struct var_table* vars){
+  // NULL unless all of text is an expression over defined variables
+  struct compiler c;
+  c.p = text;
+  c.vars = vars;
+  c.size = 8;
+  c.e = malloc(sizeof(struct expr));
+  c.e->n = 0;
+  c.e->ops = malloc(c.size*sizeof(struct expr_op));
+  c.depth = c.max_depth = 0;
+  c.error = 0;
+  compile_sum(&c);
+  if (c.error || *c.p != '\0' || c.max_depth > MAXSTACK){
+    free_expr(c.e);
+    return NULL;
+  }
+  return c.e;
+}
+
+
+/***********************************************
+ * Evaluation
+ */
+
+
+double eval_expr(struct expr* e, double* values){
+  double stack[MAXSTACK];
+  struct expr_op* op;
+  int i, n = 0;
+  for (i=0; i<e->n; i++){
+    op = e->ops + i;
+    switch (op->type){
+    case OP_NUM:
+      stack[n++] = op->value;
+      break;
+    case OP_VAR:
+      stack[n++] = values[op->var];
+      break;
+    case OP_NEG:
+      stack[n-1] = -stack[n-1];
+      break;
+    case OP_FUNC:
+      stack[n-1] = op->f(stack[n-1]);
+      break;
+    case OP_ADD:
+      n--, stack[n-1] += stack[n];
+      break;
+    case OP_SUB:
+      n--, stack[n-1] -= stack[n];
+      break;
+    case OP_MUL:
+      n--, stack[n-1] *= stack[n];
+      break;
+    case OP_DIV:
+      n--, stack[n-1] /= stack[n];
+      break;
+    case OP_MOD:
+      n--, stack[n-1] = fmod(stack[n-1], stack[n]);
+      break;
+    case OP_POW:
+      n--, stack[n-1] = pow(stack[n-1], stack[n]);
+      break;
+    }
+  }
+  return stack[0];
+}
+
+
+void free_expr(struct expr* e){
+  free(e->ops);
+  free(e);
+}
@@ -0,0 +1,48 @@
+/*
+Arithmetic expressions of the script language.  An expression over
+numbers and the script's scalar variables is compiled once into postfix
+form, with each variable resolved to its slot in the variable table, so
+evaluating it again in a loop does no parsing.
+
+  expr    = term {(+ | -) term}
+  term    = unary {(* | / | %) unary}
+  unary   = (- | +) unary | power
+  power   = primary [^ unary]
+  primary = number | variable | function(expr) | (expr)
+
+Functions: ABS, SQRT, EXP, LOG, SIN, COS, TAN, ATAN, FLOOR, CEIL.
+Variable names are case sensitive, function names are not.
+*/
+
+#define MAXSTACK 32   // Deepest evaluation stack of an expression
+
+
+struct var_table{
+  int n;
+  int size;
+  char** names;
+  double* values;
+};
+
+
+struct expr_op{
+  int type;
+  double value;             // Number
+  int var;                  // Variable slot
+  double (*f)(double);      // Function
+};
+
+
+struct expr{
+  int n;
+  struct expr_op* ops;      // Postfix
+};
+
+
+struct var_table* new_var_table();
+int find_var(struct var_table* vars, char* name);
+int define_var(struct var_table* vars, char* name);
+void free_var_table(struct var_table* vars);
+struct expr* compile_expr(char* text, struct var_table* vars);
+double eval_expr(struct expr* e, double* values);
+void free_expr(struct expr* e);
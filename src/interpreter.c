@@ -8,9 +8,14 @@ Checks that commands and arguments are valid
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <assert.h>
+#include <ctype.h>
+#include <math.h>
+#include <limits.h>
+#include "lib/log.h"
+#include "lib/list.h"
 #include "lib/strfuncs.h"
 #include "model.h"
+#include "expr.h"
 #include "interpreter.h"
 
 
@@ -20,13 +25,13 @@ Checks that commands and arguments are valid
 
 
 void print_argc_error(char* command, int expected_argc, int got_argc){
-  printf("Invalid number of arguments for %s.  Expected %d, got %d\n",
+  lprintf("Invalid number of arguments for %s.  Expected %d, got %d\n",
 	 command, expected_argc, got_argc);
 }
 
 
 void print_script_error(char* err, int line){
-  printf("%s error.  Aborting script on line %d\n", err, line);
+  lprintf("%s error.  Aborting script on line %d\n", err, line);
 }
 
 
@@ -36,29 +41,30 @@ void print_script_error(char* err, int line){
 
 
 #define MAXBUFFER 1000
-#define MAXFIELDS 10
-static const char* delimiters = " ,\t\n";
+static const char delimiters[] = " ,\t\n";
 
 
-static int parse(char* line, struct instruction* next_instruction){
+int parse(char* line, struct instruction* next_instruction){
+  // Reentrant, so scripts can be run on several threads at once
+  char* state;
   // Reset instruction argument counter
   next_instruction->argc = 0;
   // Must be at least one token indicating the command
-  char* field = strtok(line, delimiters);
+  char* field = strtok_r(line, delimiters, &state);
   if (field != NULL){
     next_instruction->command = field;
   }
   else{
-    printf("Error: No command could be parsed\n");
+    lprintf("Error: No command could be parsed\n");
     return 1;
   }
   // Collect all remaining arguments, if any
-  while ((field = strtok(NULL, delimiters)) != NULL){
+  while ((field = strtok_r(NULL, delimiters, &state)) != NULL){
     if (next_instruction->argc < MAXFIELDS){
       next_instruction->argv[next_instruction->argc++] = field;
     }
     else{
-      printf("Error: Too many fields\n");
+      lprintf("Error: Too many fields\n");
       return 1;
     }
   }
@@ -90,36 +96,371 @@ static int comment_line(char* line){
 }
 
 
-int run_script(struct model* running_model, FILE* script_file){
-  // Only one instruction object is created.
-  // Each instruction overwrites the last.
-  char buffer[MAXBUFFER];
+int command_line(char* line){
+  // Whether a line holds a command, rather than whitespace or a comment
+  return !whitespace_line(line) && !comment_line(line);
+}
+
+
+/***********************************************
+ * Command arguments
+ */
+
+
+/*
+ * An argument converted to the type its command takes: a number, or
+ * text for keywords, names and file names.  Model commands list their
+ * argument types in the command table at the end of the file.
+ */
+struct argument{
+  char* text;     // NULL for a number
+  double real;
+  int integer;    // Integer and node number arguments
+};
+
+struct command;
+static const struct command* find_command(char* name);
+static char argument_type(const struct command* c, int i);
+static int valid_argc(const struct command* c, int argc);
+static int run_command(struct model* running_model, const struct command* c,
+		       int argc, struct argument* args);
+
+
+static int number_argument(char type, double value, char* source,
+			   struct argument* arg){
+  // Integer and node number arguments must have integer values
+  arg->text = NULL;
+  arg->real = value;
+  if (type == 'f')
+    return 0;
+  if (!(value == floor(value) && fabs(value) <= INT_MAX)){
+    lprintf("Error: Integer expected for %s, got %.17g\n", source, value);
+    return 1;
+  }
+  arg->integer = (int) value;
+  return 0;
+}
+
+
+static int text_argument(char type, char* text, struct argument* arg){
+  // Converts a field of a parsed line.  A node argument that is not a
+  // number names a node set.
+  char* end;
+  double value;
+  arg->text = text;
+  if (type == 's')
+    return 0;
+  value = strtod(text, &end);
+  if (end != text && *end == '\0')
+    return number_argument(type, value, text, arg);
+  if (type == 'n' && (isalpha((unsigned char) text[0]) || text[0] == '_'))
+    return 0;
+  lprintf("Error: Invalid number: %s\n", text);
+  return 1;
+}
+
+
+/***********************************************
+ * Compiled scripts
+ */
+
+
+#define ST_COMMAND 0
+#define ST_SET 1      // *SET, name, expr
+#define ST_DO 2       // *DO, name, start, end[, step]
+#define ST_ENDDO 3    // *ENDDO
+#define MAXDEPTH 16   // Nested *DO loops
+#define LOOP_TOL 1e-9 // Rounding of the loop count, in steps
+
+
+/*
+ * A line tokenized once.  The numeric arguments of a command, and those
+ * of *SET and *DO, are compiled as expressions over the script's
+ * variables, and the others kept as text, so running the line again
+ * only evaluates the expressions.
+ */
+struct statement{
+  int kind;
+  int line;
+  char* tokens;           // Copy of the line the fields point into
+  struct instruction ins;
+  const struct command* command;
+  struct expr** args;     // Compiled argument, or NULL for text
+  int var;                // Variable of *SET and *DO
+  int jump;               // *DO: its *ENDDO.  *ENDDO: its *DO.
+  double start, step;     // Running *DO loop
+  int count, k;
+};
+
+
+struct script{
+  struct var_table* vars;
+  struct list* statements;  // Not yet run, one line or a whole loop
+  int open[MAXDEPTH];       // Unclosed *DO statements
+  int depth;
+};
+
+
+static struct script* new_script(){
+  struct script* s = malloc(sizeof(struct script));
+  s->vars = new_var_table();
+  s->statements = new_list();
+  s->depth = 0;
+  return s;
+}
+
+
+static void free_statement(void* statement){
+  struct statement* st = statement;
+  int i;
+  for (i=0; i<st->ins.argc; i++){
+    if (st->args[i] != NULL)
+      free_expr(st->args[i]);
+  }
+  free(st->args);
+  free(st->ins.argv), free(st->tokens);
+  free(st);
+}
+
+
+static void clear_statements(struct script* s){
+  free_items(s->statements, free_statement);
+  s->statements->nitems = 0;
+}
+
+
+static void free_script(struct script* s){
+  clear_statements(s);
+  free_list(s->statements);
+  free_var_table(s->vars);
+  free(s);
+}
+
+
+static int variable_name(char* name){
+  int i;
+  if (!isalpha((unsigned char) name[0]) && name[0] != '_')
+    return 0;
+  for (i=1; name[i] != '\0'; i++){
+    if (!isalnum((unsigned char) name[i]) && name[i] != '_')
+      return 0;
+  }
+  return 1;
+}
+
+
+static int compile_args(struct script* s, struct statement* st, int first){
+  // Arguments from first on must be expressions
+  int i;
+  for (i=first; i<st->ins.argc; i++){
+    st->args[i] = compile_expr(st->ins.argv[i], s->vars);
+    if (st->args[i] == NULL){
+      lprintf("Error: Invalid expression: %s\n", st->ins.argv[i]);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+
+static int compile_control(struct script* s, struct statement* st){
+  // Script control statements, with their variables defined from here on
+  char* command = st->ins.command;
+  struct statement* loop;
+  int argc = st->ins.argc;
+  if (strcmp("*ENDDO", command) == 0){
+    st->kind = ST_ENDDO;
+    if (argc != 0){
+      print_argc_error(command, 0, argc);
+      return 1;
+    }
+    if (s->depth == 0){
+      lprintf("Error: *ENDDO without *DO\n");
+      return 1;
+    }
+    st->jump = s->open[--s->depth];
+    loop = s->statements->array[st->jump];
+    loop->jump = s->statements->nitems;
+    return 0;
+  }
+  st->kind = strcmp("*SET", command) == 0 ? ST_SET : ST_DO;
+  if (st->kind == ST_SET && argc != 2){
+    print_argc_error(command, 2, argc);
+    return 1;
+  }
+  if (st->kind == ST_DO && argc != 3 && argc != 4){
+    lprintf("Error: *DO takes a variable, start, end and step\n");
+    return 1;
+  }
+  if (!variable_name(st->ins.argv[0])){
+    lprintf("Error: Invalid variable name: %s\n", st->ins.argv[0]);
+    return 1;
+  }
+  if (compile_args(s, st, 1) != 0)
+    return 1;
+  st->var = define_var(s->vars, st->ins.argv[0]);
+  if (st->kind == ST_DO){
+    if (s->depth == MAXDEPTH){
+      lprintf("Error: *DO loops nested too deeply\n");
+      return 1;
+    }
+    s->open[s->depth++] = s->statements->nitems;
+  }
+  return 0;
+}
+
+
+static int compile_statement(struct script* s, char* line, int line_number){
+  // Appends the statement of a command line to the script
+  struct statement* st = calloc(1, sizeof(struct statement));
   char* fields[MAXFIELDS];
-  struct instruction next_instruction;
-  next_instruction.argc = 0;
-  next_instruction.argv = fields;
+  char *arg, type;
+  int i, n, status = 0;
+  st->line = line_number;
+  st->tokens = malloc(strlen(line)+1);
+  strcpy(st->tokens, line);
+  st->ins.argv = fields;
+  if (parse(st->tokens, &st->ins) != 0){
+    free(st->tokens), free(st);
+    return 1;
+  }
+  n = st->ins.argc;
+  st->ins.argv = malloc((n > 0 ? n : 1)*sizeof(char*));
+  memcpy(st->ins.argv, fields, n*sizeof(char*));
+  st->args = calloc(n > 0 ? n : 1, sizeof(struct expr*));
+  strtoupper(st->ins.command);
+  if (strcmp("*SET", st->ins.command) == 0 ||
+      strcmp("*DO", st->ins.command) == 0 ||
+      strcmp("*ENDDO", st->ins.command) == 0)
+    status = compile_control(s, st);
+  else{
+    // Keywords and file names stay text, as do node set names
+    st->kind = ST_COMMAND;
+    st->command = find_command(st->ins.command);
+    if (st->command == NULL || !valid_argc(st->command, n))
+      status = 1;
+    for (i=0; i<n && status == 0; i++){
+      arg = st->ins.argv[i];
+      type = argument_type(st->command, i);
+      if (type == 's')
+	continue;
+      st->args[i] = compile_expr(arg, s->vars);
+      if (st->args[i] == NULL && (type != 'n' ||
+	  !(isalpha((unsigned char) arg[0]) || arg[0] == '_'))){
+	lprintf("Error: Invalid expression: %s\n", arg);
+	status = 1;
+      }
+    }
+  }
+  if (status != 0){
+    free_statement(st);
+    return 1;
+  }
+  append(s->statements, st);
+  return 0;
+}
+
+
+static int run_statements(struct model* running_model, struct script* s,
+			  int* finished){
+  // Runs the pending statements.  Returns 1 for an execution error.
+  struct list* statements = s->statements;
+  double* values = s->vars->values;
+  struct statement *st, *loop;
+  struct argument args[MAXFIELDS];
+  double end;
+  int i, status, pc = 0;
+  while (pc < statements->nitems){
+    st = statements->array[pc];
+    if (st->kind == ST_SET){
+      values[st->var] = eval_expr(st->args[1], values);
+      pc++;
+    }
+    else if (st->kind == ST_DO){
+      st->start = eval_expr(st->args[1], values);
+      end = eval_expr(st->args[2], values);
+      st->step = st->ins.argc == 4 ? eval_expr(st->args[3], values) : 1.0;
+      if (st->step == 0.0 || isnan(st->step)){
+	lprintf("Error: Invalid *DO step: %g\n", st->step);
+	print_script_error("Execution", st->line);
+	return 1;
+      }
+      // Bounds are evaluated once, on entry
+      st->count = floor((end - st->start)/st->step + LOOP_TOL) + 1;
+      st->k = 0;
+      values[st->var] = st->start;
+      pc = st->count > 0 ? pc+1 : st->jump+1;
+    }
+    else if (st->kind == ST_ENDDO){
+      loop = statements->array[st->jump];
+      if (++loop->k < loop->count){
+	values[loop->var] = loop->start + loop->k*loop->step;
+	pc = st->jump+1;
+      }
+      else
+	pc++;
+    }
+    else{
+      status = 0;
+      for (i=0; i<st->ins.argc && status == 0; i++){
+	args[i].text = st->ins.argv[i];
+	if (st->args[i] != NULL)
+	  status = number_argument(argument_type(st->command, i),
+				   eval_expr(st->args[i], values),
+				   st->ins.argv[i], &args[i]);
+      }
+      if (status != 0 ||
+	  run_command(running_model, st->command, st->ins.argc, args) != 0){
+	print_script_error("Execution", st->line);
+	return 1;
+      }
+      if (strcmp("FINISH", st->ins.command) == 0){
+	*finished = 1;
+	return 0;
+      }
+      pc++;
+    }
+  }
+  return 0;
+}
 
-  int exec_status, parse_status;
-  int line_number = 0;
 
-  // Attempt to parse and execute each non-whitespace and non-comment line
-  while(fgets(buffer, MAXBUFFER, script_file) != NULL){
+int run_script(struct model* running_model, FILE* script_file){
+  // Each line is echoed and compiled as it is read.  A line outside any
+  // *DO loop runs at once, and a loop once its *ENDDO has been read.
+  // The script ends at FINISH, which frees the model.  A script that
+  // fails or ends without FINISH has its model freed here.
+  char buffer[MAXBUFFER];
+  struct script* s = new_script();
+  struct statement* st;
+  int status = 0, finished = 0, line_number = 0;
+
+  // Attempt to compile and run each non-whitespace and non-comment line
+  while (status == 0 && !finished &&
+	 fgets(buffer, MAXBUFFER, script_file) != NULL){
     line_number++;
-    if (!whitespace_line(buffer) && !comment_line(buffer)){
-      printf("%s", buffer);
-      parse_status = parse(buffer, &next_instruction);
-      if (parse_status != 0){
+    if (command_line(buffer)){
+      lprintf("%s", buffer);
+      if (compile_statement(s, buffer, line_number) != 0){
 	print_script_error("Parsing", line_number);
-      	return 1;
+	status = 1;
       }
-      exec_status = execute(running_model, &next_instruction);
-      if (exec_status != 0){
-      	print_script_error("Execution", line_number);
-      	return 1;
+      else if (s->depth == 0){
+	status = run_statements(running_model, s, &finished);
+	clear_statements(s);
       }
     }
   }
-  return 0;
+  if (status == 0 && s->depth > 0){
+    st = s->statements->array[s->open[s->depth-1]];
+    lprintf("Error: *DO without *ENDDO\n");
+    print_script_error("Parsing", st->line);
+    status = 1;
+  }
+  free_script(s);
+  if (!finished)
+    free_model(running_model);
+  return status;
 }
 
 
@@ -129,179 +470,388 @@ int run_script(struct model* running_model, FILE* script_file){
 
 
 static int exec_new_node(struct model* running_model,
-			  int argc, char* argv[]){
+			  int argc, struct argument* args){
   // X Coor, Y Coor
-  double x = atof(argv[0]);
-  double y = atof(argv[1]);
+  double x = args[0].real;
+  double y = args[1].real;
   new_model_node(running_model, x, y);
   return 0;
 }
 
 
 static int exec_new_element(struct model* running_model,
-			     int argc, char* argv[]){
-  int et_id = atoi(argv[0]);
+			     int argc, struct argument* args){
+  int et_id = args[0].integer;
   int* IEN = malloc((argc-1)*sizeof(int));
   int i;
   for (i=1; i<argc; i++)
-    IEN[i-1] = atoi(argv[i]);
-  new_model_element(running_model, et_id, IEN);
-  return 0;
+    IEN[i-1] = args[i].integer;
+  return new_model_element(running_model, et_id, IEN, argc-1);
+}
+
+
+static int exec_merge_nodes(struct model* running_model,
+			    int argc, struct argument* args){
+  double tol = argc == 1 ? args[0].real : 0.0;
+  return merge_model_nodes(running_model, tol);
+}
+
+
+static int exec_reorder_mesh(struct model* running_model,
+			     int argc, struct argument* args){
+  char* curve = "HILBERT";
+  if (argc == 1){
+    strtoupper(args[0].text);
+    curve = args[0].text;
+  }
+  return reorder_model_mesh(running_model, curve);
 }
 
 
 static int exec_new_element_type(struct model* running_model,
-				 int argc, char* argv[]){
-  assert(argc == 2);
-  int et_id = atoi(argv[0]);
-  strtoupper(argv[1]);
-  char* type_name = argv[1]; 
-  new_model_element_type(running_model, et_id, type_name);
-  return 0;
+				 int argc, struct argument* args){
+  int et_id = args[0].integer;
+  strtoupper(args[1].text);
+  char* type_name = args[1].text; 
+  return new_model_element_type(running_model, et_id, type_name);
 }
 
 
 static int exec_set_keyopt(struct model* running_model,
-				 int argc, char* argv[]){
-  assert(argc == 3);
-  int et_id = atoi(argv[0]);
-  int key = atoi(argv[1]);
-  int option = atoi(argv[2]);
-  set_model_et_keyopt(running_model, et_id, key, option);
-  return 0;
+				 int argc, struct argument* args){
+  int et_id = args[0].integer;
+  int key = args[1].integer;
+  int option = args[2].integer;
+  return set_model_et_keyopt(running_model, et_id, key, option);
 }
 
 
 static int exec_set_real_constant(struct model* running_model,
-				 int argc, char* argv[]){
-  assert(argc == 3);
-  int et_id = atoi(argv[0]);
-  int const_id = atoi(argv[1]);
-  double value = atof(argv[2]);
-  set_model_et_real_constant(running_model, et_id, const_id, value);
-  return 0;
+				 int argc, struct argument* args){
+  int et_id = args[0].integer;
+  int const_id = args[1].integer;
+  double value = args[2].real;
+  return set_model_et_real_constant(running_model, et_id, const_id, value);
 }
 
 
 static int exec_set_matprop(struct model* running_model,
-			    int argc, char* argv[]){
-  assert(argc == 3);
-  int et_id = atoi(argv[0]);
-  strtoupper(argv[1]);
-  char* prop_name = argv[1];
-  double value = atof(argv[2]);
-  set_model_et_matprop(running_model, et_id, prop_name, value);
-  return 0;
+			    int argc, struct argument* args){
+  int et_id = args[0].integer;
+  strtoupper(args[1].text);
+  char* prop_name = args[1].text;
+  double value = args[2].real;
+  return set_model_et_matprop(running_model, et_id, prop_name, value);
+}
+
+
+static int* node_ids(struct model* running_model, struct argument* arg,
+		     int* n){
+  // The node number of arg, or the nodes of the set it names, in a new
+  // array.  NULL for an invalid node or an unknown set.
+  int* ids;
+  if (arg->text != NULL)
+    return get_model_nodes(running_model, arg->text, n);
+  if (arg->integer < 0 || arg->integer >= running_model->nodes->nitems){
+    lprintf("Error: Invalid node %d\n", arg->integer);
+    return NULL;
+  }
+  ids = malloc(sizeof(int));
+  ids[0] = arg->integer;
+  *n = 1;
+  return ids;
 }
 
 
 static int exec_add_essential_bc(struct model* running_model,
-				 int argc, char* argv[]){
-  assert(argc == 3);
-  int node_id = atoi(argv[0]);
-  strtoupper(argv[1]);
-  char* comp = argv[1];
-  double value = atof(argv[2]);
-  add_model_essential_bc(running_model, node_id, comp, value);
+				 int argc, struct argument* args){
+  // The node may be a node set name
+  int i, n;
+  int* ids = node_ids(running_model, &args[0], &n);
+  strtoupper(args[1].text);
+  char* comp = args[1].text;
+  double value = args[2].real;
+  if (ids == NULL)
+    return 1;
+  for (i=0; i<n; i++)
+    add_model_essential_bc(running_model, ids[i], comp, value);
+  free(ids);
   return 0;
 }
 
 
-static int exec_add_nodal_force(struct model* running_model,
-				int argc, char* argv[]){
-  assert(argc == 3);
-  int node_id = atoi(argv[0]);
-  strtoupper(argv[1]);
-  char* comp = argv[1];
-  double value = atof(argv[2]);
-  add_model_nodal_force(running_model, node_id, comp, value);
+static int exec_delete_essential_bc(struct model* running_model,
+				    int argc, struct argument* args){
+  int node_id = args[0].integer;
+  strtoupper(args[1].text);
+  char* comp = args[1].text;
+  delete_model_essential_bc(running_model, node_id, comp);
   return 0;
 }
 
 
+static int exec_select_nodes(struct model* running_model,
+			     int argc, struct argument* args){
+  double values[MAXFIELDS];
+  int i;
+  strtoupper(args[1].text);
+  for (i=2; i<argc; i++)
+    values[i-2] = args[i].real;
+  return select_model_nodes(running_model, args[0].text, args[1].text,
+			    argc-2, values);
+}
+
+
+static int exec_set_bc_mode(struct model* running_model,
+			    int argc, struct argument* args){
+  int mode = args[0].integer;
+  double scale = argc == 2 ? args[1].real : 0.0;
+  return set_model_bc_mode(running_model, mode, scale);
+}
+
+
+static int exec_add_nodal_force(struct model* running_model,
+				int argc, struct argument* args){
+  // The node may be a node set name, each of its nodes taking the force
+  int i, n, status = 0;
+  int* ids = node_ids(running_model, &args[0], &n);
+  strtoupper(args[1].text);
+  char* comp = args[1].text;
+  double value = args[2].real;
+  if (ids == NULL)
+    return 1;
+  for (i=0; i<n && status == 0; i++)
+    status = add_model_nodal_force(running_model, ids[i], comp, value);
+  free(ids);
+  return status;
+}
+
+
+static int exec_add_master(struct model* running_model,
+			   int argc, struct argument* args){
+  int node_id = args[0].integer;
+  return add_model_master(running_model, node_id);
+}
+
+
+static int exec_generate_superelement(struct model* running_model,
+				      int argc, struct argument* args){
+  int se_id = args[0].integer;
+  return generate_model_superelement(running_model, se_id);
+}
+
+
+static int exec_set_superelement(struct model* running_model,
+				 int argc, struct argument* args){
+  int et_id = args[0].integer;
+  int se_id = args[1].integer;
+  return set_model_et_superelement(running_model, et_id, se_id);
+}
+
+
+static int exec_expand_superelement(struct model* running_model,
+				    int argc, struct argument* args){
+  int elem_id = args[0].integer;
+  return expand_model_superelement(running_model, elem_id);
+}
+
+
+static int exec_set_subdomains(struct model* running_model,
+			       int argc, struct argument* args){
+  int nsub = args[0].integer;
+  return set_model_subdomains(running_model, nsub);
+}
+
+
+static int exec_adapt_model(struct model* running_model,
+			    int argc, struct argument* args){
+  double target = args[0].real;  // Relative error, percent
+  int max_cycles = args[1].integer;
+  int s_type = argc == 3 ? args[2].integer : 0;
+  return adapt_model(running_model, target, max_cycles, s_type);
+}
+
+
 static int exec_model_solve(struct model* running_model,
-			     int argc, char* argv[]){
-  assert(argc == 2);
-  int p_type = atoi(argv[0]); // Physics type
-  int s_type = atoi(argv[1]); // Solver type
-  solve_model(running_model, p_type, s_type);
-  return 0;
+			     int argc, struct argument* args){
+  int p_type = args[0].integer; // Physics type
+  int s_type = args[1].integer; // Solver type
+  return solve_model(running_model, p_type, s_type);
+}
+
+
+static int exec_model_solve_nonlinear(struct model* running_model,
+				      int argc, struct argument* args){
+  int nsteps = args[0].integer;   // Load steps
+  int mode = args[1].integer;     // Tangent update mode
+  int max_iter = argc > 2 ? args[2].integer : 25;   // Per load step
+  double tol = argc > 3 ? args[3].real : 1e-6;   // Relative residual
+  return solve_model_nonlinear(running_model, nsteps, mode, max_iter, tol);
+}
+
+
+static int exec_model_resolve(struct model* running_model,
+			int argc, struct argument* args){
+  return resolve_model(running_model);
+}
+
+
+static int exec_model_solve_parametric(struct model* running_model,
+			int argc, struct argument* args){
+  return solve_model_parametric(running_model);
+}
+
+
+static int exec_save_model(struct model* running_model,
+			   int argc, struct argument* args){
+  char* filename = args[0].text;
+  return save_model(running_model, filename);
+}
+
+
+static int exec_resume_model(struct model* running_model,
+			     int argc, struct argument* args){
+  char* filename = args[0].text;
+  return resume_model(running_model, filename);
 }
 
 
 static int exec_print_nodal_soln(struct model* running_model,
-				 int argc, char* argv[]){
-  assert(argc == 1);
-  strtoupper(argv[0]);
-  char* res_name = argv[0];
-  print_model_result(running_model, res_name);
-  return 0;
+				 int argc, struct argument* args){
+  strtoupper(args[0].text);
+  char* res_name = args[0].text;
+  return print_model_result(running_model, res_name);
 }
 
 
-static int exec_print_mesh(struct model* running_model){
+static int exec_probe_result(struct model* running_model,
+			     int argc, struct argument* args){
+  double x = args[0].real;
+  double y = args[1].real;
+  return probe_model_result(running_model, x, y);
+}
+
+
+static int exec_write_results(struct model* running_model,
+			      int argc, struct argument* args){
+  strtoupper(args[0].text);
+  char* format = args[0].text;
+  char* filename = args[1].text;
+  int background = argc == 3 ? args[2].integer : 0;
+  return write_model_results(running_model, format, filename, background);
+}
+
+
+static int exec_print_mesh(struct model* running_model,
+			int argc, struct argument* args){
   print_model_mesh(running_model);
   return 0;
 }
 
 
-static int exec_free_model(struct model* running_model){
+static int exec_free_model(struct model* running_model,
+			int argc, struct argument* args){
   free_model(running_model);
   return 0;
 }
 
 
+/*
+ * Model commands, with the type of each argument, the last one repeating:
+ *   f = real, i = integer, n = node number or node set name, s = text
+ * In scripts only the f, i and n arguments may be expressions.
+ */
+static const struct command{
+  char* name;
+  char* types;
+  int min_argc;
+  int max_argc;
+  int (*exec)(struct model* running_model, int argc, struct argument* args);
+} commands[] = {
+  {"N", "ff", 2, 2, exec_new_node},
+  {"E", "i", 2, MAXFIELDS, exec_new_element},
+  {"NUMMRG", "f", 0, 1, exec_merge_nodes},
+  {"REORDER", "s", 0, 1, exec_reorder_mesh},
+  {"ET", "is", 2, 2, exec_new_element_type},
+  {"KEYOPT", "iii", 3, 3, exec_set_keyopt},
+  {"R", "iif", 3, 3, exec_set_real_constant},
+  {"MP", "isf", 3, 3, exec_set_matprop},
+  {"D", "nsf", 3, 3, exec_add_essential_bc},
+  {"DDELE", "is", 2, 2, exec_delete_essential_bc},
+  {"NSEL", "ssf", 2, MAXFIELDS, exec_select_nodes},
+  {"BCMODE", "if", 1, 2, exec_set_bc_mode},
+  {"F", "nsf", 3, 3, exec_add_nodal_force},
+  {"M", "i", 1, 1, exec_add_master},
+  {"SEGEN", "i", 1, 1, exec_generate_superelement},
+  {"SE", "ii", 2, 2, exec_set_superelement},
+  {"SEEXP", "i", 1, 1, exec_expand_superelement},
+  {"DDOPT", "i", 1, 1, exec_set_subdomains},
+  {"SOLVE", "ii", 2, 2, exec_model_solve},
+  {"NLSOLVE", "iiif", 2, 4, exec_model_solve_nonlinear},
+  {"RESOLVE", "", 0, 0, exec_model_resolve},
+  {"PSOLVE", "", 0, 0, exec_model_solve_parametric},
+  {"SAVE", "s", 1, 1, exec_save_model},
+  {"RESUME", "s", 1, 1, exec_resume_model},
+  {"ADAPT", "fii", 2, 3, exec_adapt_model},
+  {"PRNSOL", "s", 1, 1, exec_print_nodal_soln},
+  {"PROBE", "ff", 2, 2, exec_probe_result},
+  {"OUTRES", "ssi", 2, 3, exec_write_results},
+  {"PRMESH", "", 0, 0, exec_print_mesh},
+  {"FINISH", "", 0, 0, exec_free_model}};
+
+
+static const struct command* find_command(char* name){
+  int n = sizeof(commands)/sizeof(commands[0]), i;
+  for (i=0; i<n; i++){
+    if (strcmp(commands[i].name, name) == 0)
+      return &commands[i];
+  }
+  lprintf("Error: Invalid command: %s\n", name);
+  return NULL;
+}
+
+
+static char argument_type(const struct command* c, int i){
+  int n = strlen(c->types);
+  return c->types[i < n ? i : n-1];
+}
+
+
+static int valid_argc(const struct command* c, int argc){
+  // Checked before the command runs, so a bad line fails the command
+  // instead of the process
+  if (argc >= c->min_argc && argc <= c->max_argc)
+    return 1;
+  if (c->min_argc == c->max_argc)
+    print_argc_error(c->name, c->min_argc, argc);
+  else
+    lprintf("Invalid number of arguments for %s.  Expected %d to %d, "
+	    "got %d\n", c->name, c->min_argc, c->max_argc, argc);
+  return 0;
+}
+
+
+static int run_command(struct model* running_model, const struct command* c,
+		       int argc, struct argument* args){
+  return c->exec(running_model, argc, args);
+}
+
+
 int execute(struct model* running_model, struct instruction* next_instruction){
   /* Executes instructions supplied by the parser
    Returns 0 for successful execution
    Returns 1 for unsuccessful execution */
-  
-  int return_code = 0;
+  struct argument args[MAXFIELDS];
+  const struct command* c;
+  int argc = next_instruction->argc, i;
   strtoupper(next_instruction->command);
-  char* command_code = next_instruction->command;
-  int argc = next_instruction->argc;
-  char** argv = next_instruction->argv;
-
-  if (strcmp("N", command_code) == 0)
-    return exec_new_node(running_model, argc, argv);
-  
-  else if (strcmp("E", command_code) == 0)
-    return exec_new_element(running_model, argc, argv);
-  
-  else if (strcmp("ET", command_code) == 0)
-    return exec_new_element_type(running_model, argc, argv);
-  
-  else if (strcmp("KEYOPT", command_code) == 0)
-    return exec_set_keyopt(running_model, argc, argv);
-  
-  else if (strcmp("R", command_code) == 0)
-    return exec_set_real_constant(running_model, argc, argv);
-  
-  else if (strcmp("MP", command_code) == 0)
-    return exec_set_matprop(running_model, argc, argv);
-  
-  else if (strcmp("D", command_code) == 0)
-    return exec_add_essential_bc(running_model, argc, argv);
-  
-  else if (strcmp("F", command_code) == 0)
-    return exec_add_nodal_force(running_model, argc, argv);
-  
-  else if (strcmp("SOLVE", command_code) == 0)
-    return exec_model_solve(running_model, argc, argv);
-  
-  else if (strcmp("PRNSOL", command_code) == 0)
-    return exec_print_nodal_soln(running_model, argc, argv);
-  
-  else if (strcmp("PRMESH", command_code) == 0)
-    return exec_print_mesh(running_model);
-  
-  else if (strcmp("FINISH", command_code) == 0)
-    return exec_free_model(running_model);
-  
-  else{
-    printf("Error: Invalid command: %s\n", command_code);
+  c = find_command(next_instruction->command);
+  if (c == NULL || !valid_argc(c, argc))
     return 1;
+  for (i=0; i<argc; i++){
+    if (text_argument(argument_type(c, i), next_instruction->argv[i],
+		      &args[i]) != 0)
+      return 1;
   }
+  return run_command(running_model, c, argc, args);
 }
-
-
@@ -1,12 +1,22 @@
 /*
 Publically available parser and interpreter functions
+
+Besides model commands, scripts may hold
+  *SET, name, expr                    Scalar variable
+  *DO, name, start, end[, step]       Loop, up to the matching *ENDDO
+  *ENDDO
+and command arguments may be expressions over the variables (expr.h).
 */
 
+#define MAXFIELDS 100  // Superelements may have many master nodes
+
 struct instruction{
   char* command;
   int argc;
   char** argv;
 };
 
+int parse(char* line, struct instruction* next_instruction);
+int command_line(char* line);
 int run_script(struct model* running_model, FILE* script_file);
 int execute(struct model* running_model, struct instruction* next_instruction);
@@ -0,0 +1,129 @@
+/*
+Batched stiffness matrices for SPLANE4 and TPLANE4 elements.  The kernel
+in ke_batch_kernel.h is compiled three times, once per vector width,
+and the widest one the CPU supports is used.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "lib/list.h"
+#include "lib/linalg.h"
+#include "lib/quadrature.h"
+#include "mesh.h"
+#include "element_types.h"
+#include "ke_batch.h"
+
+
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+#define KERNEL quad4_KE_avx512
+#define KERNEL_VEC vec8
+#define LANES 8
+#include "ke_batch_kernel.h"
+#undef KERNEL
+#undef KERNEL_VEC
+#undef LANES
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+#define KERNEL quad4_KE_avx2
+#define KERNEL_VEC vec4
+#define LANES 4
+#include "ke_batch_kernel.h"
+#undef KERNEL
+#undef KERNEL_VEC
+#undef LANES
+#pragma GCC pop_options
+
+#define KERNEL quad4_KE_scalar
+#define KERNEL_VEC vec1
+#define LANES 1
+#include "ke_batch_kernel.h"
+#undef KERNEL
+#undef KERNEL_VEC
+#undef LANES
+
+
+static int batch_width = 0;
+
+
+int ke_batch_width(){
+  // Lanes per batch, detected from the CPU on first use
+  if (batch_width == 0){
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+      batch_width = 8;
+    else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+      batch_width = 4;
+    else
+      batch_width = 1;
+  }
+  return batch_width;
+}
+
+
+void set_ke_batch_width(int lanes){
+  // Overrides the detected width.  0 restores detection.
+  assert(lanes == 0 || lanes == 1 || lanes == 4 || lanes == 8);
+  batch_width = lanes;
+}
+
+
+int batched_element(struct et_def* et){
+  return et->lib_id == 4 || et->lib_id == 14;
+}
+
+
+void batch_KE(struct et_def* et, struct list* nodes,
+	      struct element** elements, int n, struct matrix** KE){
+  // Computes KE for n <= ke_batch_width() elements of type et.
+  // Unused lanes repeat the first element.
+  int lanes = ke_batch_width();
+  int nint_pts = et->sdata->nint_pts;
+  int ndof = et->ndof, nedof = 4*et->ndof;
+  int a, i, j, k, l;
+  double xs[4][KE_BATCH_MAX], ys[4][KE_BATCH_MAX];
+  double dN[QUAD_MAXPTS][4][2], D[9];
+  double KEs[64][KE_BATCH_MAX];
+  struct matrix* NDERNAT;
+  struct node* nd;
+  assert(batched_element(et) && n > 0 && n <= lanes);
+  assert(nint_pts <= QUAD_MAXPTS);
+  for (k=0; k<nint_pts; k++){
+    NDERNAT = et->sdata->NDERNATs->array[k];
+    for (a=0; a<4; a++){
+      dN[k][a][0] = NDERNAT->array[a][0];
+      dN[k][a][1] = NDERNAT->array[a][1];
+    }
+  }
+  for (i=0; i<et->sdata->D->nrows; i++){
+    for (j=0; j<et->sdata->D->ncols; j++)
+      D[et->sdata->D->ncols*i+j] = et->sdata->D->array[i][j];
+  }
+  for (l=0; l<lanes; l++){
+    for (a=0; a<4; a++){
+      nd = nodes->array[elements[l < n ? l : 0]->IEN[a]];
+      xs[a][l] = nd->x;
+      ys[a][l] = nd->y;
+    }
+  }
+  if (lanes == 8)
+    quad4_KE_avx512(ndof, nint_pts, et->sdata->int_wts, dN, D, et->consts[1],
+		    xs, ys, KEs);
+  else if (lanes == 4)
+    quad4_KE_avx2(ndof, nint_pts, et->sdata->int_wts, dN, D, et->consts[1],
+		  xs, ys, KEs);
+  else
+    quad4_KE_scalar(ndof, nint_pts, et->sdata->int_wts, dN, D, et->consts[1],
+		    xs, ys, KEs);
+  for (l=0; l<n; l++){
+    KE[l] = new_matrix(nedof, nedof);
+    for (i=0; i<nedof; i++){
+      for (j=0; j<nedof; j++)
+	KE[l]->array[i][j] = KEs[nedof*i+j][l];
+    }
+  }
+}
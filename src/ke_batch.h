@@ -0,0 +1,15 @@
+/*
+Batched stiffness kernels.  Several elements of the same type are
+gathered into the lanes of SIMD vectors and their stiffness matrices
+computed together.  The vector width is chosen at runtime from the CPU
+features: 8 lanes with AVX-512, 4 with AVX2, or a scalar fallback.
+*/
+
+#define KE_BATCH_MAX 8
+
+
+int ke_batch_width();
+void set_ke_batch_width(int lanes);
+int batched_element(struct et_def* et);
+void batch_KE(struct et_def* et, struct list* nodes,
+	      struct element** elements, int n, struct matrix** KE);
@@ -0,0 +1,82 @@
+/*
+Batched 4-node quadrilateral stiffness kernel, written once and compiled
+for several vector widths.  This file is included by ke_batch.c with
+KERNEL (function name) and LANES (elements per batch) defined, inside
+the matching target pragma, and KERNEL_VEC naming the vector type to
+declare.  Each lane of a vector holds one element.
+
+Coordinates arrive as structure of arrays: xs[a] holds the x coordinate
+of local node a for every lane.  KEs receives the (4*ndof)^2 entries in
+row major order, one lane per element, already multiplied by the
+thickness.
+*/
+
+typedef double KERNEL_VEC __attribute__((vector_size(LANES*sizeof(double))));
+
+
+static void KERNEL(int ndof, int nint_pts, const double* int_wts,
+		   const double (*dN)[4][2], const double* D, double t,
+		   const double (*xs)[KE_BATCH_MAX],
+		   const double (*ys)[KE_BATCH_MAX],
+		   double (*KEs)[KE_BATCH_MAX]){
+  KERNEL_VEC X[4], Y[4], KE[64];
+  KERNEL_VEC J00, J01, J10, J11, det, inv, Ji00, Ji01, Ji10, Ji11, scale;
+  KERNEL_VEC Nx[4], Ny[4], r0[3], r1[3];
+  const KERNEL_VEC zero = {0.0};
+  int n = 4*ndof;
+  int a, b, k, m;
+  for (a=0; a<4; a++){
+    memcpy(&X[a], xs[a], sizeof(KERNEL_VEC));
+    memcpy(&Y[a], ys[a], sizeof(KERNEL_VEC));
+  }
+  for (m=0; m<n*n; m++)
+    KE[m] = zero;
+  for (k=0; k<nint_pts; k++){
+    // Jacobian J = COORDS*NDERNAT and its inverse
+    J00 = J01 = J10 = J11 = zero;
+    for (a=0; a<4; a++){
+      J00 += X[a]*dN[k][a][0];
+      J01 += X[a]*dN[k][a][1];
+      J10 += Y[a]*dN[k][a][0];
+      J11 += Y[a]*dN[k][a][1];
+    }
+    det = J00*J11 - J10*J01;
+    inv = 1.0/det;
+    Ji00 = J11*inv, Ji01 = -J01*inv;
+    Ji10 = -J10*inv, Ji11 = J00*inv;
+    scale = det*(int_wts[k]*t);
+    // Global shape function derivatives NDERGLB = NDERNAT*inv(J)
+    for (a=0; a<4; a++){
+      Nx[a] = dN[k][a][0]*Ji00 + dN[k][a][1]*Ji10;
+      Ny[a] = dN[k][a][0]*Ji01 + dN[k][a][1]*Ji11;
+    }
+    // Upper triangle of sum w*det(J)*B^T*D*B
+    for (a=0; a<4; a++){
+      if (ndof == 2){
+	for (m=0; m<3; m++){
+	  r0[m] = (Nx[a]*D[m] + Ny[a]*D[6+m])*scale;
+	  r1[m] = (Ny[a]*D[3+m] + Nx[a]*D[6+m])*scale;
+	}
+	for (b=a; b<4; b++){
+	  KE[(2*a)*n+2*b] += r0[0]*Nx[b] + r0[2]*Ny[b];
+	  KE[(2*a)*n+2*b+1] += r0[1]*Ny[b] + r0[2]*Nx[b];
+	  KE[(2*a+1)*n+2*b] += r1[0]*Nx[b] + r1[2]*Ny[b];
+	  KE[(2*a+1)*n+2*b+1] += r1[1]*Ny[b] + r1[2]*Nx[b];
+	}
+      }
+      else{
+	r0[0] = (Nx[a]*D[0] + Ny[a]*D[2])*scale;
+	r0[1] = (Nx[a]*D[1] + Ny[a]*D[3])*scale;
+	for (b=a; b<4; b++)
+	  KE[a*n+b] += r0[0]*Nx[b] + r0[1]*Ny[b];
+      }
+    }
+  }
+  // Mirror the lower triangle
+  for (a=0; a<n; a++){
+    for (b=0; b<a; b++)
+      KE[a*n+b] = KE[b*n+a];
+  }
+  for (m=0; m<n*n; m++)
+    memcpy(KEs[m], &KE[m], sizeof(KERNEL_VEC));
+}
@@ -0,0 +1,468 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include "log.h"
+#include "linalg.h"
+#include "sparse_linalg.h"
+#include "amg.h"
+
+
+#define AMG_THETA 0.08      // Strength of connection threshold
+#define AMG_COARSE 64       // Largest operator solved directly
+#define AMG_MAXLEVELS 10
+#define AMG_MINRATIO 0.8    // Coarsening below this ratio counts as stalled
+#define POWER_ITERS 20
+#define QR_TOL 1e-10        // Relative size of dropped near null space modes
+
+
+/*****************************************************************
+ * Aggregation
+ */
+
+
+static int* node_rows(int n, int* node, int nnodes, int** ptr_out){
+  // Rows grouped by node: node I owns rows[ptr[I]] to rows[ptr[I+1]-1]
+  int* ptr = calloc(nnodes+1, sizeof(int));
+  int* next = malloc(nnodes*sizeof(int));
+  int* rows = malloc((n > 0 ? n : 1)*sizeof(int));
+  int i;
+  for (i=0; i<n; i++)
+    ptr[node[i]+1]++;
+  for (i=0; i<nnodes; i++)
+    ptr[i+1] += ptr[i];
+  memcpy(next, ptr, nnodes*sizeof(int));
+  for (i=0; i<n; i++)
+    rows[next[node[i]]++] = i;
+  free(next);
+  *ptr_out = ptr;
+  return rows;
+}
+
+
+static int* strength_graph(struct csr_matrix* A, int* node, int nnodes,
+			   int* rptr, int* rows, int** ptr_out){
+  // Nodes I and J are strongly connected when the Frobenius norms of
+  // their blocks satisfy |A_IJ| > theta*sqrt(|A_II|*|A_JJ|)
+  int* ptr = calloc(nnodes+1, sizeof(int));
+  int* adj = malloc((A->nnz > 0 ? A->nnz : 1)*sizeof(int));
+  int* mark = malloc(nnodes*sizeof(int));
+  int* list = malloc(nnodes*sizeof(int));
+  double* norm = malloc(nnodes*sizeof(double));
+  double* dnorm = calloc(nnodes, sizeof(double));
+  int I, J, i, k, p, len, nadj = 0;
+  for (i=0; i<A->nrows; i++){
+    for (k=A->rowptr[i]; k<A->rowptr[i+1]; k++){
+      if (node[A->cols[k]] == node[i])
+	dnorm[node[i]] += A->vals[k]*A->vals[k];
+    }
+  }
+  for (I=0; I<nnodes; I++){
+    dnorm[I] = sqrt(dnorm[I]);
+    mark[I] = -1;
+  }
+  for (I=0; I<nnodes; I++){
+    len = 0;
+    for (p=rptr[I]; p<rptr[I+1]; p++){
+      i = rows[p];
+      for (k=A->rowptr[i]; k<A->rowptr[i+1]; k++){
+	J = node[A->cols[k]];
+	if (mark[J] != I){
+	  mark[J] = I;
+	  list[len++] = J;
+	  norm[J] = 0.0;
+	}
+	norm[J] += A->vals[k]*A->vals[k];
+      }
+    }
+    for (p=0; p<len; p++){
+      J = list[p];
+      if (J != I && norm[J] > AMG_THETA*AMG_THETA*dnorm[I]*dnorm[J])
+	adj[nadj++] = J;
+    }
+    ptr[I+1] = nadj;
+  }
+  free(mark), free(list), free(norm), free(dnorm);
+  *ptr_out = ptr;
+  return adj;
+}
+
+
+static int aggregate(int nnodes, int* rptr, int* ptr, int* adj, int* agg){
+  // Standard three phase aggregation of the strength graph.  Returns
+  // the number of aggregates; nodes without rows are left out (-2).
+  int* seed = malloc(nnodes*sizeof(int));
+  int I, p, free_nbrs, nagg = 0;
+  for (I=0; I<nnodes; I++)
+    agg[I] = rptr[I+1] > rptr[I] ? -1 : -2;
+  // 1. Nodes whose neighbourhood is untouched seed an aggregate
+  for (I=0; I<nnodes; I++){
+    if (agg[I] != -1)
+      continue;
+    free_nbrs = 1;
+    for (p=ptr[I]; p<ptr[I+1]; p++)
+      free_nbrs = free_nbrs && agg[adj[p]] == -1;
+    if (!free_nbrs)
+      continue;
+    agg[I] = nagg;
+    for (p=ptr[I]; p<ptr[I+1]; p++)
+      agg[adj[p]] = nagg;
+    nagg++;
+  }
+  // 2. Leftover nodes join a neighbouring aggregate from phase 1
+  memcpy(seed, agg, nnodes*sizeof(int));
+  for (I=0; I<nnodes; I++){
+    if (agg[I] != -1)
+      continue;
+    for (p=ptr[I]; p<ptr[I+1]; p++){
+      if (seed[adj[p]] >= 0){
+	agg[I] = seed[adj[p]];
+	break;
+      }
+    }
+  }
+  // 3. Whatever remains is grouped with its unaggregated neighbours
+  for (I=0; I<nnodes; I++){
+    if (agg[I] != -1)
+      continue;
+    agg[I] = nagg;
+    for (p=ptr[I]; p<ptr[I+1]; p++){
+      if (agg[adj[p]] == -1)
+	agg[adj[p]] = nagg;
+    }
+    nagg++;
+  }
+  free(seed);
+  return nagg;
+}
+
+
+/*****************************************************************
+ * Prolongation
+ */
+
+
+static struct csr_matrix* tentative_prolongator(int n, int* node, int* agg,
+						int nagg, double* B, int k,
+						int** cnode, double** Bc){
+  // Each aggregate's rows of B are factored B_a = Q_a*R_a by modified
+  // Gram-Schmidt.  Q_a are the columns of the tentative prolongator, and
+  // the R_a stacked up are the near null space on the coarse level.
+  // Modes that are dependent on an aggregate (a lone node has fewer dof
+  // than rigid body modes) are dropped.
+  struct csr_matrix* P;
+  int *aptr, *arows, *kept, *base;
+  double *Q = malloc((n > 0 ? n : 1)*k*sizeof(double));
+  double *R = calloc(nagg*k*k, sizeof(double));
+  double r, vnorm, cnorm;
+  int a, c, p, q, i, m, nc, nkept, *aggrow;
+  aggrow = malloc((n > 0 ? n : 1)*sizeof(int));
+  for (i=0; i<n; i++)
+    aggrow[i] = agg[node[i]];
+  arows = node_rows(n, aggrow, nagg, &aptr);
+  kept = calloc(nagg, sizeof(int));
+  base = calloc(nagg+1, sizeof(int));
+  for (a=0; a<nagg; a++){
+    m = aptr[a+1]-aptr[a];
+    nkept = 0;
+    for (c=0; c<k; c++){
+      // Orthogonalize mode c against the kept columns
+      for (p=0; p<m; p++){
+	i = arows[aptr[a]+p];
+	Q[i*k+nkept] = B[i*k+c];
+      }
+      cnorm = 0.0;
+      for (p=0; p<m; p++){
+	i = arows[aptr[a]+p];
+	cnorm += Q[i*k+nkept]*Q[i*k+nkept];
+      }
+      for (q=0; q<nkept; q++){
+	r = 0.0;
+	for (p=0; p<m; p++){
+	  i = arows[aptr[a]+p];
+	  r += Q[i*k+q]*Q[i*k+nkept];
+	}
+	R[(a*k+q)*k+c] = r;
+	for (p=0; p<m; p++){
+	  i = arows[aptr[a]+p];
+	  Q[i*k+nkept] -= r*Q[i*k+q];
+	}
+      }
+      vnorm = 0.0;
+      for (p=0; p<m; p++){
+	i = arows[aptr[a]+p];
+	vnorm += Q[i*k+nkept]*Q[i*k+nkept];
+      }
+      if (cnorm == 0.0 || vnorm <= QR_TOL*QR_TOL*cnorm)
+	continue;
+      vnorm = sqrt(vnorm);
+      R[(a*k+nkept)*k+c] = vnorm;
+      for (p=0; p<m; p++){
+	i = arows[aptr[a]+p];
+	Q[i*k+nkept] /= vnorm;
+      }
+      nkept++;
+    }
+    kept[a] = nkept;
+    base[a+1] = base[a]+nkept;
+  }
+  nc = base[nagg];
+  P = new_csr_matrix(n, nc, 0);
+  for (i=0; i<n; i++)
+    P->rowptr[i+1] = P->rowptr[i] + kept[aggrow[i]];
+  P->nnz = P->rowptr[n];
+  free(P->cols), free(P->vals);
+  P->cols = malloc((P->nnz > 0 ? P->nnz : 1)*sizeof(int));
+  P->vals = malloc((P->nnz > 0 ? P->nnz : 1)*sizeof(double));
+  for (i=0; i<n; i++){
+    a = aggrow[i];
+    for (q=0; q<kept[a]; q++){
+      P->cols[P->rowptr[i]+q] = base[a]+q;
+      P->vals[P->rowptr[i]+q] = Q[i*k+q];
+    }
+  }
+  // Coarse nodes are the aggregates
+  *cnode = malloc((nc > 0 ? nc : 1)*sizeof(int));
+  *Bc = malloc((nc > 0 ? nc : 1)*k*sizeof(double));
+  for (a=0; a<nagg; a++){
+    for (q=0; q<kept[a]; q++){
+      (*cnode)[base[a]+q] = a;
+      for (c=0; c<k; c++)
+	(*Bc)[(base[a]+q)*k+c] = R[(a*k+q)*k+c];
+    }
+  }
+  free(Q), free(R), free(aggrow), free(arows), free(aptr);
+  free(kept), free(base);
+  return P;
+}
+
+
+static double spectral_radius(struct csr_matrix* A, double* diag){
+  // Power iteration estimate of the largest eigenvalue of inv(D)*A
+  int n = A->nrows, i, step;
+  double *x = malloc(n*sizeof(double)), *y = malloc(n*sizeof(double));
+  double norm, rho = 0.0;
+  for (i=0; i<n; i++)
+    x[i] = 1.0 + 0.1*(i%7);
+  for (step=0; step<POWER_ITERS; step++){
+    csr_mvmult(A, x, y);
+    norm = 0.0;
+    for (i=0; i<n; i++){
+      y[i] /= diag[i];
+      norm += y[i]*y[i];
+    }
+    norm = sqrt(norm);
+    if (norm == 0.0)
+      break;
+    rho = 0.0;
+    for (i=0; i<n; i++)
+      rho += x[i]*x[i];
+    rho = norm/sqrt(rho);
+    for (i=0; i<n; i++)
+      x[i] = y[i]/norm;
+  }
+  free(x), free(y);
+  return rho;
+}
+
+
+static struct csr_matrix* smooth_prolongator(struct csr_matrix* A,
+					     double* diag,
+					     struct csr_matrix* T){
+  // P = (I - omega*inv(D)*A)*T with omega = 4/(3*rho(inv(D)*A)).  The
+  // diagonal of A is stored, so A*T has every entry of T in its pattern.
+  double omega = 4.0/(3.0*spectral_radius(A, diag));
+  struct csr_matrix* P = csr_mmmult(A, T);
+  int i, k, l;
+  for (i=0; i<P->nrows; i++){
+    for (k=P->rowptr[i]; k<P->rowptr[i+1]; k++)
+      P->vals[k] *= -omega/diag[i];
+    k = P->rowptr[i];
+    for (l=T->rowptr[i]; l<T->rowptr[i+1]; l++){
+      while (P->cols[k] != T->cols[l])
+	k++;
+      assert(k < P->rowptr[i+1]);
+      P->vals[k] += T->vals[l];
+    }
+  }
+  return P;
+}
+
+
+/*****************************************************************
+ * Hierarchy
+ */
+
+
+static double* csr_diagonal(struct csr_matrix* A){
+  double* diag = malloc(A->nrows*sizeof(double));
+  int i, k;
+  for (i=0; i<A->nrows; i++){
+    diag[i] = 0.0;
+    for (k=A->rowptr[i]; k<A->rowptr[i+1]; k++){
+      if (A->cols[k] == i)
+	diag[i] = A->vals[k];
+    }
+  }
+  return diag;
+}
+
+
+static void init_level(struct amg_level* L, struct csr_matrix* A){
+  int n = A->nrows > 0 ? A->nrows : 1;
+  L->A = A;
+  L->P = NULL;
+  L->R = NULL;
+  L->diag = csr_diagonal(A);
+  L->x = malloc(n*sizeof(double));
+  L->b = malloc(n*sizeof(double));
+  L->r = malloc(n*sizeof(double));
+}
+
+
+struct amg_hierarchy* new_amg_hierarchy(struct csr_matrix* A, int* node,
+					 int nnodes, double* B, int nmodes){
+  // node[i] is the node owning row i, and B holds the nmodes near null
+  // space vectors row major (B[i*nmodes+c]).  A is not copied and must
+  // outlive the hierarchy.  NULL if A has a zero diagonal or the
+  // coarsest operator is singular.
+  struct amg_hierarchy* H = malloc(sizeof(struct amg_hierarchy));
+  struct amg_level* L;
+  struct csr_matrix *T, *AP, *Ac;
+  int *rptr, *rows, *ptr, *adj, *agg, *cnode;
+  int *fnode = node, l, i, j, nagg;
+  double *Bc, *fB = B;
+  H->levels = malloc(AMG_MAXLEVELS*sizeof(struct amg_level));
+  init_level(&H->levels[0], A);
+  H->nlevels = 1;
+  H->LU = NULL;
+  for (i=0; i<A->nrows; i++){
+    if (H->levels[0].diag[i] == 0.0){
+      lprintf("Error: Zero diagonal in equation %d\n", i);
+      free_amg_hierarchy(H);
+      return NULL;
+    }
+  }
+  for (l=0; l<AMG_MAXLEVELS-1; l++){
+    L = &H->levels[l];
+    lprintf("AMG level %d: %d equations, %d nonzeros\n", l,
+	   L->A->nrows, L->A->nnz);
+    if (L->A->nrows <= AMG_COARSE)
+      break;
+    rows = node_rows(L->A->nrows, fnode, nnodes, &rptr);
+    adj = strength_graph(L->A, fnode, nnodes, rptr, rows, &ptr);
+    agg = malloc(nnodes*sizeof(int));
+    nagg = aggregate(nnodes, rptr, ptr, adj, agg);
+    T = tentative_prolongator(L->A->nrows, fnode, agg, nagg, fB, nmodes,
+			      &cnode, &Bc);
+    free(rows), free(rptr), free(adj), free(ptr), free(agg);
+    if (fnode != node)
+      free(fnode), free(fB);
+    fnode = cnode, fB = Bc, nnodes = nagg;
+    if (T->ncols >= AMG_MINRATIO*L->A->nrows){
+      lprintf("AMG coarsening stalled at %d equations\n", L->A->nrows);
+      free_csr_matrix(T);
+      break;
+    }
+    // Galerkin coarse operator R*A*P
+    L->P = smooth_prolongator(L->A, L->diag, T);
+    L->R = csr_transpose(L->P);
+    free_csr_matrix(T);
+    AP = csr_mmmult(L->A, L->P);
+    Ac = csr_mmmult(L->R, AP);
+    free_csr_matrix(AP);
+    init_level(&H->levels[l+1], Ac);
+  }
+  if (l == AMG_MAXLEVELS-1)
+    lprintf("AMG level %d: %d equations, %d nonzeros\n", l,
+	   H->levels[l].A->nrows, H->levels[l].A->nnz);
+  if (fnode != node)
+    free(fnode), free(fB);
+  H->nlevels = l+1;
+  // Coarsest operator is factored densely
+  Ac = H->levels[l].A;
+  H->LU = new_matrix(Ac->nrows, Ac->nrows);
+  for (i=0; i<Ac->nrows; i++){
+    for (j=Ac->rowptr[i]; j<Ac->rowptr[i+1]; j++)
+      H->LU->array[i][Ac->cols[j]] = Ac->vals[j];
+  }
+  if (luMFA(H->LU) != 0){
+    lprintf("Error: Singular coarsest AMG operator\n");
+    free_amg_hierarchy(H);
+    return NULL;
+  }
+  return H;
+}
+
+
+/*****************************************************************
+ * V-cycle
+ */
+
+
+static void gauss_seidel(struct csr_matrix* A, double* diag, double* b,
+			 double* x, int backward){
+  int n = A->nrows, i, k, step;
+  double sum;
+  for (step=0; step<n; step++){
+    i = backward ? n-1-step : step;
+    sum = b[i];
+    for (k=A->rowptr[i]; k<A->rowptr[i+1]; k++){
+      if (A->cols[k] != i)
+	sum -= A->vals[k]*x[A->cols[k]];
+    }
+    x[i] = sum/diag[i];
+  }
+}
+
+
+static void vcycle(struct amg_hierarchy* H, int l, double* b, double* x){
+  // Forward Gauss-Seidel before and backward after the coarse grid
+  // correction, so the cycle is symmetric
+  struct amg_level *L = &H->levels[l], *C;
+  struct vector v;
+  int n = L->A->nrows, i;
+  if (l == H->nlevels-1){
+    memcpy(x, b, n*sizeof(double));
+    v.array = x, v.n = n;
+    luLSS(H->LU, &v);
+    return;
+  }
+  C = &H->levels[l+1];
+  memset(x, 0, n*sizeof(double));
+  gauss_seidel(L->A, L->diag, b, x, 0);
+  csr_mvmult(L->A, x, L->r);
+  for (i=0; i<n; i++)
+    L->r[i] = b[i] - L->r[i];
+  csr_mvmult(L->R, L->r, C->b);
+  vcycle(H, l+1, C->b, C->x);
+  csr_mvmult(L->P, C->x, L->r);
+  for (i=0; i<n; i++)
+    x[i] += L->r[i];
+  gauss_seidel(L->A, L->diag, b, x, 1);
+}
+
+
+void amg_vcycle(void* M, double* r, double* z){
+  // One V-cycle z = inv(M)*r, in the form taken by pcgLSS
+  vcycle(M, 0, r, z);
+}
+
+
+void free_amg_hierarchy(struct amg_hierarchy* H){
+  struct amg_level* L;
+  int l;
+  for (l=0; l<H->nlevels; l++){
+    L = &H->levels[l];
+    if (l > 0)
+      free_csr_matrix(L->A);
+    if (L->P != NULL)
+      free_csr_matrix(L->P), free_csr_matrix(L->R);
+    free(L->diag), free(L->x), free(L->b), free(L->r);
+  }
+  free(H->levels);
+  if (H->LU != NULL)
+    free_matrix(H->LU);
+  free(H);
+}
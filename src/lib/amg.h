@@ -0,0 +1,36 @@
+/*
+ * Smoothed aggregation algebraic multigrid (AMG).
+ * The hierarchy is built from an assembled sparse matrix whose rows are
+ * grouped into nodal blocks, together with the near null space of the
+ * operator (the rigid body modes for elasticity).  Nodes are aggregated
+ * on the strength of their blocks, the near null space is interpolated
+ * exactly by the tentative prolongator, and the prolongator is smoothed
+ * by one damped Jacobi step.  One V-cycle is a symmetric preconditioner.
+ */
+
+struct csr_matrix;
+struct matrix;
+
+
+struct amg_level{
+  struct csr_matrix* A;  // Operator on this level
+  struct csr_matrix* P;  // Prolongation from the next coarser level
+  struct csr_matrix* R;  // Restriction to the next coarser level, P^T
+  double* diag;
+  double* x;             // Work vectors for the V-cycle
+  double* b;
+  double* r;
+};
+
+
+struct amg_hierarchy{
+  int nlevels;
+  struct amg_level* levels;
+  struct matrix* LU;     // Dense factors of the coarsest operator
+};
+
+
+struct amg_hierarchy* new_amg_hierarchy(struct csr_matrix* A, int* node,
+					 int nnodes, double* B, int nmodes);
+void amg_vcycle(void* M, double* r, double* z);
+void free_amg_hierarchy(struct amg_hierarchy* H);
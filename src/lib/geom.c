@@ -1,5 +1,6 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include "log.h"
 #include "geom.h"
 
 struct point* new_point(double x, double y){
@@ -10,5 +11,5 @@ struct point* new_point(double x, double y){
 }
 
 void print_point(struct point* pt){
-  printf("Point = (x=%f, y=%f)\n", pt->x, pt->y);
+  lprintf("Point = (x=%f, y=%f)\n", pt->x, pt->y);
 }
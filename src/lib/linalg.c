@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <assert.h>
 #include <math.h>
+#include "log.h"
 #include "linalg.h"
 
 
@@ -114,6 +115,31 @@ void free_vector(struct vector* u){
 }
 
 
+struct fmatrix* single_matrix(struct matrix* A){
+  // Rounds A to a new single precision matrix
+  struct fmatrix* As = malloc(sizeof(struct fmatrix));
+  int i, j;
+  As->array = malloc(A->nrows*sizeof(float*));
+  for (i=0; i<A->nrows; i++){
+    As->array[i] = malloc(A->ncols*sizeof(float));
+    for (j=0; j<A->ncols; j++)
+      As->array[i][j] = (float) A->array[i][j];
+  }
+  As->nrows = A->nrows;
+  As->ncols = A->ncols;
+  return As;
+}
+
+
+void free_fmatrix(struct fmatrix* A){
+  int i;
+  for (i=0; i<A->nrows; i++)
+    free(A->array[i]);
+  free(A->array);
+  free(A);
+}
+
+
 /****************************************************
  * Output and checking functions
  */
@@ -147,21 +173,47 @@ int vequal(struct vector* u, struct vector* v){
 
 void print_matrix(struct matrix* A){
   int i, j;
-  printf("Matrix\n");
+  lprintf("Matrix\n");
   for (i=0; i<A->nrows; i++){
     for (j=0; j<A->ncols; j++)
-      printf(" %8.3g ", A->array[i][j]);
-    printf("\n");
+      lprintf(" %8.3g ", A->array[i][j]);
+    lprintf("\n");
   }
 }
 
 
 void print_vector(struct vector* u){
   int i;
-  printf("Vector:\n");
+  lprintf("Vector:\n");
   for (i=0; i<u->n; i++)
-    printf(" %8.3g ", u->array[i]);
-  printf("\n");
+    lprintf(" %8.3g ", u->array[i]);
+  lprintf("\n");
+}
+
+
+double mnorm_inf(struct matrix* A){
+  // Maximum absolute row sum
+  int i, j;
+  double sum, norm = 0.0;
+  for (i=0; i<A->nrows; i++){
+    sum = 0.0;
+    for (j=0; j<A->ncols; j++)
+      sum += fabs(A->array[i][j]);
+    if (sum > norm)
+      norm = sum;
+  }
+  return norm;
+}
+
+
+double vnorm_inf(struct vector* u){
+  int i;
+  double norm = 0.0;
+  for (i=0; i<u->n; i++){
+    if (fabs(u->array[i]) > norm)
+      norm = fabs(u->array[i]);
+  }
+  return norm;
 }
 
 
@@ -315,6 +367,57 @@ void cholMFA(struct matrix* A){
 }
 
 
+int luMFA(struct matrix* A){
+  // Overwrites A with its LU factors (Doolittle, no pivoting).
+  // U is stored on and above the diagonal, the unit lower triangular
+  // L below it, so the factors can be reused for many right hand sides.
+  // Returns 1 on a zero pivot, for a singular A, leaving A unusable.
+  assert(A->nrows == A->ncols);
+  int n = A->nrows;
+  int i, j, k;
+  double pivot, c;
+  for (i=0; i<n; i++){
+    pivot = A->array[i][i];
+    if (pivot == 0.0)
+      return 1;
+    for (j=i+1; j<n; j++){
+      c = A->array[j][i] / pivot;
+      if (c == 0.0)
+	continue;
+      A->array[j][i] = c;
+      for (k=i+1; k<n; k++)
+	A->array[j][k] -= c*A->array[i][k];
+    }
+  }
+  return 0;
+}
+
+
+int sluMFA(struct fmatrix* A){
+  // Single precision version of luMFA.  Returns 1 on a zero or
+  // non-finite pivot so the caller can fall back to a
+  // double precision factorization.
+  assert(A->nrows == A->ncols);
+  int n = A->nrows;
+  int i, j, k;
+  float pivot, c;
+  for (i=0; i<n; i++){
+    pivot = A->array[i][i];
+    if (pivot == 0.0f || !isfinite(pivot))
+      return 1;
+    for (j=i+1; j<n; j++){
+      c = A->array[j][i] / pivot;
+      if (c == 0.0f)
+	continue;
+      A->array[j][i] = c;
+      for (k=i+1; k<n; k++)
+	A->array[j][k] -= c*A->array[i][k];
+    }
+  }
+  return 0;
+}
+
+
 /****************************************************
  * Basic linear system solver
  */
@@ -350,6 +453,47 @@ void back_substitution(struct matrix* A, struct vector* b){
 }
 
 
+void luLSS(struct matrix* LU, struct vector* b){
+  // Solves with factors from luMFA, reducing b to the solution x
+  assert(LU->nrows == LU->ncols);
+  assert(LU->ncols == b->n);
+  int n = b->n;
+  int i, j;
+  for (i=1; i<n; i++){
+    for (j=0; j<i; j++)
+      b->array[i] -= LU->array[i][j]*b->array[j];
+  }
+  back_substitution(LU, b);
+}
+
+
+void sluLSS(struct fmatrix* LU, struct vector* b){
+  // Solves with factors from sluMFA in single precision arithmetic.
+  // b is given and returned in double precision.
+  assert(LU->nrows == LU->ncols);
+  assert(LU->ncols == b->n);
+  int n = b->n;
+  int i, j;
+  float sum;
+  float* x = malloc(n*sizeof(float));
+  for (i=0; i<n; i++){
+    sum = (float) b->array[i];
+    for (j=0; j<i; j++)
+      sum -= LU->array[i][j]*x[j];
+    x[i] = sum;
+  }
+  for (i=n-1; i>=0; i--){
+    sum = x[i];
+    for (j=i+1; j<n; j++)
+      sum -= LU->array[i][j]*x[j];
+    x[i] = sum / LU->array[i][i];
+  }
+  for (i=0; i<n; i++)
+    b->array[i] = x[i];
+  free(x);
+}
+
+
 void gaussLSS(struct matrix* A, struct vector* b){
   // In-place reduction of A to U and b to the solution x
   assert(A->nrows == A->ncols);
@@ -11,6 +11,14 @@ struct vector{
 };
 
 
+// Single precision matrix, used for low precision factorizations
+struct fmatrix{
+  float** array;
+  int nrows;
+  int ncols;
+};
+
+
 // Constructors and destructors
 struct matrix* new_matrix(int nrows, int ncols);
 struct matrix* new_triangular_matrix(int n, int is_upper);
@@ -20,12 +28,16 @@ struct matrix* copy_matrix(struct matrix* A);
 struct vector* copy_vector(struct vector* u);
 void free_matrix(struct matrix* A);
 void free_vector(struct vector* u);
+struct fmatrix* single_matrix(struct matrix* A);
+void free_fmatrix(struct fmatrix* A);
 
 // Output and checking
 int mequal(struct matrix* A, struct matrix* B);
 int vequal(struct vector* u, struct vector* v);
 void print_matrix(struct matrix* A);
 void print_vector(struct vector* u);
+double mnorm_inf(struct matrix* A);
+double vnorm_inf(struct vector* u);
 
 // Row and matrix manipulations
 struct matrix* mtranspose(struct matrix* A);
@@ -40,9 +52,16 @@ struct matrix* mmmult(struct matrix* A, struct matrix* B);
 struct vector* mvmult(struct matrix* A, struct vector* x);
 
 
+// Matrix factoring algorithms (MFA)
+void cholMFA(struct matrix* A);
+int luMFA(struct matrix* A);
+int sluMFA(struct fmatrix* A);
+
 // Linear system solvers (LSS)
 void forward_elimination(struct matrix* A, struct vector* b);
 void back_substitution(struct matrix* A, struct vector* b);
 void gaussLSS(struct matrix* A, struct vector* b);
+void luLSS(struct matrix* LU, struct vector* b);
+void sluLSS(struct fmatrix* LU, struct vector* b);
 
 // Eigenvalue solvers
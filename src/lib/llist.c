@@ -0,0 +1,62 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "log.h"
+#include "llist.h"
+
+
+struct llist* new_llist(){
+  struct llist* l = malloc(sizeof(struct llist));
+  l->head = NULL;
+  l->nitems = 0;
+  return l;
+}
+
+
+void insert(struct llist* l, int key, double value){
+  // Inserts in key order.  The value is added to an existing key.
+  struct llist_node** link = &l->head;
+  struct llist_node* node;
+  while (*link != NULL && (*link)->key < key)
+    link = &(*link)->next;
+  if (*link != NULL && (*link)->key == key){
+    (*link)->value += value;
+    return;
+  }
+  node = malloc(sizeof(struct llist_node));
+  node->key = key;
+  node->value = value;
+  node->next = *link;
+  *link = node;
+  l->nitems++;
+}
+
+
+double lookup(struct llist* l, int key){
+  // Value of key, 0 if absent
+  struct llist_node* node;
+  for (node=l->head; node != NULL && node->key <= key; node=node->next){
+    if (node->key == key)
+      return node->value;
+  }
+  return 0.0;
+}
+
+
+void print_llist(struct llist* l){
+  struct llist_node* node;
+  lprintf("[");
+  for (node=l->head; node != NULL; node=node->next)
+    lprintf("%s(%d: %g)", node == l->head ? "" : ", ", node->key, node->value);
+  lprintf("]\n");
+}
+
+
+void free_llist(struct llist* l){
+  struct llist_node *node = l->head, *next;
+  while (node != NULL){
+    next = node->next;
+    free(node);
+    node = next;
+  }
+  free(l);
+}
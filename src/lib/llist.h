@@ -0,0 +1,21 @@
+/*
+ * Singly linked list of (key, value) pairs kept sorted by key.
+ * Used as the row storage of sparse matrices.
+ */
+
+struct llist_node{
+  int key;
+  double value;
+  struct llist_node* next;
+};
+
+struct llist{
+  struct llist_node* head;
+  int nitems;
+};
+
+struct llist* new_llist();
+void insert(struct llist* l, int key, double value);
+double lookup(struct llist* l, int key);
+void print_llist(struct llist* l);
+void free_llist(struct llist* l);
@@ -0,0 +1,27 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include "log.h"
+
+
+static _Thread_local FILE* stream = NULL;
+
+
+FILE* log_stream(){
+  return stream != NULL ? stream : stdout;
+}
+
+
+void set_log_stream(FILE* file){
+  // NULL restores stdout
+  stream = file;
+}
+
+
+int lprintf(const char* format, ...){
+  va_list args;
+  int len;
+  va_start(args, format);
+  len = vfprintf(log_stream(), format, args);
+  va_end(args);
+  return len;
+}
@@ -0,0 +1,11 @@
+/*
+ * Per thread output stream.  Program output goes through lprintf, so
+ * models run on parallel threads (batch mode) each write their own log.
+ * A thread without a stream of its own writes to stdout.
+ */
+
+#include <stdio.h>
+
+FILE* log_stream();
+void set_log_stream(FILE* file);
+int lprintf(const char* format, ...);
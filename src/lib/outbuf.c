@@ -0,0 +1,76 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include "outbuf.h"
+
+
+#define OUTBUF_LINE 256  // Room kept for one formatted item
+
+
+struct outbuf* new_outbuf(FILE* file){
+  struct outbuf* ob = malloc(sizeof(struct outbuf));
+  ob->file = file;
+  ob->data = malloc(OUTBUF_SIZE);
+  ob->n = 0;
+  ob->written = 0;
+  ob->error = 0;
+  return ob;
+}
+
+
+static void put(struct outbuf* ob, const void* bytes, size_t size){
+  size_t n = size > 0 ? fwrite(bytes, 1, size, ob->file) : 0;
+  ob->written += n;
+  if (n < size)
+    ob->error = 1;
+}
+
+
+void outbuf_flush(struct outbuf* ob){
+  put(ob, ob->data, ob->n);
+  ob->n = 0;
+}
+
+
+void outbuf_write(struct outbuf* ob, const void* bytes, size_t size){
+  // Large writes bypass the buffer once it has been emptied
+  if (ob->n + size > OUTBUF_SIZE)
+    outbuf_flush(ob);
+  if (size > OUTBUF_SIZE){
+    put(ob, bytes, size);
+    return;
+  }
+  memcpy(ob->data + ob->n, bytes, size);
+  ob->n += size;
+}
+
+
+void outbuf_printf(struct outbuf* ob, const char* format, ...){
+  va_list args;
+  int len;
+  if (ob->n + OUTBUF_LINE > OUTBUF_SIZE)
+    outbuf_flush(ob);
+  va_start(args, format);
+  len = vsnprintf(ob->data + ob->n, OUTBUF_SIZE - ob->n, format, args);
+  va_end(args);
+  if (len >= (int) (OUTBUF_SIZE - ob->n)){
+    // Longer than the space left, format again into an empty buffer
+    outbuf_flush(ob);
+    va_start(args, format);
+    len = vsnprintf(ob->data, OUTBUF_SIZE, format, args);
+    va_end(args);
+  }
+  if (len > 0)
+    ob->n += len < OUTBUF_SIZE ? len : OUTBUF_SIZE - 1;
+}
+
+
+void free_outbuf(struct outbuf* ob){
+  // Flushes the remaining output.  The file is not closed, so a failed
+  // flush shows in ferror() of the file.
+  outbuf_flush(ob);
+  fflush(ob->file);
+  free(ob->data);
+  free(ob);
+}
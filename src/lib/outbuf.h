@@ -0,0 +1,22 @@
+/*
+ * Buffered output stream.  Writes are collected in one large buffer and
+ * handed to the file in chunks, instead of one stdio call per value.
+ */
+
+#include <stdio.h>
+
+#define OUTBUF_SIZE (1 << 20)
+
+struct outbuf{
+  FILE* file;
+  char* data;
+  size_t n;        // Bytes waiting in data
+  size_t written;  // Bytes handed to the file so far
+  int error;       // Set once the file took fewer bytes than handed
+};
+
+struct outbuf* new_outbuf(FILE* file);
+void outbuf_write(struct outbuf* ob, const void* bytes, size_t size);
+void outbuf_printf(struct outbuf* ob, const char* format, ...);
+void outbuf_flush(struct outbuf* ob);
+void free_outbuf(struct outbuf* ob);
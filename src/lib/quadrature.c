@@ -0,0 +1,290 @@
+/*
+Quadrature rules on the parent elements, full double precision.  Rules
+are static tables referenced in place and never allocated or freed.
+
+Quadrilaterals use tensor product Gauss-Legendre rules on [-1, 1]^2
+with n points per direction, exact to degree 2n-1 in each coordinate.
+Points are listed with x varying fastest.
+
+Triangles use symmetric rules in area coordinates (r, s) on the unit
+right triangle (0, 0), (1, 0), (0, 1), exact for polynomials of total
+degree equal to the order.  Weights include the parent area of 1/2.
+*/
+
+#include <stdlib.h>
+#include "quadrature.h"
+
+
+static const double gauss1_pts[1][2] = {
+  {0.0, 0.0}
+};
+static const double gauss1_wts[1] = {
+  4.0
+};
+
+static const double gauss2_pts[4][2] = {
+  {-0.57735026918962573, -0.57735026918962573},
+  {0.57735026918962573, -0.57735026918962573},
+  {-0.57735026918962573, 0.57735026918962573},
+  {0.57735026918962573, 0.57735026918962573}
+};
+static const double gauss2_wts[4] = {
+  1.0, 1.0,
+  1.0, 1.0
+};
+
+static const double gauss3_pts[9][2] = {
+  {-0.7745966692414834, -0.7745966692414834},
+  {0.0, -0.7745966692414834},
+  {0.7745966692414834, -0.7745966692414834},
+  {-0.7745966692414834, 0.0},
+  {0.0, 0.0},
+  {0.7745966692414834, 0.0},
+  {-0.7745966692414834, 0.7745966692414834},
+  {0.0, 0.7745966692414834},
+  {0.7745966692414834, 0.7745966692414834}
+};
+static const double gauss3_wts[9] = {
+  0.30864197530864201, 0.49382716049382713, 0.30864197530864201,
+  0.49382716049382713, 0.79012345679012341, 0.49382716049382713,
+  0.30864197530864201, 0.49382716049382713, 0.30864197530864201
+};
+
+static const double gauss4_pts[16][2] = {
+  {-0.86113631159405257, -0.86113631159405257},
+  {-0.33998104358485626, -0.86113631159405257},
+  {0.33998104358485626, -0.86113631159405257},
+  {0.86113631159405257, -0.86113631159405257},
+  {-0.86113631159405257, -0.33998104358485626},
+  {-0.33998104358485626, -0.33998104358485626},
+  {0.33998104358485626, -0.33998104358485626},
+  {0.86113631159405257, -0.33998104358485626},
+  {-0.86113631159405257, 0.33998104358485626},
+  {-0.33998104358485626, 0.33998104358485626},
+  {0.33998104358485626, 0.33998104358485626},
+  {0.86113631159405257, 0.33998104358485626},
+  {-0.86113631159405257, 0.86113631159405257},
+  {-0.33998104358485626, 0.86113631159405257},
+  {0.33998104358485626, 0.86113631159405257},
+  {0.86113631159405257, 0.86113631159405257}
+};
+static const double gauss4_wts[16] = {
+  0.121002993285602, 0.22685185185185183, 0.22685185185185183, 0.121002993285602,
+  0.22685185185185183, 0.42529330301069423, 0.42529330301069423, 0.22685185185185183,
+  0.22685185185185183, 0.42529330301069423, 0.42529330301069423, 0.22685185185185183,
+  0.121002993285602, 0.22685185185185183, 0.22685185185185183, 0.121002993285602
+};
+
+static const double gauss5_pts[25][2] = {
+  {-0.90617984593866396, -0.90617984593866396},
+  {-0.53846931010568311, -0.90617984593866396},
+  {0.0, -0.90617984593866396},
+  {0.53846931010568311, -0.90617984593866396},
+  {0.90617984593866396, -0.90617984593866396},
+  {-0.90617984593866396, -0.53846931010568311},
+  {-0.53846931010568311, -0.53846931010568311},
+  {0.0, -0.53846931010568311},
+  {0.53846931010568311, -0.53846931010568311},
+  {0.90617984593866396, -0.53846931010568311},
+  {-0.90617984593866396, 0.0},
+  {-0.53846931010568311, 0.0},
+  {0.0, 0.0},
+  {0.53846931010568311, 0.0},
+  {0.90617984593866396, 0.0},
+  {-0.90617984593866396, 0.53846931010568311},
+  {-0.53846931010568311, 0.53846931010568311},
+  {0.0, 0.53846931010568311},
+  {0.53846931010568311, 0.53846931010568311},
+  {0.90617984593866396, 0.53846931010568311},
+  {-0.90617984593866396, 0.90617984593866396},
+  {-0.53846931010568311, 0.90617984593866396},
+  {0.0, 0.90617984593866396},
+  {0.53846931010568311, 0.90617984593866396},
+  {0.90617984593866396, 0.90617984593866396}
+};
+static const double gauss5_wts[25] = {
+  0.056134348862428636, 0.1134, 0.13478507238752091, 0.1134, 0.056134348862428636,
+  0.1134, 0.22908540422399112, 0.27228653255075069, 0.22908540422399112, 0.1134,
+  0.13478507238752091, 0.27228653255075069, 0.32363456790123457, 0.27228653255075069, 0.13478507238752091,
+  0.1134, 0.22908540422399112, 0.27228653255075069, 0.22908540422399112, 0.1134,
+  0.056134348862428636, 0.1134, 0.13478507238752091, 0.1134, 0.056134348862428636
+};
+
+static const double gauss6_pts[36][2] = {
+  {-0.93246951420315205, -0.93246951420315205},
+  {-0.66120938646626448, -0.93246951420315205},
+  {-0.2386191860831969, -0.93246951420315205},
+  {0.2386191860831969, -0.93246951420315205},
+  {0.66120938646626448, -0.93246951420315205},
+  {0.93246951420315205, -0.93246951420315205},
+  {-0.93246951420315205, -0.66120938646626448},
+  {-0.66120938646626448, -0.66120938646626448},
+  {-0.2386191860831969, -0.66120938646626448},
+  {0.2386191860831969, -0.66120938646626448},
+  {0.66120938646626448, -0.66120938646626448},
+  {0.93246951420315205, -0.66120938646626448},
+  {-0.93246951420315205, -0.2386191860831969},
+  {-0.66120938646626448, -0.2386191860831969},
+  {-0.2386191860831969, -0.2386191860831969},
+  {0.2386191860831969, -0.2386191860831969},
+  {0.66120938646626448, -0.2386191860831969},
+  {0.93246951420315205, -0.2386191860831969},
+  {-0.93246951420315205, 0.2386191860831969},
+  {-0.66120938646626448, 0.2386191860831969},
+  {-0.2386191860831969, 0.2386191860831969},
+  {0.2386191860831969, 0.2386191860831969},
+  {0.66120938646626448, 0.2386191860831969},
+  {0.93246951420315205, 0.2386191860831969},
+  {-0.93246951420315205, 0.66120938646626448},
+  {-0.66120938646626448, 0.66120938646626448},
+  {-0.2386191860831969, 0.66120938646626448},
+  {0.2386191860831969, 0.66120938646626448},
+  {0.66120938646626448, 0.66120938646626448},
+  {0.93246951420315205, 0.66120938646626448},
+  {-0.93246951420315205, 0.93246951420315205},
+  {-0.66120938646626448, 0.93246951420315205},
+  {-0.2386191860831969, 0.93246951420315205},
+  {0.2386191860831969, 0.93246951420315205},
+  {0.66120938646626448, 0.93246951420315205},
+  {0.93246951420315205, 0.93246951420315205}
+};
+static const double gauss6_wts[36] = {
+  0.029352081688980403, 0.061807293372383332, 0.080165117317806622, 0.080165117317806622, 0.061807293372383332, 0.029352081688980403,
+  0.061807293372383332, 0.13014891258816744, 0.16880536708758784, 0.16880536708758784, 0.13014891258816744, 0.061807293372383332,
+  0.080165117317806622, 0.16880536708758784, 0.21894345016729658, 0.21894345016729658, 0.16880536708758784, 0.080165117317806622,
+  0.080165117317806622, 0.16880536708758784, 0.21894345016729658, 0.21894345016729658, 0.16880536708758784, 0.080165117317806622,
+  0.061807293372383332, 0.13014891258816744, 0.16880536708758784, 0.16880536708758784, 0.13014891258816744, 0.061807293372383332,
+  0.029352081688980403, 0.061807293372383332, 0.080165117317806622, 0.080165117317806622, 0.061807293372383332, 0.029352081688980403
+};
+
+static const double triangle1_pts[1][2] = {
+  {0.33333333333333331, 0.33333333333333331}
+};
+static const double triangle1_wts[1] = {
+  0.5
+};
+
+static const double triangle2_pts[3][2] = {
+  {0.16666666666666666, 0.16666666666666666},
+  {0.66666666666666663, 0.16666666666666666},
+  {0.16666666666666666, 0.66666666666666663}
+};
+static const double triangle2_wts[3] = {
+  0.16666666666666666,
+  0.16666666666666666,
+  0.16666666666666666
+};
+
+static const double triangle3_pts[4][2] = {
+  {0.33333333333333331, 0.33333333333333331},
+  {0.20000000000000001, 0.20000000000000001},
+  {0.59999999999999998, 0.20000000000000001},
+  {0.20000000000000001, 0.59999999999999998}
+};
+static const double triangle3_wts[4] = {
+  -0.28125,
+  0.26041666666666669,
+  0.26041666666666669,
+  0.26041666666666669
+};
+
+static const double triangle4_pts[6][2] = {
+  {0.44594849091596489, 0.44594849091596489},
+  {0.10810301816807023, 0.44594849091596489},
+  {0.44594849091596489, 0.10810301816807023},
+  {0.091576213509770743, 0.091576213509770743},
+  {0.81684757298045851, 0.091576213509770743},
+  {0.091576213509770743, 0.81684757298045851}
+};
+static const double triangle4_wts[6] = {
+  0.11169079483900574,
+  0.11169079483900574,
+  0.11169079483900574,
+  0.054975871827660935,
+  0.054975871827660935,
+  0.054975871827660935
+};
+
+static const double triangle5_pts[7][2] = {
+  {0.33333333333333331, 0.33333333333333331},
+  {0.47014206410511511, 0.47014206410511511},
+  {0.059715871789769823, 0.47014206410511511},
+  {0.47014206410511511, 0.059715871789769823},
+  {0.10128650732345634, 0.10128650732345634},
+  {0.79742698535308731, 0.10128650732345634},
+  {0.10128650732345634, 0.79742698535308731}
+};
+static const double triangle5_wts[7] = {
+  0.1125,
+  0.066197076394253096,
+  0.066197076394253096,
+  0.066197076394253096,
+  0.06296959027241357,
+  0.06296959027241357,
+  0.06296959027241357
+};
+
+static const double triangle6_pts[12][2] = {
+  {0.24928674517091043, 0.24928674517091043},
+  {0.50142650965817914, 0.24928674517091043},
+  {0.24928674517091043, 0.50142650965817914},
+  {0.063089014491502227, 0.063089014491502227},
+  {0.87382197101699555, 0.063089014491502227},
+  {0.063089014491502227, 0.87382197101699555},
+  {0.053145049844816945, 0.31035245103378439},
+  {0.31035245103378439, 0.053145049844816945},
+  {0.31035245103378439, 0.63650249912139867},
+  {0.63650249912139867, 0.31035245103378439},
+  {0.63650249912139867, 0.053145049844816945},
+  {0.053145049844816945, 0.63650249912139867}
+};
+static const double triangle6_wts[12] = {
+  0.058393137863189684,
+  0.058393137863189684,
+  0.058393137863189684,
+  0.025422453185103409,
+  0.025422453185103409,
+  0.025422453185103409,
+  0.041425537809186785,
+  0.041425537809186785,
+  0.041425537809186785,
+  0.041425537809186785,
+  0.041425537809186785,
+  0.041425537809186785
+};
+
+
+static const struct quad_rule gauss_rules[QUAD_MAXORDER] = {
+  {1, 1, gauss1_pts, gauss1_wts},
+  {2, 4, gauss2_pts, gauss2_wts},
+  {3, 9, gauss3_pts, gauss3_wts},
+  {4, 16, gauss4_pts, gauss4_wts},
+  {5, 25, gauss5_pts, gauss5_wts},
+  {6, 36, gauss6_pts, gauss6_wts}
+};
+
+
+static const struct quad_rule triangle_rules[QUAD_MAXORDER] = {
+  {1, 1, triangle1_pts, triangle1_wts},
+  {2, 3, triangle2_pts, triangle2_wts},
+  {3, 4, triangle3_pts, triangle3_wts},
+  {4, 6, triangle4_pts, triangle4_wts},
+  {5, 7, triangle5_pts, triangle5_wts},
+  {6, 12, triangle6_pts, triangle6_wts}
+};
+
+
+const struct quad_rule* gauss_rule(int order){
+  // n x n point rule, or NULL outside orders 1 to QUAD_MAXORDER
+  if (order < 1 || order > QUAD_MAXORDER)
+    return NULL;
+  return &gauss_rules[order-1];
+}
+
+
+const struct quad_rule* triangle_rule(int order){
+  // Rule exact to total degree order, or NULL outside 1 to QUAD_MAXORDER
+  if (order < 1 || order > QUAD_MAXORDER)
+    return NULL;
+  return &triangle_rules[order-1];
+}
@@ -0,0 +1,19 @@
+/*
+Static quadrature rule tables for quadrilateral and triangular parent
+elements, orders 1 to QUAD_MAXORDER.
+*/
+
+#define QUAD_MAXORDER 6
+#define QUAD_MAXPTS 36   // Points in the largest rule (6 x 6)
+
+
+struct quad_rule{
+  int order;
+  int npts;
+  const double (*pts)[2];  // Parent coordinates of each point
+  const double* wts;
+};
+
+
+const struct quad_rule* gauss_rule(int order);
+const struct quad_rule* triangle_rule(int order);
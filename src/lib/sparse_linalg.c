@@ -0,0 +1,363 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include "log.h"
+#include "llist.h"
+#include "linalg.h"
+#include "sparse_linalg.h"
+
+
+/*****************************************************************
+ * Constructors and destructors
+ */
+
+
+struct aol_matrix* new_aol_matrix(int nrows, int ncols){
+  struct aol_matrix* A = malloc(sizeof(struct aol_matrix));
+  int i;
+  A->nrows = nrows;
+  A->ncols = ncols;
+  A->rows = malloc(nrows*sizeof(struct llist*));
+  for (i=0; i<nrows; i++)
+    A->rows[i] = new_llist();
+  return A;
+}
+
+
+void add_aol_element(struct aol_matrix* A, int i, int j, double value){
+  // Adds value to A[i][j], creating the entry if needed
+  assert(i >= 0 && i < A->nrows && j >= 0 && j < A->ncols);
+  insert(A->rows[i], j, value);
+}
+
+
+void print_aol_matrix(struct aol_matrix* A, char format){
+  // format 's' lists the stored entries, 'f' prints the full matrix
+  struct llist_node* node;
+  int i, j;
+  lprintf("Sparse matrix (%d x %d)\n", A->nrows, A->ncols);
+  for (i=0; i<A->nrows; i++){
+    node = A->rows[i]->head;
+    if (format == 's'){
+      for (; node != NULL; node=node->next)
+	lprintf(" (%d, %d): %g\n", i, node->key, node->value);
+      continue;
+    }
+    for (j=0; j<A->ncols; j++){
+      if (node != NULL && node->key == j){
+	lprintf(" %8.3g ", node->value);
+	node = node->next;
+      }
+      else
+	lprintf(" %8.3g ", 0.0);
+    }
+    lprintf("\n");
+  }
+}
+
+
+void free_aol_matrix(struct aol_matrix* A){
+  int i;
+  for (i=0; i<A->nrows; i++)
+    free_llist(A->rows[i]);
+  free(A->rows);
+  free(A);
+}
+
+
+struct csr_matrix* new_csr_matrix(int nrows, int ncols, int nnz){
+  struct csr_matrix* A = malloc(sizeof(struct csr_matrix));
+  A->nrows = nrows;
+  A->ncols = ncols;
+  A->nnz = nnz;
+  A->rowptr = calloc(nrows+1, sizeof(int));
+  A->cols = malloc((nnz > 0 ? nnz : 1)*sizeof(int));
+  A->vals = malloc((nnz > 0 ? nnz : 1)*sizeof(double));
+  return A;
+}
+
+
+struct csr_matrix* aol_to_csr(struct aol_matrix* A){
+  struct csr_matrix* C;
+  struct llist_node* node;
+  int i, k, nnz = 0;
+  for (i=0; i<A->nrows; i++)
+    nnz += A->rows[i]->nitems;
+  C = new_csr_matrix(A->nrows, A->ncols, nnz);
+  for (k=0, i=0; i<A->nrows; i++){
+    for (node=A->rows[i]->head; node != NULL; node=node->next, k++){
+      C->cols[k] = node->key;
+      C->vals[k] = node->value;
+    }
+    C->rowptr[i+1] = k;
+  }
+  return C;
+}
+
+
+void free_csr_matrix(struct csr_matrix* A){
+  free(A->rowptr);
+  free(A->cols);
+  free(A->vals);
+  free(A);
+}
+
+
+/*****************************************************************
+ * Operations
+ */
+
+
+void csr_mvmult(struct csr_matrix* A, double* x, double* y){
+  // y = A*x
+  int i, k;
+  double sum;
+  for (i=0; i<A->nrows; i++){
+    sum = 0.0;
+    for (k=A->rowptr[i]; k<A->rowptr[i+1]; k++)
+      sum += A->vals[k]*x[A->cols[k]];
+    y[i] = sum;
+  }
+}
+
+
+struct csr_matrix* csr_transpose(struct csr_matrix* A){
+  // Counting sort of the entries by column keeps the rows of the
+  // transpose sorted
+  struct csr_matrix* T = new_csr_matrix(A->ncols, A->nrows, A->nnz);
+  int* next = malloc((A->ncols+1)*sizeof(int));
+  int i, k, p;
+  for (k=0; k<A->nnz; k++)
+    T->rowptr[A->cols[k]+1]++;
+  for (i=0; i<A->ncols; i++)
+    T->rowptr[i+1] += T->rowptr[i];
+  memcpy(next, T->rowptr, (A->ncols+1)*sizeof(int));
+  for (i=0; i<A->nrows; i++){
+    for (k=A->rowptr[i]; k<A->rowptr[i+1]; k++){
+      p = next[A->cols[k]]++;
+      T->cols[p] = i;
+      T->vals[p] = A->vals[k];
+    }
+  }
+  free(next);
+  return T;
+}
+
+
+struct skyline_matrix* new_skyline_matrix(int n, int* first){
+  // Symbolic phase.  first[j] is the lowest row coupled to column j.
+  struct skyline_matrix* S = malloc(sizeof(struct skyline_matrix));
+  int j;
+  S->n = n;
+  S->first = malloc(n*sizeof(int));
+  S->diag = malloc(n*sizeof(long));
+  memcpy(S->first, first, n*sizeof(int));
+  S->size = 0;
+  for (j=0; j<n; j++){
+    assert(first[j] >= 0 && first[j] <= j);
+    S->size += j - first[j] + 1;
+    S->diag[j] = S->size - 1;
+  }
+  S->vals = calloc(S->size > 0 ? S->size : 1, sizeof(double));
+  return S;
+}
+
+
+void skyline_scatter(struct skyline_matrix* S, struct csr_matrix* A,
+		     double* vals){
+  // Adds the upper triangle of the symmetric A into vals, laid out as
+  // the profile of S
+  int i, j, k;
+  for (i=0; i<A->nrows; i++){
+    for (k=A->rowptr[i]; k<A->rowptr[i+1]; k++){
+      j = A->cols[k];
+      if (j < i)
+	continue;
+      assert(i >= S->first[j]);
+      vals[S->diag[j] - (j-i)] += A->vals[k];
+    }
+  }
+}
+
+
+void free_skyline_matrix(struct skyline_matrix* S){
+  free(S->first), free(S->diag), free(S->vals);
+  free(S);
+}
+
+
+static int compare_ints(const void* a, const void* b){
+  return *(const int*) a - *(const int*) b;
+}
+
+
+struct csr_matrix* csr_mmmult(struct csr_matrix* A, struct csr_matrix* B){
+  // C = A*B by rows (Gustavson), with a dense accumulator over the
+  // columns of B
+  assert(A->ncols == B->nrows);
+  int n = B->ncols, i, j, k, l, nnz = 0, len;
+  int* mark = malloc(n*sizeof(int));
+  int* row = malloc(n*sizeof(int));
+  double* acc = calloc(n, sizeof(double));
+  struct csr_matrix* C;
+  for (j=0; j<n; j++)
+    mark[j] = -1;
+  // Symbolic pass counts the entries of each row
+  int* rowptr = calloc(A->nrows+1, sizeof(int));
+  for (i=0; i<A->nrows; i++){
+    for (k=A->rowptr[i]; k<A->rowptr[i+1]; k++){
+      for (l=B->rowptr[A->cols[k]]; l<B->rowptr[A->cols[k]+1]; l++){
+	if (mark[B->cols[l]] != i){
+	  mark[B->cols[l]] = i;
+	  nnz++;
+	}
+      }
+    }
+    rowptr[i+1] = nnz;
+  }
+  C = new_csr_matrix(A->nrows, n, nnz);
+  memcpy(C->rowptr, rowptr, (A->nrows+1)*sizeof(int));
+  free(rowptr);
+  for (j=0; j<n; j++)
+    mark[j] = -1;
+  // Numeric pass
+  for (i=0; i<A->nrows; i++){
+    len = 0;
+    for (k=A->rowptr[i]; k<A->rowptr[i+1]; k++){
+      for (l=B->rowptr[A->cols[k]]; l<B->rowptr[A->cols[k]+1]; l++){
+	j = B->cols[l];
+	if (mark[j] != i){
+	  mark[j] = i;
+	  row[len++] = j;
+	}
+	acc[j] += A->vals[k]*B->vals[l];
+      }
+    }
+    qsort(row, len, sizeof(int), compare_ints);
+    for (k=0; k<len; k++){
+      C->cols[C->rowptr[i]+k] = row[k];
+      C->vals[C->rowptr[i]+k] = acc[row[k]];
+      acc[row[k]] = 0.0;
+    }
+  }
+  free(mark), free(row), free(acc);
+  return C;
+}
+
+
+/*****************************************************************
+ * Linear system solvers (LSS)
+ */
+
+
+static double dot(double* x, double* y, int n){
+  double sum = 0.0;
+  int i;
+  for (i=0; i<n; i++)
+    sum += x[i]*y[i];
+  return sum;
+}
+
+
+int pcgLSS(struct csr_matrix* A, struct vector* b, struct vector* x,
+	   preconditioner apply, void* M, double tol, int maxit){
+  // Preconditioned conjugate gradients for symmetric positive definite
+  // A, starting from x.  Stops when ||b - A*x|| <= tol*||b||.  Returns
+  // the number of iterations, or -1 without convergence.  apply may be
+  // NULL for no preconditioning.
+  int n = b->n, i, k;
+  double *r = malloc(n*sizeof(double)), *z = malloc(n*sizeof(double));
+  double *p = malloc(n*sizeof(double)), *q = malloc(n*sizeof(double));
+  double alpha, beta, rz, rz_old, bnorm = sqrt(dot(b->array, b->array, n));
+  csr_mvmult(A, x->array, q);
+  for (i=0; i<n; i++)
+    r[i] = b->array[i] - q[i];
+  for (k=0; k<=maxit; k++){
+    if (sqrt(dot(r, r, n)) <= tol*bnorm)
+      break;
+    if (k == maxit){
+      k = -1;
+      break;
+    }
+    if (apply != NULL)
+      apply(M, r, z);
+    else
+      memcpy(z, r, n*sizeof(double));
+    rz = dot(r, z, n);
+    if (k == 0)
+      memcpy(p, z, n*sizeof(double));
+    else{
+      beta = rz/rz_old;
+      for (i=0; i<n; i++)
+	p[i] = z[i] + beta*p[i];
+    }
+    csr_mvmult(A, p, q);
+    alpha = rz/dot(p, q, n);
+    for (i=0; i<n; i++){
+      x->array[i] += alpha*p[i];
+      r[i] -= alpha*q[i];
+    }
+    rz_old = rz;
+  }
+  free(r), free(z), free(p), free(q);
+  return k;
+}
+
+
+/*****************************************************************
+ * Skyline factorization and solution
+ */
+
+
+int ldltMFA(struct skyline_matrix* S){
+  // Numeric phase.  Overwrites the profile with A = U^T*D*U, the unit
+  // upper triangular U above the diagonal and D on it (active column
+  // form).  Returns 1 on a zero pivot.
+  int i, j, k, m;
+  double *ci, *cj, g, d;
+  for (j=0; j<S->n; j++){
+    cj = S->vals + S->diag[j] - j;    // cj[i] is entry (i, j)
+    for (i=S->first[j]+1; i<j; i++){
+      ci = S->vals + S->diag[i] - i;
+      m = S->first[i] > S->first[j] ? S->first[i] : S->first[j];
+      g = 0.0;
+      for (k=m; k<i; k++)
+	g += ci[k]*cj[k];
+      cj[i] -= g;
+    }
+    d = cj[j];
+    for (i=S->first[j]; i<j; i++){
+      g = cj[i];
+      cj[i] = g/S->vals[S->diag[i]];
+      d -= g*cj[i];
+    }
+    if (d == 0.0 || !isfinite(d))
+      return 1;
+    cj[j] = d;
+  }
+  return 0;
+}
+
+
+void ldltLSS(struct skyline_matrix* S, struct vector* b){
+  // Solves with the factors from ldltMFA, reducing b to the solution x
+  int j, k;
+  double *cj, *x = b->array, sum;
+  assert(b->n == S->n);
+  for (j=0; j<S->n; j++){
+    cj = S->vals + S->diag[j] - j;
+    sum = 0.0;
+    for (k=S->first[j]; k<j; k++)
+      sum += cj[k]*x[k];
+    x[j] -= sum;
+  }
+  for (j=0; j<S->n; j++)
+    x[j] /= S->vals[S->diag[j]];
+  for (j=S->n-1; j>=0; j--){
+    cj = S->vals + S->diag[j] - j;
+    for (k=S->first[j]; k<j; k++)
+      x[k] -= cj[k]*x[j];
+  }
+}
@@ -0,0 +1,72 @@
+/*
+ * Sparse matrices and solvers.
+ * Matrices are assembled as an array of sorted linked lists (AOL), then
+ * compressed to compressed sparse row (CSR) storage for computation.
+ * Symmetric matrices may also be stored in skyline (profile) form for
+ * direct factorization.
+ */
+
+struct vector;
+
+
+// Array of linked lists, one per row, for assembly
+struct aol_matrix{
+  struct llist** rows;
+  int nrows;
+  int ncols;
+};
+
+
+// Compressed sparse row storage, column indices sorted within each row
+struct csr_matrix{
+  int* rowptr;     // Row i is entries rowptr[i] to rowptr[i+1]-1
+  int* cols;
+  double* vals;
+  int nrows;
+  int ncols;
+  int nnz;
+};
+
+
+// Symmetric matrix in skyline storage.  Column j holds rows first[j]
+// to j of the upper triangle, stored contiguously and ending at the
+// diagonal.  The profile holds all the fill of an LDL^T factorization,
+// so it is fixed by the symbolic phase and reused by every numeric one.
+struct skyline_matrix{
+  int n;
+  int* first;      // First row in the profile of each column
+  long* diag;      // Position of each diagonal in vals
+  double* vals;
+  long size;       // Entries in the profile
+};
+
+
+// Preconditioner z = inv(M)*r
+typedef void (*preconditioner)(void* M, double* r, double* z);
+
+
+// Constructors and destructors
+struct aol_matrix* new_aol_matrix(int nrows, int ncols);
+void add_aol_element(struct aol_matrix* A, int i, int j, double value);
+void print_aol_matrix(struct aol_matrix* A, char format);
+void free_aol_matrix(struct aol_matrix* A);
+struct csr_matrix* new_csr_matrix(int nrows, int ncols, int nnz);
+struct csr_matrix* aol_to_csr(struct aol_matrix* A);
+void free_csr_matrix(struct csr_matrix* A);
+struct skyline_matrix* new_skyline_matrix(int n, int* first);
+void skyline_scatter(struct skyline_matrix* S, struct csr_matrix* A,
+		     double* vals);
+void free_skyline_matrix(struct skyline_matrix* S);
+
+// Operations
+void csr_mvmult(struct csr_matrix* A, double* x, double* y);
+struct csr_matrix* csr_transpose(struct csr_matrix* A);
+struct csr_matrix* csr_mmmult(struct csr_matrix* A, struct csr_matrix* B);
+
+// Matrix factoring algorithms (MFA)
+int ldltMFA(struct skyline_matrix* S);
+
+// Linear system solvers (LSS)
+void ldltLSS(struct skyline_matrix* S, struct vector* b);
+int pcgLSS(struct csr_matrix* A, struct vector* b, struct vector* x,
+	   preconditioner apply, void* M, double tol, int maxit);
@@ -4,18 +4,33 @@
  * 2. Model created and run using script in a text file
  * 3. Main opens file and runs the interpreter
  * 4. When script is finished, file is closed, and program exits
+ *
+ * With -b, the scripts listed in a manifest are run in parallel instead,
+ * each on its own model (see batch.h):
+ *   myfea -b manifest [nworkers]
+ * With -s, myfea serves resident models on a Unix socket (see server.h):
+ *   myfea -s socket_path
 */
 
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include "lib/log.h"
 #include "model.h"
 #include "interpreter.h"
+#include "batch.h"
+#include "server.h"
 
 
 int main(int argc, char* argv[]){
+  if (argc >= 3 && argc <= 4 && strcmp(argv[1], "-b") == 0)
+    return run_batch(argv[2], argc == 4 ? atoi(argv[3]) : 0) != 0;
+  if (argc == 3 && strcmp(argv[1], "-s") == 0)
+    return run_server(argv[2]);
   if (argc != 2){
-    printf("Input one script file\n");
+    lprintf("Input one script file, -b and a manifest of scripts, "
+	    "or -s and a socket path\n");
     exit(1);
   }
   struct model* running_model = new_model();
@@ -6,6 +6,8 @@ Agnostic about element or analysis types
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include "lib/log.h"
 #include "lib/list.h"
 #include "mesh.h"
 
@@ -27,31 +29,31 @@ struct element* new_element(int et_id, int* IEN){
 
 
 void print_node(struct node* n){
-  printf("Node:\n");
-  printf("\tX Coor.: %.4g\n", n->x);
-  printf("\tY Coor.: %.4g\n", n->y);
+  lprintf("Node:\n");
+  lprintf("\tX Coor.: %.4g\n", n->x);
+  lprintf("\tY Coor.: %.4g\n", n->y);
 }
 
 
 void print_element(struct element* e, int nenodes){
   int i;
-  printf("Element , Type #%d\n", e->et_id);
+  lprintf("Element , Type #%d\n", e->et_id);
   for (i=0; i<nenodes; i++){
-    printf("Local Node #%d: Global Node #%d\n", i+1, e->IEN[i]+1);
+    lprintf("Local Node #%d: Global Node #%d\n", i+1, e->IEN[i]+1);
   }
 }
 
 
 void print_mesh(struct list* nodes, struct list* elements, int* nenodes){
-  printf("Mesh: %d nodes, %d elements\n",
+  lprintf("Mesh: %d nodes, %d elements\n",
 	 nodes->nitems, elements->nitems);
   int i;
-  printf("Nodes:\n");
+  lprintf("Nodes:\n");
   for (i=0; i<nodes->nitems; i++){
     struct node* n = nodes->array[i];
     print_node(n);
   }
-  printf("Elements:\n");
+  lprintf("Elements:\n");
   for (i=0; i<elements->nitems; i++){
     struct element* e = elements->array[i];
     print_element(e, nenodes[e->et_id]);
@@ -72,6 +74,97 @@ void free_element(void* e){
 }
 
 
+/***********************************************
+ * Edge midside node map (open addressing)
+ */
+
+
+#define EDGE_MAP_SIZE 64
+
+
+static int edge_slot(struct edge_map* map, int a, int b){
+  // Slot holding edge (a, b) with a < b, or the empty slot ending its probe
+  unsigned int h = (unsigned int) a*2654435761u ^ (unsigned int) b*40503u;
+  int i = h & (map->size-1);
+  while (map->keys[2*i] != -1 &&
+	 (map->keys[2*i] != a || map->keys[2*i+1] != b))
+    i = (i+1) & (map->size-1);
+  return i;
+}
+
+
+static void alloc_edge_map(struct edge_map* map, int size){
+  int i;
+  map->nitems = 0;
+  map->size = size;
+  map->keys = malloc(2*size*sizeof(int));
+  map->values = malloc(size*sizeof(int));
+  for (i=0; i<2*size; i++)
+    map->keys[i] = -1;
+}
+
+
+struct edge_map* new_edge_map(){
+  struct edge_map* map = malloc(sizeof(struct edge_map));
+  alloc_edge_map(map, EDGE_MAP_SIZE);
+  return map;
+}
+
+
+int get_edge_node(struct edge_map* map, int a, int b){
+  int i;
+  if (a > b)
+    i = a, a = b, b = i;
+  i = edge_slot(map, a, b);
+  return map->keys[2*i] == -1 ? -1 : map->values[i];
+}
+
+
+void set_edge_node(struct edge_map* map, int a, int b, int node_id){
+  int i, size = map->size;
+  int *keys = map->keys, *values = map->values;
+  if (2*(map->nitems+1) > size){
+    // Keep the load factor below one half
+    alloc_edge_map(map, 2*size);
+    for (i=0; i<size; i++){
+      if (keys[2*i] != -1)
+	set_edge_node(map, keys[2*i], keys[2*i+1], values[i]);
+    }
+    free(keys), free(values);
+  }
+  if (a > b)
+    i = a, a = b, b = i;
+  i = edge_slot(map, a, b);
+  if (map->keys[2*i] == -1){
+    map->keys[2*i] = a;
+    map->keys[2*i+1] = b;
+    map->nitems++;
+  }
+  map->values[i] = node_id;
+}
+
+
+void renumber_edge_map(struct edge_map* map, int* node_map){
+  // Rehashes every edge under new node ids.  Edges that now coincide
+  // keep one entry.
+  int i, size = map->size;
+  int *keys = map->keys, *values = map->values;
+  alloc_edge_map(map, size);
+  for (i=0; i<size; i++){
+    if (keys[2*i] != -1)
+      set_edge_node(map, node_map[keys[2*i]], node_map[keys[2*i+1]],
+		    node_map[values[i]]);
+  }
+  free(keys), free(values);
+}
+
+void free_edge_map(struct edge_map* map){
+  free(map->keys);
+  free(map->values);
+  free(map);
+}
+
+
 void free_mesh(struct list* nodes, struct list* elements){
   int i;
   struct element* e;
@@ -80,3 +173,91 @@ void free_mesh(struct list* nodes, struct list* elements){
   free_items(elements, free_element);
   free_list(elements);
 }
+
+
+/***********************************************
+ * Views over caller arrays
+ */
+
+
+_Static_assert(sizeof(struct node) == 2*sizeof(double),
+	       "Node views need struct node to be a coordinate pair");
+
+
+static struct mesh_view* new_mesh_view(struct list* nodes,
+				       struct list* elements){
+  struct mesh_view* v = malloc(sizeof(struct mesh_view));
+  v->first_node = nodes != NULL ? nodes->nitems : 0;
+  v->first_element = elements != NULL ? elements->nitems : 0;
+  v->nnodes = v->nelements = v->nenodes = 0;
+  v->block = NULL;
+  return v;
+}
+
+
+struct mesh_view* new_node_view(struct list* nodes, double* xy, int n){
+  // Appends the n nodes (xy[2*i], xy[2*i+1])
+  struct mesh_view* v = new_mesh_view(nodes, NULL);
+  int i;
+  v->nnodes = n;
+  for (i=0; i<n; i++)
+    append(nodes, (struct node*) (xy + 2*(size_t) i));
+  return v;
+}
+
+
+struct mesh_view* new_element_view(struct list* elements, int et_id,
+				   int* IEN, int n, int nenodes){
+  // Appends n elements whose nodes are the rows of the n x nenodes IEN
+  struct mesh_view* v = new_mesh_view(NULL, elements);
+  int i;
+  v->nelements = n;
+  v->nenodes = nenodes;
+  v->block = malloc((n > 0 ? n : 1)*sizeof(struct element));
+  for (i=0; i<n; i++){
+    v->block[i].et_id = et_id;
+    v->block[i].IEN = IEN + (size_t) i*nenodes;
+    append(elements, v->block + i);
+  }
+  return v;
+}
+
+
+void own_mesh_view(struct mesh_view* v, struct list* nodes,
+		   struct list* elements){
+  // Replaces the viewed nodes and elements by copies, so the mesh can
+  // be renumbered or freed as usual.  Frees the view.
+  struct node* n;
+  struct element* e;
+  int i, *IEN;
+  for (i=v->first_node; i<v->first_node+v->nnodes; i++){
+    n = nodes->array[i];
+    nodes->array[i] = new_node(n->x, n->y);
+  }
+  for (i=v->first_element; i<v->first_element+v->nelements; i++){
+    e = elements->array[i];
+    IEN = malloc(v->nenodes*sizeof(int));
+    memcpy(IEN, e->IEN, v->nenodes*sizeof(int));
+    elements->array[i] = new_element(e->et_id, IEN);
+  }
+  free(v->block);
+  free(v);
+}
+
+
+static void remove_range(struct list* l, int first, int n){
+  memmove(l->array + first, l->array + first + n,
+	  (l->nitems - first - n)*sizeof(void*));
+  l->nitems -= n;
+}
+
+
+void drop_mesh_view(struct mesh_view* v, struct list* nodes,
+		    struct list* elements){
+  // Takes the viewed nodes and elements out of the mesh, which is
+  // being freed.  Views are dropped last first.  Frees the view.
+  remove_range(nodes, v->first_node, v->nnodes);
+  remove_range(elements, v->first_element, v->nelements);
+  free(v->block);
+  free(v);
+}
@@ -16,9 +16,46 @@ struct element{
 };
 
 
+// Midside node lookup keyed by the (unordered) pair of corner nodes of
+// an element edge, so elements sharing an edge share its midside node
+struct edge_map{
+  int nitems;
+  int size;
+  int* keys;    // 2*size corner node ids, -1 marks an empty slot
+  int* values;  // Midside node ids
+};
+
+
+// Nodes and elements appended over caller arrays, without copying them.
+// A viewed node is a coordinate pair of the caller's xy array, which
+// struct node matches, and a viewed element, held in the view's block,
+// points into the caller's connectivity.
+struct mesh_view{
+  int first_node;
+  int nnodes;
+  int first_element;
+  int nelements;
+  int nenodes;              // Nodes per viewed element
+  struct element* block;
+};
+
+
 struct node* new_node(double x, double y);
 struct element* new_element(int et_id, int* IEN);
 void print_node(struct node* n);
 void print_element(struct element* e, int nenodes);
 void print_mesh(struct list* nodes, struct list* elements, int* nenodes);
+void free_element(void* e);
+struct edge_map* new_edge_map();
+int get_edge_node(struct edge_map* map, int a, int b);
+void set_edge_node(struct edge_map* map, int a, int b, int node_id);
+void renumber_edge_map(struct edge_map* map, int* node_map);
+void free_edge_map(struct edge_map* map);
 void free_mesh(struct list* nodes, struct list* elements);
+struct mesh_view* new_node_view(struct list* nodes, double* xy, int n);
+struct mesh_view* new_element_view(struct list* elements, int et_id,
+				   int* IEN, int n, int nenodes);
+void own_mesh_view(struct mesh_view* v, struct list* nodes,
+		   struct list* elements);
+void drop_mesh_view(struct mesh_view* v, struct list* nodes,
+		    struct list* elements);
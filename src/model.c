@@ -1,29 +1,59 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
-#include <assert.h>
+#include <math.h>
+#include "lib/log.h"
 #include "lib/list.h"
+#include "lib/linalg.h"
+#include "lib/outbuf.h"
 #include "mesh.h"
 #include "element_types.h"
 #include "bc_data.h"
 #include "model.h"
 #include "solver.h"
+#include "dd_solver.h"
 #include "post.h"
+#include "superelement.h"
+#include "shape.h"
+#include "adapt.h"
+#include "nonlinear.h"
+#include "results.h"
+#include "checkpoint.h"
+#include "parametric.h"
+#include "spatial.h"
+
+
+#define LINE_TOL 1e-8  // Default line selection width over its length
+#define MERGE_TOL 1e-8 // Default node merge distance over the mesh size
 
 
 struct model* new_model(){
-  printf("**********************************************\n");
-  printf("*****Creating new model***********************\n");
-  printf("**********************************************\n");
+  lprintf("**********************************************\n");
+  lprintf("*****Creating new model***********************\n");
+  lprintf("**********************************************\n");
   struct model* new_model = malloc(sizeof(struct model));
   new_model->free_dof = 0;
   new_model->total_dof = 0;
+  new_model->nsub = 2;
+  new_model->bc_mode = BC_ELIMINATE;
+  new_model->bc_scale = 0.0;
   new_model->nodes = new_list();
   new_model->elements = new_list();
   new_model->et_defs = new_list();
   new_model->essential_bcs = new_list();
   new_model->nodal_forces = new_list();
+  new_model->masters = new_list();
+  new_model->superelements = new_list();
+  new_model->midnodes = new_edge_map();
+  new_model->transitions = new_list();
+  new_model->views = new_list();
   new_model->solution = NULL;
+  new_model->param = NULL;
+  new_model->index = NULL;
+  new_model->node_sets = new_list();
+  new_model->curve = CURVE_NONE;
+  new_model->order = NULL;
+  new_model->writer = new_result_writer();
   return new_model;
 }
 
@@ -31,110 +61,780 @@ struct model* new_model(){
 // Mesh functions
 
 void new_model_node(struct model* running_model, double x, double y){
-  printf("Creating new node at (%g, %g)\n", x, y);
+  lprintf("Creating new node at (%g, %g)\n", x, y);
   struct node* n = new_node(x, y);
   append(running_model->nodes, n);
 }
 
 
 
-void new_model_element(struct model* running_model, int et_id, int* IEN){
-  printf("Creating new element of type %d\n", et_id);
+static int* midside_nodes(struct model* running_model, int* IEN,
+			  int ncorners, int given){
+  // Completes the connectivity of a quadratic element.  Edge k joins
+  // corners k and k+1 and its midside node is local node ncorners+k.
+  // A missing midside node is taken from a neighbour sharing the edge,
+  // or created at the edge midpoint.  Given midside nodes are recorded
+  // so later neighbours share them.
+  struct node *a, *b;
+  int k, n0, n1, mid;
+  IEN = realloc(IEN, 2*ncorners*sizeof(int));
+  for (k=0; k<ncorners; k++){
+    n0 = IEN[k], n1 = IEN[(k+1)%ncorners];
+    if (given){
+      set_edge_node(running_model->midnodes, n0, n1, IEN[ncorners+k]);
+      continue;
+    }
+    mid = get_edge_node(running_model->midnodes, n0, n1);
+    if (mid == -1){
+      a = running_model->nodes->array[n0];
+      b = running_model->nodes->array[n1];
+      new_model_node(running_model, 0.5*(a->x + b->x), 0.5*(a->y + b->y));
+      mid = running_model->nodes->nitems-1;
+      set_edge_node(running_model->midnodes, n0, n1, mid);
+    }
+    IEN[ncorners+k] = mid;
+  }
+  return IEN;
+}
+
+
+int new_model_element(struct model* running_model, int et_id, int* IEN,
+		      int nnodes){
+  // Quadratic elements may be given with their corner nodes only
+  lprintf("Creating new element of type %d\n", et_id);
+  // Takes ownership of IEN, which is freed if the element is invalid
   struct et_def* et = get_et_def(running_model->et_defs, et_id);
-  assert(et != NULL);
+  int i;
+  if (et == NULL || et->nenodes == 0){
+    lprintf("Error: Element type %d is not defined%s\n", et_id,
+	   et != NULL ? " by a superelement" : "");
+    free(IEN);
+    return 1;
+  }
+  for (i=0; i<nnodes; i++){
+    if (IEN[i] < 0 || IEN[i] >= running_model->nodes->nitems){
+      lprintf("Error: Invalid node %d\n", IEN[i]);
+      free(IEN);
+      return 1;
+    }
+  }
+  if (quadratic_element(et->lib_id) &&
+      (nnodes == et->nenodes || nnodes == et->nenodes/2))
+    IEN = midside_nodes(running_model, IEN, et->nenodes/2,
+			nnodes == et->nenodes);
+  else if (nnodes != et->nenodes){
+    lprintf("Error: Element type %d needs %d nodes, %d given\n",
+	   et_id, et->nenodes, nnodes);
+    free(IEN);
+    return 1;
+  }
+  if (et->sedata != NULL){
+    struct matrix* COORDS = construct_COORDS(running_model->nodes, IEN,
+					     nnodes);
+    i = rigid_instance(et->sedata, COORDS);
+    free_matrix(COORDS);
+    if (!i){
+      free(IEN);
+      return 1;
+    }
+  }
   struct element* e = new_element(et_id, IEN);
   append(running_model->elements, e);
   print_element(e, et->nenodes);
+  return 0;
+}
+
+
+static void own_model_mesh(struct model* running_model){
+  // Copies the caller arrays under the mesh, before the mesh is
+  // renumbered or handed over
+  int i;
+  for (i=0; i<running_model->views->nitems; i++)
+    own_mesh_view(running_model->views->array[i], running_model->nodes,
+		  running_model->elements);
+  running_model->views->nitems = 0;
+}
+
+
+static void renumber_model_bcs(struct model* running_model, int* map){
+  // Constraints of merged nodes on the same dof keep the first value,
+  // and their forces add up
+  struct list* ebcs = running_model->essential_bcs;
+  struct list* forces = running_model->nodal_forces;
+  struct essential_bc* ebc;
+  struct nodal_force *ndf, *kept;
+  int nnodes = running_model->nodes->nitems;
+  int* first = malloc(2*(nnodes > 0 ? nnodes : 1)*sizeof(int));
+  int i, k, n;
+  for (k=0; k<2*nnodes; k++)
+    first[k] = -1;
+  for (i=0, n=0; i<ebcs->nitems; i++){
+    ebc = ebcs->array[i];
+    ebc->node_id = map[ebc->node_id];
+    k = 2*ebc->node_id + ebc->dof;
+    if (first[k] == -1)
+      first[k] = n, ebcs->array[n++] = ebc;
+    else
+      free_essential_bc(ebc);
+  }
+  ebcs->nitems = n;
+  for (k=0; k<2*nnodes; k++)
+    first[k] = -1;
+  for (i=0, n=0; i<forces->nitems; i++){
+    ndf = forces->array[i];
+    ndf->node_id = map[ndf->node_id];
+    k = 2*ndf->node_id + ndf->dof;
+    if (first[k] == -1)
+      first[k] = n, forces->array[n++] = ndf;
+    else{
+      kept = forces->array[first[k]];
+      kept->value += ndf->value;
+      free_nodal_force(ndf);
+    }
+  }
+  forces->nitems = n;
+  free(first);
+}
+
+
+static void renumber_model_nodes(struct model* running_model, int* map){
+  // Rewrites every node id held by the model after a merge.  The
+  // solution, unit matrices and index no longer fit the mesh.
+  struct list* masters = running_model->masters;
+  struct element* e;
+  struct et_def* et;
+  struct transition* tr;
+  char* seen = calloc(running_model->nodes->nitems+1, 1);
+  int* m;
+  int i, a, b, n, degenerate = 0;
+  for (i=0; i<running_model->elements->nitems; i++){
+    e = running_model->elements->array[i];
+    et = get_et_def(running_model->et_defs, e->et_id);
+    for (a=0, n=0; a<et->nenodes; a++){
+      e->IEN[a] = map[e->IEN[a]];
+      for (b=0; b<a; b++)
+	n += e->IEN[b] == e->IEN[a];
+    }
+    degenerate += n > 0;
+  }
+  if (degenerate > 0)
+    lprintf("Warning: %d elements have merged nodes of their own\n",
+	    degenerate);
+  for (i=0; i<running_model->transitions->nitems; i++){
+    tr = running_model->transitions->array[i];
+    for (a=0; a<4; a++)
+      tr->IEN[a] = map[tr->IEN[a]];
+  }
+  renumber_model_bcs(running_model, map);
+  for (i=0, n=0; i<masters->nitems; i++){
+    m = masters->array[i];
+    *m = map[*m];
+    if (seen[*m])
+      free(m);
+    else
+      seen[*m] = 1, masters->array[n++] = m;
+  }
+  masters->nitems = n;
+  renumber_edge_map(running_model->midnodes, map);
+  for (i=0; i<running_model->node_sets->nitems; i++)
+    renumber_node_set(running_model->node_sets->array[i], map);
+  free(seen);
+  if (running_model->solution != NULL)
+    free_static_soln(running_model->solution);
+  running_model->solution = NULL;
+  if (running_model->param != NULL)
+    free_param_system(running_model->param);
+  running_model->param = NULL;
+  if (running_model->index != NULL)
+    free_spatial_index(running_model->index);
+  running_model->index = NULL;
+  if (running_model->order != NULL)
+    free_mesh_order(running_model->order);
+  running_model->order = NULL;
+}
+
+
+int merge_model_nodes(struct model* running_model, double tol){
+  // Nodes within tol of each other become one, for meshes built from
+  // parts.  A tol of 0 takes MERGE_TOL of the mesh size.
+  struct list* nodes = running_model->nodes;
+  struct node* nd;
+  double xmin = 0.0, xmax = 0.0, ymin = 0.0, ymax = 0.0;
+  int i, merged, n = nodes->nitems;
+  int* map;
+  if (tol < 0.0){
+    lprintf("Error: Invalid node merge tolerance: %g\n", tol);
+    return 1;
+  }
+  if (tol == 0.0){
+    for (i=0; i<n; i++){
+      nd = nodes->array[i];
+      xmin = i == 0 ? nd->x : fmin(xmin, nd->x);
+      xmax = i == 0 ? nd->x : fmax(xmax, nd->x);
+      ymin = i == 0 ? nd->y : fmin(ymin, nd->y);
+      ymax = i == 0 ? nd->y : fmax(ymax, nd->y);
+    }
+    tol = MERGE_TOL*fmax(fmax(xmax-xmin, ymax-ymin), 1.0);
+  }
+  own_model_mesh(running_model);
+  map = malloc((n > 0 ? n : 1)*sizeof(int));
+  merged = merge_nodes(nodes, tol, map);
+  lprintf("Merged %d coincident nodes within %g, %d nodes left\n",
+	  merged, tol, nodes->nitems);
+  if (merged > 0)
+    renumber_model_nodes(running_model, map);
+  free(map);
+  return 0;
+}
+
+
+static struct mesh_order* model_order(struct model* running_model){
+  // Built on first use, and again once the mesh has changed
+  struct mesh_order* mo = running_model->order;
+  if (mo != NULL && (mo->curve != running_model->curve ||
+		     mo->nnodes != running_model->nodes->nitems ||
+		     mo->nelems != running_model->elements->nitems)){
+    free_mesh_order(mo);
+    mo = NULL;
+  }
+  if (mo == NULL && running_model->curve != CURVE_NONE)
+    mo = new_mesh_order(running_model->nodes, running_model->elements,
+			running_model->et_defs, running_model->curve);
+  running_model->order = mo;
+  return mo;
+}
+
+
+/*
+ * curve = HILBERT | MORTON (Z order) | OFF (input order)
+ * Only equation numbers and the order of element loops change, so node
+ * and element ids, and the output, stay those of the input.
+ */
+int reorder_model_mesh(struct model* running_model, char* curve){
+  if (strcmp(curve, "HILBERT") == 0)
+    running_model->curve = CURVE_HILBERT;
+  else if (strcmp(curve, "MORTON") == 0)
+    running_model->curve = CURVE_MORTON;
+  else if (strcmp(curve, "OFF") == 0)
+    running_model->curve = CURVE_NONE;
+  else{
+    lprintf("Error: Invalid curve: %s\n", curve);
+    return 1;
+  }
+  if (model_order(running_model) == NULL)
+    lprintf("Using the input order of the mesh\n");
+  else
+    lprintf("Ordered %d nodes and %d elements along a %s curve\n",
+	    running_model->nodes->nitems, running_model->elements->nitems,
+	    running_model->curve == CURVE_HILBERT ? "Hilbert" : "Morton");
+  return 0;
+}
+
+
+int* model_node_order(struct model* running_model){
+  // Node ids in equation order, or NULL for the input order
+  struct mesh_order* mo = model_order(running_model);
+  return mo != NULL ? mo->nodes : NULL;
+}
+
+
+int* model_element_order(struct model* running_model){
+  // Element ids in assembly order, or NULL for the input order
+  struct mesh_order* mo = model_order(running_model);
+  return mo != NULL ? mo->elements : NULL;
 }
 
 
 // Element type definition functions
 
-void new_model_element_type(struct model* running_model,
-		      int et_id, char* type_name){
-  printf("Creating new element type %s with id %d\n", type_name, et_id);
+int new_model_element_type(struct model* running_model,
+			   int et_id, char* type_name){
+  lprintf("Creating new element type %s with id %d\n", type_name, et_id);
+  if (get_et_def(running_model->et_defs, et_id) != NULL){
+    lprintf("Error: Element type %d is already defined\n", et_id);
+    return 1;
+  }
   struct et_def* et = new_et_def(et_id, type_name);
+  if (et == NULL)
+    return 1;
   print_et_def(et);
   append(running_model->et_defs, et);
+  return 0;
 }
 
 
-void set_model_et_real_constant(struct model* running_model,
-			     int et_id, int const_id, double value){
+int set_model_et_real_constant(struct model* running_model,
+			       int et_id, int const_id, double value){
   struct et_def* et = get_et_def(running_model->et_defs, et_id);
-  assert(et != NULL);
-  set_real_constant(et, const_id, value);
+  if (et == NULL){
+    lprintf("Error: Element type %d is not defined\n", et_id);
+    return 1;
+  }
+  if (set_real_constant(et, const_id, value) != 0)
+    return 1;
   print_et_def(et);
+  return 0;
 }
 
 
-void set_model_et_keyopt(struct model* running_model,
-		      int et_id, int key, int option){
+int set_model_et_keyopt(struct model* running_model,
+			int et_id, int key, int option){
   struct et_def* et = get_et_def(running_model->et_defs, et_id);
-  assert(et != NULL);
-  set_keyopt(et, key, option);
+  if (et == NULL){
+    lprintf("Error: Element type %d is not defined\n", et_id);
+    return 1;
+  }
+  if (set_keyopt(et, key, option) != 0)
+    return 1;
   print_et_def(et);
+  return 0;
 }
 
 
-void set_model_et_matprop(struct model* running_model,
-		       int et_id, char* prop_name, double value){
+int set_model_et_matprop(struct model* running_model,
+			 int et_id, char* prop_name, double value){
   struct et_def* et = get_et_def(running_model->et_defs, et_id);
-  assert(et != NULL);
-  set_matprop(et, prop_name, value);
+  if (et == NULL){
+    lprintf("Error: Element type %d is not defined\n", et_id);
+    return 1;
+  }
+  if (set_matprop(et, prop_name, value) != 0)
+    return 1;
   print_et_def(et);
+  return 0;
 }
 
 
 // Boundary condition functions
 
+static void set_essential_bc(struct list* essential_bcs, int node_id,
+			     int dof, double value){
+  // A constrained dof takes the new value, for new load cases
+  struct essential_bc* ebc;
+  int i;
+  for (i=0; i<essential_bcs->nitems; i++){
+    ebc = essential_bcs->array[i];
+    if (ebc->node_id == node_id && ebc->dof == dof){
+      ebc->value = value;
+      print_essential_bc(ebc);
+      return;
+    }
+  }
+  ebc = new_essential_bc(node_id, dof, value);
+  append(essential_bcs, ebc);
+  print_essential_bc(ebc);
+}
+
+
 void add_model_essential_bc(struct model* running_model,
 			    int node_id, char* comp, double value){
   if (strcmp(comp, "ALL") == 0){
-    struct essential_bc* ebcX = new_essential_bc(node_id, 0, value);
-    struct essential_bc* ebcY = new_essential_bc(node_id, 1, value);
-    append(running_model->essential_bcs, ebcX);
-    append(running_model->essential_bcs, ebcY);
-    print_essential_bc(ebcX), print_essential_bc(ebcY);
-  }
-  else if (strcmp(comp, "Y") == 0) {
-    struct essential_bc* ebcY = new_essential_bc(node_id, 1, value);
-    append(running_model->essential_bcs, ebcY);
-    print_essential_bc(ebcY);
-  }
-  else {
-    struct essential_bc* ebcX = new_essential_bc(node_id, 0, value);
-    append(running_model->essential_bcs, ebcX);
-    print_essential_bc(ebcX);
+    set_essential_bc(running_model->essential_bcs, node_id, 0, value);
+    set_essential_bc(running_model->essential_bcs, node_id, 1, value);
   }
+  else if (strcmp(comp, "Y") == 0)
+    set_essential_bc(running_model->essential_bcs, node_id, 1, value);
+  else
+    set_essential_bc(running_model->essential_bcs, node_id, 0, value);
 }
 
 
-void add_model_nodal_force(struct model* running_model,
-			   int node_id, char* comp, double value){
+int add_model_nodal_force(struct model* running_model,
+			  int node_id, char* comp, double value){
+  // A force on a loaded dof replaces the old value, for new load cases
   struct nodal_force* ndf;
+  int i, dof;
   if (strcmp(comp, "X") == 0)
-    ndf = new_nodal_force(node_id, 0, value);
+    dof = 0;
   else if (strcmp(comp, "Y") == 0)
-    ndf = new_nodal_force(node_id, 1, value);
-  else
-    ndf = NULL;
+    dof = 1;
+  else{
+    lprintf("Error: Invalid force component: %s\n", comp);
+    return 1;
+  }
+  for (i=0; i<running_model->nodal_forces->nitems; i++){
+    ndf = running_model->nodal_forces->array[i];
+    if (ndf->node_id == node_id && ndf->dof == dof){
+      ndf->value = value;
+      print_nodal_force(ndf);
+      return 0;
+    }
+  }
+  ndf = new_nodal_force(node_id, dof, value);
   append(running_model->nodal_forces, ndf);
   print_nodal_force(ndf);
+  return 0;
+}
+
+
+void delete_model_essential_bc(struct model* running_model,
+			       int node_id, char* comp){
+  // Frees the support of a node, for studies that toggle supports
+  struct list* ebcs = running_model->essential_bcs;
+  struct essential_bc* ebc;
+  int i, n = 0;
+  int all = strcmp(comp, "ALL") == 0, dof = strcmp(comp, "Y") == 0;
+  for (i=0; i<ebcs->nitems; i++){
+    ebc = ebcs->array[i];
+    if (ebc->node_id == node_id && (all || ebc->dof == dof)){
+      lprintf("Deleting essential bc on node %d, dof %d\n", node_id,
+	      ebc->dof);
+      free_essential_bc(ebc);
+    }
+    else
+      ebcs->array[n++] = ebc;
+  }
+  ebcs->nitems = n;
+}
+
+
+int set_model_bc_mode(struct model* running_model, int mode,
+		      double scale){
+  if (mode < BC_ELIMINATE || mode > BC_LAGRANGE || scale < 0.0){
+    lprintf("Error: Invalid essential bc mode: %d, %g\n", mode, scale);
+    return 1;
+  }
+  lprintf("Enforcing essential bcs by %s\n", mode == BC_ELIMINATE ?
+	  "elimination" : mode == BC_PENALTY ? "penalty" :
+	  "augmented Lagrange");
+  running_model->bc_mode = mode;
+  running_model->bc_scale = scale;
+  return 0;
+}
+
+
+// Selection functions
+
+static struct spatial_index* model_index(struct model* running_model){
+  // Built on first use, and again once the mesh has grown
+  struct spatial_index* si = running_model->index;
+  if (si != NULL && (si->nnodes != running_model->nodes->nitems ||
+		     si->nelems != running_model->elements->nitems)){
+    free_spatial_index(si);
+    si = NULL;
+  }
+  if (si == NULL)
+    si = new_spatial_index(running_model->nodes, running_model->elements);
+  running_model->index = si;
+  return si;
+}
+
+
+static struct node_set* find_node_set(struct list* node_sets, char* name){
+  struct node_set* set;
+  int i;
+  for (i=0; i<node_sets->nitems; i++){
+    set = node_sets->array[i];
+    if (strcmp(set->name, name) == 0)
+      return set;
+  }
+  return NULL;
+}
+
+
+static int node_id_spec(char* spec){
+  // Node ids are numbers, anything else names a node set
+  return (spec[0] >= '0' && spec[0] <= '9') || spec[0] == '-' ||
+    spec[0] == '+';
+}
+
+
+/*
+ * how = BOX (xmin, xmax, ymin, ymax)
+ *     | LINE (x1, y1, x2, y2[, tol]), tol a small fraction of the length
+ *           by default
+ *     | NEAR (x, y), the nearest node
+ * A selection replaces any earlier set of the same name.
+ */
+int select_model_nodes(struct model* running_model, char* name,
+		       char* how, int nargs, double* args){
+  struct list* nodes = running_model->nodes;
+  struct spatial_index* si;
+  struct node_set* set;
+  struct outbuf* ob;
+  double tol;
+  int* ids;
+  int i, n;
+  if (node_id_spec(name)){
+    lprintf("Error: Node set name %s is a node id\n", name);
+    return 1;
+  }
+  si = model_index(running_model);
+  ids = malloc((nodes->nitems > 0 ? nodes->nitems : 1)*sizeof(int));
+  if (strcmp(how, "BOX") == 0 && nargs == 4)
+    n = select_box(si, nodes, args[0], args[1], args[2], args[3], ids);
+  else if (strcmp(how, "LINE") == 0 && (nargs == 4 || nargs == 5)){
+    tol = nargs == 5 ? args[4] :
+      LINE_TOL*fmax(hypot(args[2]-args[0], args[3]-args[1]), 1.0);
+    n = select_line(si, nodes, args[0], args[1], args[2], args[3], tol,
+		    ids);
+  }
+  else if (strcmp(how, "NEAR") == 0 && nargs == 2){
+    ids[0] = select_nearest(si, nodes, args[0], args[1]);
+    n = ids[0] != -1;
+  }
+  else{
+    lprintf("Error: Invalid node selection: %s with %d values\n", how,
+	    nargs);
+    free(ids);
+    return 1;
+  }
+  set = find_node_set(running_model->node_sets, name);
+  if (set != NULL){
+    free(set->ids);
+    set->ids = malloc((n > 0 ? n : 1)*sizeof(int));
+    memcpy(set->ids, ids, n*sizeof(int));
+    set->n = n;
+  }
+  else{
+    set = new_node_set(name, n, ids);
+    append(running_model->node_sets, set);
+  }
+  free(ids);
+  lprintf("Node set %s: %d nodes\n", name, n);
+  ob = new_outbuf(log_stream());
+  for (i=0; i<n; i++)
+    outbuf_printf(ob, "%d%s", set->ids[i], i%10 == 9 || i == n-1 ? "\n" : " ");
+  free_outbuf(ob);
+  return 0;
+}
+
+
+int* get_model_nodes(struct model* running_model, char* spec, int* n){
+  // The node id of spec, or the nodes of the set it names, in a new
+  // array.  NULL for an unknown set.
+  struct node_set* set;
+  int* ids;
+  if (node_id_spec(spec)){
+    if (atoi(spec) < 0 || atoi(spec) >= running_model->nodes->nitems){
+      lprintf("Error: Invalid node %s\n", spec);
+      return NULL;
+    }
+    ids = malloc(sizeof(int));
+    ids[0] = atoi(spec);
+    *n = 1;
+    return ids;
+  }
+  set = find_node_set(running_model->node_sets, spec);
+  if (set == NULL){
+    lprintf("Error: No node set %s\n", spec);
+    return NULL;
+  }
+  ids = malloc((set->n > 0 ? set->n : 1)*sizeof(int));
+  memcpy(ids, set->ids, set->n*sizeof(int));
+  *n = set->n;
+  return ids;
+}
+
+
+static struct static_soln* model_solution(struct model* running_model,
+					  char* use){
+  // The last solution, or NULL if there is none or the nodes have
+  // changed since it was solved
+  struct static_soln* sol = running_model->solution;
+  if (sol == NULL){
+    lprintf("Error: No solution to %s\n", use);
+    return NULL;
+  }
+  if (sol->ID->nrows != running_model->nodes->nitems){
+    lprintf("Error: Nodes changed since the last solve\n");
+    return NULL;
+  }
+  return sol;
+}
+
+
+// Superelement functions
+
+int add_model_master(struct model* running_model, int node_id){
+  lprintf("Adding master node %d\n", node_id);
+  if (node_id < 0 || node_id >= running_model->nodes->nitems){
+    lprintf("Error: Invalid node %d\n", node_id);
+    return 1;
+  }
+  int* m = malloc(sizeof(int));
+  *m = node_id;
+  append(running_model->masters, m);
+  return 0;
+}
+
+
+int generate_model_superelement(struct model* running_model, int se_id){
+  // Condenses the current mesh into a superelement.  The mesh, boundary
+  // conditions and masters are consumed, so the model is left empty
+  // and ready for the use pass.  On failure the model is unchanged.
+  lprintf("Generating superelement %d\n", se_id);
+  if (get_superelement(running_model->superelements, se_id) != NULL){
+    lprintf("Error: Superelement %d is already defined\n", se_id);
+    return 1;
+  }
+  own_model_mesh(running_model);
+  struct superelement* se;
+  se = new_superelement(se_id, running_model->nodes,
+			running_model->elements, running_model->et_defs,
+			running_model->essential_bcs,
+			running_model->nodal_forces, running_model->masters);
+  if (se == NULL)
+    return 1;
+  print_superelement(se);
+  append(running_model->superelements, se);
+  running_model->nodes = new_list();
+  free_edge_map(running_model->midnodes);
+  running_model->midnodes = new_edge_map();
+  free_items(running_model->transitions, free);
+  free_list(running_model->transitions);
+  running_model->transitions = new_list();
+  running_model->essential_bcs = new_list();
+  free_items(running_model->elements, free_element);
+  free_list(running_model->elements);
+  running_model->elements = new_list();
+  free_items(running_model->nodal_forces, free_nodal_force);
+  free_list(running_model->nodal_forces);
+  running_model->nodal_forces = new_list();
+  free_items(running_model->masters, free);
+  free_list(running_model->masters);
+  running_model->masters = new_list();
+  if (running_model->order != NULL)
+    free_mesh_order(running_model->order);
+  running_model->order = NULL;
+  return 0;
+}
+
+
+int set_model_et_superelement(struct model* running_model, int et_id,
+			      int se_id){
+  struct et_def* et = get_et_def(running_model->et_defs, et_id);
+  struct superelement* se;
+  se = get_superelement(running_model->superelements, se_id);
+  if (et == NULL || se == NULL){
+    lprintf("Error: Element type %d or superelement %d is not defined\n",
+	   et_id, se_id);
+    return 1;
+  }
+  if (set_superelement(et, se) != 0)
+    return 1;
+  print_et_def(et);
+  return 0;
+}
+
+
+int expand_model_superelement(struct model* running_model, int elem_id){
+  struct static_soln* sol = running_model->solution;
+  if (model_solution(running_model, "expand") == NULL)
+    return 1;
+  if (elem_id < 0 || elem_id >= running_model->elements->nitems){
+    lprintf("Error: Invalid element %d\n", elem_id);
+    return 1;
+  }
+  struct element* e = running_model->elements->array[elem_id];
+  struct et_def* et = get_et_def(running_model->et_defs, e->et_id);
+  if (et->sedata == NULL){
+    lprintf("Error: Element %d is not a superelement\n", elem_id);
+    return 1;
+  }
+  lprintf("Expanding superelement %d for element %d\n",
+	 et->sedata->se_id, elem_id);
+  struct matrix* COORDS = construct_COORDS(running_model->nodes, e->IEN,
+					   et->nenodes);
+  struct vector* UE = new_vector(et->ndof*et->nenodes);
+  int i, j, P, node_id;
+  for (i=0; i<et->nenodes; i++){
+    node_id = e->IEN[i];
+    for (j=0; j<et->ndof; j++){
+      P = sol->ID->array[node_id][j];
+      if (P != -1)
+	UE->array[et->ndof*i+j] = sol->U->array[P];
+      else
+	UE->array[et->ndof*i+j] =
+	  sol->G->array[(int) sol->CID->array[node_id][j]];
+    }
+  }
+  expand_superelement(et->sedata, COORDS, UE);
+  free_matrix(COORDS), free_vector(UE);
+  return 0;
 }
 
 
 // Other functions
 
 
-static void setup_model_for_solve(struct model* running_model){
+static int setup_model_for_solve(struct model* running_model){
+  // Returns 1 if the model cannot be solved
   struct list* nodes = running_model->nodes;
   struct list* essential_bcs = running_model->essential_bcs;
-  struct et_def* et = running_model->et_defs->array[0];
+  struct essential_bc* ebc;
+  struct nodal_force* ndf;
+  struct et_def* et;
+  int i;
+  if (running_model->et_defs->nitems == 0 ||
+      running_model->elements->nitems == 0){
+    lprintf("Error: No elements to solve\n");
+    return 1;
+  }
+  et = running_model->et_defs->array[0];
+  for (i=1; i<running_model->et_defs->nitems; i++){
+    if (((struct et_def*) running_model->et_defs->array[i])->ndof !=
+	et->ndof){
+      lprintf("Error: Element types mix structural and thermal dof\n");
+      return 1;
+    }
+  }
+  for (i=0; i<essential_bcs->nitems; i++){
+    ebc = essential_bcs->array[i];
+    if (ebc->dof >= et->ndof){
+      lprintf("Error: Essential bc on dof %d of node %d, the elements "
+	     "have %d dof\n", ebc->dof, ebc->node_id, et->ndof);
+      return 1;
+    }
+  }
+  for (i=0; i<running_model->nodal_forces->nitems; i++){
+    ndf = running_model->nodal_forces->array[i];
+    if (ndf->dof >= et->ndof){
+      lprintf("Error: Nodal force on dof %d of node %d, the elements "
+	     "have %d dof\n", ndf->dof, ndf->node_id, et->ndof);
+      return 1;
+    }
+  }
+  if (check_et_defs(running_model->et_defs) != 0)
+    return 1;
   running_model->nsd = 2;
   running_model->ndof = et->ndof;
   running_model->total_dof = et->ndof*nodes->nitems;
   running_model->free_dof = running_model->total_dof - essential_bcs->nitems;
+  if (running_model->bc_mode != BC_ELIMINATE)
+    running_model->free_dof = running_model->total_dof;
+  return 0;
+}
+
+
+static int solved(struct model* running_model){
+  // Returns 1 if the solve left no solution.  A new solution records the
+  // prescribed values it was found with, if its solver did not.
+  struct static_soln* sol = running_model->solution;
+  if (sol != NULL && sol->CID == NULL)
+    number_constrained_dof(sol, running_model->essential_bcs);
+  return sol == NULL;
+}
+
+
+static int eliminating_bcs(struct model* running_model){
+  // The other solution procedures only number the free dof
+  if (running_model->bc_mode == BC_ELIMINATE)
+    return 1;
+  lprintf("Error: BCMODE %d needs SOLVE, 0, 1 or PSOLVE\n",
+	  running_model->bc_mode);
+  return 0;
+}
+
+
+int set_model_subdomains(struct model* running_model, int nsub){
+  if (nsub < 1){
+    lprintf("Error: Invalid number of subdomains: %d\n", nsub);
+    return 1;
+  }
+  lprintf("Using %d subdomains for domain decomposition\n", nsub);
+  running_model->nsub = nsub;
+  return 0;
 }
 
 
@@ -143,21 +843,185 @@ static void setup_model_for_solve(struct model* running_model){
  * s_type = solver type
  * When p_type = 0 (Static analysis)
  *   s_type = 0 (Dense, direct solver)
- *   s_type = 1 (Sparse, direct solver)
+ *   s_type = 1 (Sparse, skyline LDL^T direct solver)
+ *   s_type = 2 (Domain decomposition, one worker process per subdomain)
+ *   s_type = 3 (Dense, single precision factors with iterative refinement)
+ *   s_type = 4 (Sparse, conjugate gradients with AMG preconditioner)
  * When p_type = 1 (Modal analysis)
  *   s_type = 0 (Dense, QR solver)
+ * Returns 1 if the model was left without a solution
  */
-void solve_model(struct model* running_model, int p_type, int s_type){
-  printf("**********************************************\n");
-  printf("*****Solving model****************************\n");
-  printf("**********************************************\n");
-  setup_model_for_solve(running_model);
-  if (p_type == 0)
+int solve_model(struct model* running_model, int p_type, int s_type){
+  lprintf("**********************************************\n");
+  lprintf("*****Solving model****************************\n");
+  lprintf("**********************************************\n");
+  if (running_model->solution != NULL)
+    free_static_soln(running_model->solution);
+  running_model->solution = NULL;
+  if (setup_model_for_solve(running_model) != 0)
+    return 1;
+  if ((p_type != 0 || s_type != 1) && !eliminating_bcs(running_model))
+    return 1;
+  if (p_type == 0){
     if (s_type == 0)
       running_model->solution = dense_static_solver(running_model);
-  printf("**********************************************\n");
-  printf("*****Finished solving*************************\n");
-  printf("**********************************************\n");
+    else if (s_type == 1)
+      running_model->solution = skyline_static_solver(running_model);
+    else if (s_type == 2)
+      running_model->solution = dd_static_solver(running_model,
+						 running_model->nsub);
+    else if (s_type == 3)
+      running_model->solution = mixed_static_solver(running_model);
+    else if (s_type == 4)
+      running_model->solution = amg_static_solver(running_model);
+    else
+      lprintf("Error: Invalid solver type: %d\n", s_type);
+  }
+  else
+    lprintf("Error: Invalid physics type: %d\n", p_type);
+  lprintf("**********************************************\n");
+  lprintf("*****Finished solving*************************\n");
+  lprintf("**********************************************\n");
+  return solved(running_model);
+}
+
+
+/*
+ * mode = tangent update
+ *   mode = 0 (Full Newton-Raphson)
+ *   mode = 1 (Modified Newton, one factorization per load step)
+ *   mode = 2 (BFGS, one factorization per load step)
+ */
+int solve_model_nonlinear(struct model* running_model, int nsteps,
+			  int mode, int max_iter, double tol){
+  lprintf("**********************************************\n");
+  lprintf("*****Solving nonlinear model******************\n");
+  lprintf("**********************************************\n");
+  if (nsteps <= 0 || max_iter <= 0 || !(tol > 0.0)){
+    lprintf("Error: Invalid load steps, iterations or tolerance: "
+	   "%d, %d, %g\n", nsteps, max_iter, tol);
+    return 1;
+  }
+  if (setup_model_for_solve(running_model) != 0 ||
+      !eliminating_bcs(running_model))
+    return 1;
+  if (running_model->solution != NULL)
+    free_static_soln(running_model->solution);
+  running_model->solution = nonlinear_static_solver(running_model, nsteps,
+						    mode, max_iter, tol);
+  lprintf("**********************************************\n");
+  lprintf("*****Finished solving*************************\n");
+  lprintf("**********************************************\n");
+  return solved(running_model);
+}
+
+
+int resolve_model(struct model* running_model){
+  // New nodal forces and prescribed values against the factors of the
+  // last dense solve
+  int status;
+  lprintf("**********************************************\n");
+  lprintf("*****Solving new load case********************\n");
+  lprintf("**********************************************\n");
+  if (model_solution(running_model, "reuse") == NULL)
+    return 1;
+  if (setup_model_for_solve(running_model) != 0)
+    return 1;
+  status = resolve_static_soln(running_model, running_model->solution);
+  lprintf("**********************************************\n");
+  lprintf("*****Finished solving*************************\n");
+  lprintf("**********************************************\n");
+  return status;
+}
+
+
+int solve_model_parametric(struct model* running_model){
+  // Reuses the unit matrices of the last parametric solve while only
+  // moduli and real constant 1 change
+  struct param_system* ps = running_model->param;
+  struct vector *U, *Rc;
+  lprintf("**********************************************\n");
+  lprintf("*****Parametric solve*************************\n");
+  lprintf("**********************************************\n");
+  if (setup_model_for_solve(running_model) != 0)
+    return 1;
+  if (ps != NULL && !param_system_current(ps, running_model)){
+    lprintf("Model changed, assembling new unit matrices\n");
+    free_param_system(ps);
+    ps = NULL;
+  }
+  if (ps == NULL)
+    ps = new_param_system(running_model);
+  running_model->param = ps;
+  if (running_model->solution != NULL)
+    free_static_soln(running_model->solution);
+  running_model->solution = NULL;
+  if (ps != NULL){
+    Rc = ps->bc_mode == BC_ELIMINATE ? NULL :
+      new_vector(running_model->essential_bcs->nitems);
+    U = param_solve(ps, running_model, Rc);
+    if (U != NULL){
+      running_model->solution =
+	new_static_soln(running_model->ndof, copy_matrix(ps->ID), U);
+      if (Rc != NULL)
+	keep_constraint_forces(running_model->solution,
+			       running_model->essential_bcs, Rc);
+    }
+    else if (Rc != NULL)
+      free_vector(Rc);
+  }
+  lprintf("**********************************************\n");
+  lprintf("*****Finished solving*************************\n");
+  lprintf("**********************************************\n");
+  return solved(running_model);
+}
+
+
+int save_model(struct model* running_model, char* filename){
+  if (model_solution(running_model, "checkpoint") == NULL)
+    return 1;
+  lprintf("Saving checkpoint %s\n", filename);
+  return write_checkpoint(running_model, filename);
+}
+
+
+int resume_model(struct model* running_model, char* filename){
+  if (running_model->nodes->nitems > 0 ||
+      running_model->et_defs->nitems > 0){
+    lprintf("Error: Checkpoints can only be resumed into an empty model\n");
+    return 1;
+  }
+  lprintf("Resuming from checkpoint %s\n", filename);
+  if (read_checkpoint(running_model, filename) != 0)
+    return 1;
+  if (setup_model_for_solve(running_model) != 0)
+    return 1;
+  precomputations(running_model->et_defs);
+  return 0;
+}
+
+
+int adapt_model(struct model* running_model, double target,
+		int max_cycles, int s_type){
+  // target is the relative error in the energy norm, in percent
+  int status;
+  lprintf("**********************************************\n");
+  lprintf("*****Adaptive refinement**********************\n");
+  lprintf("**********************************************\n");
+  if (!(target > 0.0) || max_cycles < 0){
+    lprintf("Error: Invalid target error or cycles: %g, %d\n", target,
+	   max_cycles);
+    return 1;
+  }
+  own_model_mesh(running_model);
+  status = adaptive_solve(running_model, 0.01*target, max_cycles, s_type);
+  if (running_model->index != NULL)
+    free_spatial_index(running_model->index);  // Elements were renumbered
+  running_model->index = NULL;
+  lprintf("**********************************************\n");
+  lprintf("*****Finished adaptive refinement*************\n");
+  lprintf("**********************************************\n");
+  return status;
 }
 
 
@@ -172,15 +1036,284 @@ void print_model_mesh(struct model* running_model){
 }
 
 
-void print_model_result(struct model* running_model, char* res_name){
-  if (running_model->solution != NULL)
-    print_nodal_soln(running_model->nodes, running_model->solution);
+/*
+ * res_name = U (nodal solution)
+ *          | RF (reaction forces at the constrained dof)
+ */
+int print_model_result(struct model* running_model, char* res_name){
+  struct static_soln* sol = running_model->solution;
+  double *u, *R;
+  int n;
+  if (model_solution(running_model, "print") == NULL)
+    return 1;
+  if (strcmp(res_name, "RF") == 0){
+    n = sol->ndof*running_model->nodes->nitems;
+    u = malloc(n*sizeof(double)), R = malloc(n*sizeof(double));
+    construct_nodal_values(running_model, sol, u);
+    if (construct_reactions(running_model, sol, u, R) != 0){
+      free(u), free(R);
+      return 1;
+    }
+    print_reactions(running_model->nodes, sol, R);
+    free(u), free(R);
+  }
   else
-    printf("Error: No solution to print\n");
+    print_nodal_soln(running_model->nodes, sol);
+  return 0;
+}
+
+
+int probe_model_result(struct model* running_model, double x, double y){
+  // Nodal solution interpolated to a point of the mesh
+  struct static_soln* sol = running_model->solution;
+  struct element* e;
+  struct vector* N;
+  double* u;
+  double v;
+  int i, j, a, ndof;
+  if (model_solution(running_model, "probe") == NULL)
+    return 1;
+  i = find_element(model_index(running_model), running_model->nodes,
+		   running_model->elements, running_model->et_defs, x, y, &N);
+  if (i == -1){
+    lprintf("Error: No plane element at (%g, %g)\n", x, y);
+    return 1;
+  }
+  ndof = sol->ndof;
+  u = malloc(ndof*running_model->nodes->nitems*sizeof(double));
+  construct_nodal_values(running_model, sol, u);
+  e = running_model->elements->array[i];
+  lprintf("Point (%g, %g) in element %d\n", x, y, i);
+  for (j=0; j<ndof; j++){
+    v = 0.0;
+    for (a=0; a<N->n; a++)
+      v += N->array[a]*u[ndof*e->IEN[a]+j];
+    lprintf("%c deflection: %g \n", j == 0 ? 'x' : 'y', v);
+  }
+  free_vector(N), free(u);
+  return 0;
+}
+
+
+/*
+ * format = VTK (VTK XML unstructured grid, appended raw binary)
+ *        | BIN (native binary, layout in results.h)
+ * background = 1 to write on a separate thread
+ */
+int write_model_results(struct model* running_model, char* format,
+			char* filename, int background){
+  struct result_set* rs;
+  int f;
+  if (strcmp(format, "VTK") == 0)
+    f = RES_VTK;
+  else if (strcmp(format, "BIN") == 0)
+    f = RES_BINARY;
+  else{
+    lprintf("Error: Invalid result format: %s\n", format);
+    return 1;
+  }
+  if (model_solution(running_model, "write") == NULL)
+    return 1;
+  // A background write reports its failure when it is waited for
+  rs = new_result_set(running_model);
+  if (rs == NULL)
+    return 1;
+  if (background){
+    start_result_writer(running_model->writer, rs, f, filename);
+    return 0;
+  }
+  f = write_result_set(rs, f, filename);
+  free_result_set(rs);
+  return f;
+}
+
+
+// Array functions
+
+int add_model_nodes(struct model* running_model, double* xy, int n,
+		    int copy){
+  // Appends the nodes (xy[2*i], xy[2*i+1]) and returns the id of the
+  // first, or -1
+  struct list* nodes = running_model->nodes;
+  int first = nodes->nitems, i;
+  if (n < 0){
+    lprintf("Error: Invalid node count: %d\n", n);
+    return -1;
+  }
+  lprintf("Creating %d nodes from %s\n", n,
+	  copy ? "a copy of an array" : "an array in place");
+  if (!copy)
+    append(running_model->views, new_node_view(nodes, xy, n));
+  else
+    for (i=0; i<n; i++)
+      append(nodes, new_node(xy[2*i], xy[2*i+1]));
+  return first;
+}
+
+
+int add_model_elements(struct model* running_model, int et_id, int* IEN,
+		       int n, int nenodes, int copy){
+  // Appends the elements whose nodes are the rows of the n x nenodes
+  // IEN and returns the id of the first, or -1.  With copy, quadratic
+  // elements may be given with their corner nodes only.
+  struct list* elements = running_model->elements;
+  struct et_def* et = get_et_def(running_model->et_defs, et_id);
+  int first = elements->nitems, nnodes = running_model->nodes->nitems;
+  int i, k, nc, *ien;
+  size_t j;
+  if (et == NULL){
+    lprintf("Error: Element type %d is not defined\n", et_id);
+    return -1;
+  }
+  nc = quadratic_element(et->lib_id) ? et->nenodes/2 : et->nenodes;
+  if (n < 0 || et->nenodes == 0 ||
+      (nenodes != et->nenodes && (!copy || nenodes != nc))){
+    lprintf("Error: Element type %d needs %d nodes, %d given\n",
+	    et_id, et->nenodes, nenodes);
+    return -1;
+  }
+  for (j=0; j<(size_t) n*nenodes; j++){
+    if (IEN[j] < 0 || IEN[j] >= nnodes){
+      lprintf("Error: Element %zu has invalid node %d\n", j/nenodes,
+	      IEN[j]);
+      return -1;
+    }
+  }
+  lprintf("Creating %d elements of type %d from %s\n", n, et_id,
+	  copy ? "a copy of an array" : "an array in place");
+  if (!copy){
+    append(running_model->views,
+	   new_element_view(elements, et_id, IEN, n, nenodes));
+    // Midside nodes shared with elements added later
+    for (i=0; i<n && nc < et->nenodes; i++, IEN += nenodes){
+      for (k=0; k<nc; k++)
+	set_edge_node(running_model->midnodes, IEN[k], IEN[(k+1)%nc],
+		      IEN[nc+k]);
+    }
+    return first;
+  }
+  for (i=0; i<n; i++, IEN += nenodes){
+    ien = malloc(nenodes*sizeof(int));
+    memcpy(ien, IEN, nenodes*sizeof(int));
+    if (nc < et->nenodes)
+      ien = midside_nodes(running_model, ien, nc, nenodes == et->nenodes);
+    append(elements, new_element(et_id, ien));
+  }
+  return first;
+}
+
+
+static int set_model_dof_values(struct model* running_model,
+				int essential, int* node_ids, int n,
+				char* comp, double* values){
+  // Constrains or loads one component of each node, replacing the value
+  // already on that dof as the single node functions do.  values NULL
+  // gives zero.
+  struct list* l = essential ? running_model->essential_bcs :
+    running_model->nodal_forces;
+  struct essential_bc* ebc;
+  struct nodal_force* ndf;
+  int nnodes = running_model->nodes->nitems;
+  int i, d, k, dof, all = essential && strcmp(comp, "ALL") == 0;
+  int* slot;
+  double value;
+  if (strcmp(comp, "X") == 0 || all)
+    dof = 0;
+  else if (strcmp(comp, "Y") == 0)
+    dof = 1;
+  else{
+    lprintf("Error: Invalid %s component: %s\n",
+	    essential ? "essential bc" : "force", comp);
+    return 1;
+  }
+  for (i=0; i<n; i++){
+    if (node_ids[i] < 0 || node_ids[i] >= nnodes){
+      lprintf("Error: Invalid node %d\n", node_ids[i]);
+      return 1;
+    }
+  }
+  slot = malloc(2*(nnodes > 0 ? nnodes : 1)*sizeof(int));
+  for (k=0; k<2*nnodes; k++)
+    slot[k] = -1;
+  for (i=0; i<l->nitems; i++){
+    if (essential)
+      ebc = l->array[i], slot[2*ebc->node_id + ebc->dof] = i;
+    else
+      ndf = l->array[i], slot[2*ndf->node_id + ndf->dof] = i;
+  }
+  for (i=0; i<n; i++){
+    value = values != NULL ? values[i] : 0.0;
+    for (d=dof; d<=(all ? 1 : dof); d++){
+      k = 2*node_ids[i] + d;
+      if (slot[k] == -1 && essential)
+	append(l, new_essential_bc(node_ids[i], d, value));
+      else if (slot[k] == -1)
+	append(l, new_nodal_force(node_ids[i], d, value));
+      else if (essential)
+	ebc = l->array[slot[k]], ebc->value = value;
+      else
+	ndf = l->array[slot[k]], ndf->value = value;
+      if (slot[k] == -1)
+	slot[k] = l->nitems-1;
+    }
+  }
+  free(slot);
+  return 0;
+}
+
+
+int add_model_essential_bcs(struct model* running_model, int* node_ids,
+			    int n, char* comp, double* values){
+  lprintf("Adding %d essential bcs on %s\n", n, comp);
+  return set_model_dof_values(running_model, 1, node_ids, n, comp, values);
+}
+
+
+int add_model_nodal_forces(struct model* running_model, int* node_ids,
+			   int n, char* comp, double* values){
+  lprintf("Adding %d nodal forces in %s\n", n, comp);
+  return set_model_dof_values(running_model, 0, node_ids, n, comp, values);
+}
+
+
+/*
+ * res_name = U (nodal solution)
+ *          | RF (reaction forces at the constrained dof)
+ * values receives the result of every node, node major, and needs room
+ * for 2 per node.  Returns the values per node, or -1.
+ */
+int get_model_result(struct model* running_model, char* res_name,
+		     double* values){
+  struct static_soln* sol = running_model->solution;
+  double* u;
+  int failed;
+  if (model_solution(running_model, "read") == NULL)
+    return -1;
+  if (strcmp(res_name, "U") == 0)
+    construct_nodal_values(running_model, sol, values);
+  else if (strcmp(res_name, "RF") == 0){
+    u = malloc(sol->ndof*running_model->nodes->nitems*sizeof(double));
+    construct_nodal_values(running_model, sol, u);
+    failed = construct_reactions(running_model, sol, u, values);
+    free(u);
+    if (failed)
+      return -1;
+  }
+  else{
+    lprintf("Error: Invalid result name: %s\n", res_name);
+    return -1;
+  }
+  return sol->ndof;
 }
 
 
 void free_model(struct model* running_model){
+  int i;
+  free_result_writer(running_model->writer);
+  for (i=running_model->views->nitems-1; i>=0; i--)
+    drop_mesh_view(running_model->views->array[i], running_model->nodes,
+		   running_model->elements);
+  free_list(running_model->views);
   free_mesh(running_model->nodes, running_model->elements);
   free_items(running_model->et_defs, free_et_def);
   free_list(running_model->et_defs);
@@ -188,7 +1321,22 @@ void free_model(struct model* running_model){
   free_list(running_model->essential_bcs);
   free_items(running_model->nodal_forces, free_nodal_force);
   free_list(running_model->nodal_forces);
+  free_items(running_model->masters, free);
+  free_list(running_model->masters);
+  free_items(running_model->superelements, free_superelement);
+  free_list(running_model->superelements);
+  free_edge_map(running_model->midnodes);
+  free_items(running_model->transitions, free);
+  free_list(running_model->transitions);
   if (running_model->solution != NULL)
     free_static_soln(running_model->solution);
+  if (running_model->param != NULL)
+    free_param_system(running_model->param);
+  if (running_model->index != NULL)
+    free_spatial_index(running_model->index);
+  free_items(running_model->node_sets, free_node_set);
+  free_list(running_model->node_sets);
+  if (running_model->order != NULL)
+    free_mesh_order(running_model->order);
   free(running_model);
 }
@@ -4,6 +4,8 @@ Interpreter can only talk to the model.  It cannot access any underlying
 FEM data structures (mesh, solver, etc.) directly. So all of these functions
 are redundant, but it provides better encapsulation.
 Only data the model holds are the global matrices and vectors K, F, and U
+Functions returning an int status log any error and return 1, leaving the
+model usable, or 0 on success.
 */
 
 struct model{
@@ -11,12 +13,26 @@ struct model{
   int ndof;
   int free_dof;
   int total_dof;
+  int nsub;
+  int bc_mode;                  // Essential bc enforcement, BC_* of solver.h
+  double bc_scale;              // Penalty over the largest pivot, 0 default
   struct list* nodes;
   struct list* elements;
   struct list* et_defs;
   struct list* essential_bcs;
   struct list* nodal_forces;
+  struct list* masters;
+  struct list* superelements;
+  struct edge_map* midnodes;
+  struct list* transitions;     // Adaptive refinement transition groups
+  struct list* views;           // Mesh ranges over caller arrays
   struct static_soln* solution;
+  struct param_system* param;   // Unit matrices for parametric solves
+  struct spatial_index* index;  // Node and element locations, or NULL
+  struct list* node_sets;       // Named node selections
+  int curve;                    // Equation order, CURVE_* of spatial.h
+  struct mesh_order* order;     // Curve order of the mesh, or NULL
+  struct result_writer* writer; // Background result output
 };
 
 
@@ -27,28 +43,80 @@ void free_model(struct model* running_model);
 
 // Mesh interface
 void new_model_node(struct model* running_model, double x, double y);
-void new_model_element(struct model* running_model, int et_id, int* IEN);
+int new_model_element(struct model* running_model, int et_id, int* IEN,
+		      int nnodes);
+int merge_model_nodes(struct model* running_model, double tol);
+int reorder_model_mesh(struct model* running_model, char* curve);
+int* model_node_order(struct model* running_model);
+int* model_element_order(struct model* running_model);
 void print_model_mesh(struct model* running_model);
 
 
+// Array interface, for programs linking libfea.  Nodes, elements and
+// bcs come in arrays, and results go out in arrays, with no script text.
+// Without copy the mesh points into the caller's xy and IEN, which must
+// stay valid and unchanged until the model is freed.  NUMMRG, ADAPT and
+// SEGEN copy them first.
+int add_model_nodes(struct model* running_model, double* xy, int n,
+		    int copy);
+int add_model_elements(struct model* running_model, int et_id, int* IEN,
+		       int n, int nenodes, int copy);
+int add_model_essential_bcs(struct model* running_model, int* node_ids,
+			    int n, char* comp, double* values);
+int add_model_nodal_forces(struct model* running_model, int* node_ids,
+			   int n, char* comp, double* values);
+int get_model_result(struct model* running_model, char* res_name,
+		     double* values);
+
+
 // Element type definition interface
-void new_model_element_type(struct model* running_model, int et_id,
-			    char* et_name);
-void set_model_et_real_constant(struct model* running_model, int et_id,
-				int real_constant, double value);
-void set_model_et_matprop(struct model* running_model, int et_id,
-			  char* name, double value);
-void set_model_et_keyopt(struct model* running_model, int et_id,
-			 int key, int option);
+int new_model_element_type(struct model* running_model, int et_id,
+			   char* et_name);
+int set_model_et_real_constant(struct model* running_model, int et_id,
+			       int real_constant, double value);
+int set_model_et_matprop(struct model* running_model, int et_id,
+			 char* name, double value);
+int set_model_et_keyopt(struct model* running_model, int et_id,
+			int key, int option);
 
 // Boundary condition definition interface
 void add_model_essential_bc(struct model* running_model,
 			    int node_id, char* comp, double value);
-void add_model_nodal_force(struct model* running_model,
-			   int node_id, char* comp, double value);
+int add_model_nodal_force(struct model* running_model,
+			  int node_id, char* comp, double value);
+void delete_model_essential_bc(struct model* running_model,
+			       int node_id, char* comp);
+int set_model_bc_mode(struct model* running_model, int mode,
+		      double scale);
+
+// Selection interface
+int select_model_nodes(struct model* running_model, char* name,
+		       char* how, int nargs, double* args);
+int* get_model_nodes(struct model* running_model, char* spec, int* n);
+
+// Superelement interface
+int add_model_master(struct model* running_model, int node_id);
+int generate_model_superelement(struct model* running_model, int se_id);
+int set_model_et_superelement(struct model* running_model, int et_id,
+			      int se_id);
+int expand_model_superelement(struct model* running_model, int elem_id);
 
 // Solver interface
-void solve_model(struct model* running_model, int p_type, int s_type);
+int set_model_subdomains(struct model* running_model, int nsub);
+int adapt_model(struct model* running_model, double target,
+		int max_cycles, int s_type);
+int solve_model(struct model* running_model, int p_type, int s_type);
+int solve_model_nonlinear(struct model* running_model, int nsteps,
+			  int mode, int max_iter, double tol);
+int resolve_model(struct model* running_model);
+int solve_model_parametric(struct model* running_model);
+
+// Checkpoint interface
+int save_model(struct model* running_model, char* filename);
+int resume_model(struct model* running_model, char* filename);
 
 // Postprocessing interface
-void print_model_result(struct model* running_model, char* res_name);
+int print_model_result(struct model* running_model, char* res_name);
+int probe_model_result(struct model* running_model, double x, double y);
+int write_model_results(struct model* running_model, char* format,
+			char* filename, int background);
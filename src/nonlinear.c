@@ -0,0 +1,562 @@
+/*
+Load stepped nonlinear static solver.
+
+The load factor is raised to 1 in nsteps equal steps; nodal forces and
+prescribed displacements are both scaled by it.  Within a step the
+residual
+     R(u) = lambda*F - Fint(u)
+is driven to zero over the free equations by Newton iterations
+     KT*du = R,   u = u + du
+where KT is the consistent tangent.  Convergence is declared when |R|
+drops below tol times the size of the applied loads and reactions.
+
+Factoring KT is the dominant cost, so besides full Newton two modes
+keep one factorization for a whole step: modified Newton, which only
+refactors when the residual stops decreasing, and BFGS, which corrects
+the step's factorization with the rank two updates of the secant pairs
+(s, y) = (du, change in Fint) collected so far.
+
+Material history (plastic strains and hardening variables) is kept per
+element and integration point.  Every iteration evaluates trial values
+from the last converged state, and the trial values are committed once
+the step converges.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "lib/log.h"
+#include "lib/list.h"
+#include "lib/linalg.h"
+#include "model.h"
+#include "mesh.h"
+#include "element_types.h"
+#include "bc_data.h"
+#include "stiffness.h"
+#include "solver.h"
+#include "shape.h"
+#include "superelement.h"
+#include "nonlinear.h"
+
+
+#define NL_HIST 5         // History values per plane integration point
+#define NL_STALL 0.5      // Minimum residual reduction before refactoring
+
+
+/***********************************************
+ * Material models
+ */
+
+
+static double bar_return(struct matprops* m, double strain,
+			 double* old, double* new, double* Et){
+  // 1D return mapping with linear isotropic hardening.  History is
+  // {plastic strain, equivalent plastic strain}.  Returns the stress.
+  double S = m->E*(strain - old[0]), f, dg, sign = S < 0.0 ? -1.0 : 1.0;
+  new[0] = old[0], new[1] = old[1];
+  *Et = m->E;
+  if (m->SY <= 0.0)
+    return S;
+  f = fabs(S) - (m->SY + m->H*old[1]);
+  if (f <= 0.0)
+    return S;
+  dg = f/(m->E + m->H);
+  new[0] += sign*dg;
+  new[1] += dg;
+  *Et = m->E*m->H/(m->E + m->H);
+  return S - sign*m->E*dg;
+}
+
+
+static void J2_return(struct matprops* m, double eps[3], double* old,
+		      double* new, double sig[3], double D[3][3]){
+  // Plane strain radial return (Simo and Hughes, Box 3.2).  History is
+  // the plastic strain tensor {xx, yy, zz, xy} and the equivalent
+  // plastic strain.  eps holds {xx, yy, engineering xy}.  Returns the
+  // stresses {xx, yy, xy} and the consistent tangent D.
+  double mu = 0.5*m->E/(1.0+m->v), kappa = m->E/(3.0*(1.0-2.0*m->v));
+  double ee[4], s[4], n[4] = {0.0}, tr, snorm, f, dg, p;
+  double theta = 1.0, thetab = 0.0;
+  int i, j;
+  ee[0] = eps[0] - old[0];
+  ee[1] = eps[1] - old[1];
+  ee[2] = -old[2];
+  ee[3] = 0.5*eps[2] - old[3];
+  tr = ee[0] + ee[1] + ee[2];
+  for (i=0; i<4; i++)
+    s[i] = 2.0*mu*(ee[i] - (i < 3 ? tr/3.0 : 0.0));
+  snorm = sqrt(s[0]*s[0] + s[1]*s[1] + s[2]*s[2] + 2.0*s[3]*s[3]);
+  f = snorm - sqrt(2.0/3.0)*(m->SY + m->H*old[4]);
+  memcpy(new, old, NL_HIST*sizeof(double));
+  if (f > 0.0){
+    dg = f/(2.0*mu + 2.0*m->H/3.0);
+    for (i=0; i<4; i++){
+      n[i] = s[i]/snorm;
+      s[i] -= 2.0*mu*dg*n[i];
+      new[i] += dg*n[i];
+    }
+    new[4] += sqrt(2.0/3.0)*dg;
+    theta = 1.0 - 2.0*mu*dg/snorm;
+    thetab = 1.0/(1.0 + m->H/(3.0*mu)) - (1.0 - theta);
+  }
+  p = kappa*tr;
+  sig[0] = s[0] + p, sig[1] = s[1] + p, sig[2] = s[3];
+  // Engineering shear strain picks up the 1/2 of the symmetric identity
+  for (i=0; i<2; i++){
+    for (j=0; j<2; j++)
+      D[i][j] = kappa + 2.0*mu*theta*((i == j) - 1.0/3.0) -
+	2.0*mu*thetab*n[i]*n[j];
+    D[i][2] = D[2][i] = -2.0*mu*thetab*n[i]*n[3];
+  }
+  D[2][2] = mu*theta - 2.0*mu*thetab*n[3]*n[3];
+}
+
+
+/***********************************************
+ * Element internal forces and tangents
+ */
+
+
+static int history_size(struct et_def* et){
+  if (et->lib_id == 1)
+    return 2;
+  else if (et->lib_id == 3 || et->lib_id == 4 || et->lib_id == 6 ||
+	   et->lib_id == 8)
+    return NL_HIST*et->sdata->nint_pts;
+  return 0;
+}
+
+
+static void Bar_response(struct et_def* et, struct matrix* COORDS,
+			 double* UE, double* old, double* new,
+			 double* FE, struct matrix* KE){
+  // Total Lagrangian truss with Green-Lagrange strain
+  //     strain = (|d|^2 - L0^2)/(2*L0^2),  d = X2 + u2 - X1 - u1
+  // Fint = A*S/L0*{-d, d} and KT = A/L0*(Et/L0^2*d*d^T + S*I) in blocks
+  double** X = COORDS->array;
+  double A = et->consts[1], d[2], L0sq, S, Et, k;
+  int i, j;
+  d[0] = X[0][1] - X[0][0], d[1] = X[1][1] - X[1][0];
+  L0sq = d[0]*d[0] + d[1]*d[1];
+  d[0] += UE[2] - UE[0], d[1] += UE[3] - UE[1];
+  S = bar_return(et->mprops, 0.5*(d[0]*d[0] + d[1]*d[1] - L0sq)/L0sq,
+		 old, new, &Et);
+  for (i=0; i<2; i++){
+    FE[i] = -A*S/sqrt(L0sq)*d[i];
+    FE[2+i] = -FE[i];
+  }
+  if (KE == NULL)
+    return;
+  for (i=0; i<2; i++){
+    for (j=0; j<2; j++){
+      k = A/sqrt(L0sq)*(Et/L0sq*d[i]*d[j] + (i == j ? S : 0.0));
+      KE->array[i][j] = KE->array[2+i][2+j] = k;
+      KE->array[i][2+j] = KE->array[2+i][j] = -k;
+    }
+  }
+}
+
+
+static void Plane_response(struct et_def* et, struct matrix* COORDS,
+			   double* UE, double* old, double* new,
+			   double* FE, struct matrix* KE){
+  // Small strain plane element.  Plasticity (SY > 0) is plane strain
+  // only; elastic types use the linear D of either formulation.
+  struct list* NDERGLBs = construct_NDERGLBs(COORDS, et->sdata->NDERNATs,
+					     et->sdata->nint_pts);
+  double** N;
+  double** De = et->sdata->D->array;
+  double eps[3], sig[3], D[3][3], w, r0[3], r1[3];
+  int n = et->nenodes, a, b, i, j, k;
+  memset(FE, 0, 2*n*sizeof(double));
+  for (k=0; k<et->sdata->nint_pts; k++){
+    N = ((struct matrix*) NDERGLBs->array[k])->array;
+    w = et->sdata->int_wts[k]*et->consts[1]*
+      jacobian(COORDS, et->sdata->NDERNATs->array[k]);
+    eps[0] = eps[1] = eps[2] = 0.0;
+    for (a=0; a<n; a++){
+      eps[0] += N[a][0]*UE[2*a];
+      eps[1] += N[a][1]*UE[2*a+1];
+      eps[2] += N[a][1]*UE[2*a] + N[a][0]*UE[2*a+1];
+    }
+    if (et->mprops->SY > 0.0)
+      J2_return(et->mprops, eps, &old[NL_HIST*k], &new[NL_HIST*k], sig, D);
+    else{
+      for (i=0; i<3; i++){
+	sig[i] = 0.0;
+	for (j=0; j<3; j++){
+	  D[i][j] = De[i][j];
+	  sig[i] += D[i][j]*eps[j];
+	}
+      }
+    }
+    for (a=0; a<n; a++){
+      FE[2*a] += w*(N[a][0]*sig[0] + N[a][1]*sig[2]);
+      FE[2*a+1] += w*(N[a][1]*sig[1] + N[a][0]*sig[2]);
+    }
+    if (KE == NULL)
+      continue;
+    // B^T*D*B with Bi_structural rows {Na,x 0}, {0 Na,y}, {Na,y Na,x}
+    for (a=0; a<n; a++){
+      for (i=0; i<3; i++){
+	r0[i] = w*(N[a][0]*D[0][i] + N[a][1]*D[2][i]);
+	r1[i] = w*(N[a][1]*D[1][i] + N[a][0]*D[2][i]);
+      }
+      for (b=0; b<n; b++){
+	KE->array[2*a][2*b] += r0[0]*N[b][0] + r0[2]*N[b][1];
+	KE->array[2*a][2*b+1] += r0[1]*N[b][1] + r0[2]*N[b][0];
+	KE->array[2*a+1][2*b] += r1[0]*N[b][0] + r1[2]*N[b][1];
+	KE->array[2*a+1][2*b+1] += r1[1]*N[b][1] + r1[2]*N[b][0];
+      }
+    }
+  }
+  for (k=0; k<et->sdata->nint_pts; k++)
+    free_matrix(NDERGLBs->array[k]);
+  free_list(NDERGLBs);
+}
+
+
+static void Linear_response(struct et_def* et, struct matrix* COORDS,
+			    double* UE, double* FE, struct matrix* KE){
+  // Fint = KE*u for the element types without nonlinear behaviour
+  struct matrix* KL = select_KE_kernel(et)(et, COORDS);
+  int i, j, n = KL->nrows;
+  for (i=0; i<n; i++){
+    FE[i] = 0.0;
+    for (j=0; j<n; j++){
+      FE[i] += KL->array[i][j]*UE[j];
+      if (KE != NULL)
+	KE->array[i][j] = KL->array[i][j];
+    }
+  }
+  free_matrix(KL);
+}
+
+
+static void element_response(struct et_def* et, struct matrix* COORDS,
+			     double* UE, double* old, double* new,
+			     double* FE, struct matrix* KE){
+  if (et->lib_id == 1)
+    Bar_response(et, COORDS, UE, old, new, FE, KE);
+  else if (history_size(et) > 0)
+    Plane_response(et, COORDS, UE, old, new, FE, KE);
+  else
+    Linear_response(et, COORDS, UE, FE, KE);
+}
+
+
+static int plane_strain_plasticity(struct model* running_model){
+  // Returns 0 if a plastic plane element is not in plane strain
+  struct element* e;
+  struct et_def* et;
+  int i;
+  for (i=0; i<running_model->elements->nitems; i++){
+    e = running_model->elements->array[i];
+    et = get_et_def(running_model->et_defs, e->et_id);
+    if ((et->lib_id == 3 || et->lib_id == 4 || et->lib_id == 6 ||
+	 et->lib_id == 8) && et->mprops->SY > 0.0 && et->opts[1] != 1){
+      lprintf("Error: Plasticity needs plane strain (KEYOPT %d, 1, 1)\n",
+	      et->user_id);
+      return 0;
+    }
+  }
+  return 1;
+}
+
+
+/***********************************************
+ * Global system
+ */
+
+
+struct nl_state{
+  struct model* model;
+  struct matrix* ID;
+  double lambda;      // Load factor
+  double* u;          // All dof, node major
+  double* fint;       // Internal forces on all dof
+  double** hist;      // Converged history of each element
+  double** trial;     // History at the current iterate
+};
+
+
+static void assemble_internal(struct nl_state* s, struct matrix* K){
+  // Internal forces at the current u, and the tangent when K is given
+  struct list* nodes = s->model->nodes;
+  struct list* elements = s->model->elements;
+  struct element* e;
+  struct et_def* et;
+  struct matrix *COORDS, *KE = NULL;
+  struct vector* FS;
+  double *UE, *FE;
+  int* order = model_element_order(s->model);
+  int ndof = s->model->ndof, i, k, a, b, j, l, n, P, Q;
+  memset(s->fint, 0, s->model->total_dof*sizeof(double));
+  if (K != NULL){
+    for (i=0; i<K->nrows; i++)
+      memset(K->array[i], 0, K->ncols*sizeof(double));
+  }
+  for (k=0; k<elements->nitems; k++){
+    i = order != NULL ? order[k] : k;
+    e = elements->array[i];
+    et = get_et_def(s->model->et_defs, e->et_id);
+    n = et->nenodes*ndof;
+    UE = malloc(n*sizeof(double)), FE = malloc(n*sizeof(double));
+    for (a=0; a<et->nenodes; a++){
+      for (j=0; j<ndof; j++)
+	UE[ndof*a+j] = s->u[ndof*e->IEN[a]+j];
+    }
+    COORDS = construct_COORDS(nodes, e->IEN, et->nenodes);
+    if (K != NULL)
+      KE = new_matrix(n, n);
+    element_response(et, COORDS, UE, s->hist[i], s->trial[i], FE, KE);
+    if (et->sedata != NULL){
+      // Condensed interior loads of superelements scale with the load
+      FS = Superelement_FE(et->sedata, COORDS);
+      for (j=0; j<n; j++)
+	FE[j] -= s->lambda*FS->array[j];
+      free_vector(FS);
+    }
+    for (a=0; a<et->nenodes; a++){
+      for (j=0; j<ndof; j++)
+	s->fint[ndof*e->IEN[a]+j] += FE[ndof*a+j];
+    }
+    if (K != NULL){
+      for (a=0; a<et->nenodes; a++){
+	for (j=0; j<ndof; j++){
+	  P = s->ID->array[e->IEN[a]][j];
+	  if (P == -1)
+	    continue;
+	  for (b=0; b<et->nenodes; b++){
+	    for (l=0; l<ndof; l++){
+	      Q = s->ID->array[e->IEN[b]][l];
+	      if (Q != -1)
+		K->array[P][Q] += KE->array[ndof*a+j][ndof*b+l];
+	    }
+	  }
+	}
+      }
+      free_matrix(KE);
+    }
+    free_matrix(COORDS), free(UE), free(FE);
+  }
+}
+
+
+static double residual(struct nl_state* s, struct vector* F, double lambda,
+		       struct vector* R, double* ref){
+  // R = lambda*F - Fint over the free dof.  ref receives the size of
+  // the applied loads and reactions.  Returns |R|.
+  int i, j, P, ndof = s->model->ndof;
+  double rnorm = 0.0, fnorm = 0.0, g;
+  for (i=0; i<s->model->nodes->nitems; i++){
+    for (j=0; j<ndof; j++){
+      P = s->ID->array[i][j];
+      g = s->fint[ndof*i+j];
+      if (P == -1){
+	fnorm += g*g;
+	continue;
+      }
+      R->array[P] = lambda*F->array[P] - g;
+      rnorm += R->array[P]*R->array[P];
+      fnorm += lambda*lambda*F->array[P]*F->array[P];
+    }
+  }
+  *ref = sqrt(fnorm);
+  return sqrt(rnorm);
+}
+
+
+static void bfgs_direction(struct matrix* LU, struct vector* R,
+			   struct vector** S, struct vector** Y, double* rho,
+			   int npairs, double* alpha, struct vector* du){
+  // du = H*R by the two loop recursion, with H0 = inv(KT) from the
+  // step's factorization and the inverse BFGS updates of each pair
+  int i, k, n = R->n;
+  double beta;
+  for (k=0; k<n; k++)
+    du->array[k] = R->array[k];
+  for (i=npairs-1; i>=0; i--){
+    alpha[i] = 0.0;
+    for (k=0; k<n; k++)
+      alpha[i] += S[i]->array[k]*du->array[k];
+    alpha[i] *= rho[i];
+    for (k=0; k<n; k++)
+      du->array[k] -= alpha[i]*Y[i]->array[k];
+  }
+  luLSS(LU, du);
+  for (i=0; i<npairs; i++){
+    beta = 0.0;
+    for (k=0; k<n; k++)
+      beta += Y[i]->array[k]*du->array[k];
+    beta *= rho[i];
+    for (k=0; k<n; k++)
+      du->array[k] += (alpha[i] - beta)*S[i]->array[k];
+  }
+}
+
+
+struct static_soln* nonlinear_static_solver(struct model* running_model,
+					    int nsteps, int mode,
+					    int max_iter, double tol){
+  int nnodes = running_model->nodes->nitems, ndof = running_model->ndof;
+  int nfree = running_model->free_dof, nelems = running_model->elements->nitems;
+  struct matrix* ID = new_matrix(nnodes, ndof);
+  struct matrix* K = new_matrix(nfree, nfree);
+  struct vector *F = new_vector(nfree), *R = new_vector(nfree);
+  struct vector *Rold = new_vector(nfree), *du = new_vector(nfree);
+  struct vector *U, **S, **Y;
+  struct element* e;
+  struct nl_state s;
+  double lambda, rnorm, rnorm_old, ref, sy, *rho, *alpha, *tmp;
+  int step, iter, i, j, k, P, npairs, nfactor, total_iter = 0;
+  int total_factor = 0, factored, converged = 1;
+  if (mode < NL_FULL || mode > NL_BFGS)
+    lprintf("Error: Invalid nonlinear solution mode: %d\n", mode);
+  if (mode < NL_FULL || mode > NL_BFGS ||
+      !plane_strain_plasticity(running_model)){
+    free_matrix(ID), free_matrix(K);
+    free_vector(F), free_vector(R), free_vector(Rold), free_vector(du);
+    return NULL;
+  }
+  precomputations(running_model->et_defs);
+  construct_ID(running_model->nodes, ndof, running_model->essential_bcs,
+	       model_node_order(running_model), ID);
+  construct_F(running_model->nodes, running_model->nodal_forces, ID, F, ndof);
+  s.model = running_model;
+  s.ID = ID;
+  s.u = calloc(running_model->total_dof, sizeof(double));
+  s.fint = malloc(running_model->total_dof*sizeof(double));
+  s.hist = malloc(nelems*sizeof(double*));
+  s.trial = malloc(nelems*sizeof(double*));
+  for (i=0; i<nelems; i++){
+    e = running_model->elements->array[i];
+    k = history_size(get_et_def(running_model->et_defs, e->et_id));
+    s.hist[i] = calloc(k > 0 ? k : 1, sizeof(double));
+    s.trial[i] = calloc(k > 0 ? k : 1, sizeof(double));
+  }
+  S = malloc(max_iter*sizeof(struct vector*));
+  Y = malloc(max_iter*sizeof(struct vector*));
+  rho = malloc(max_iter*sizeof(double));
+  alpha = malloc(max_iter*sizeof(double));
+  for (step=1; step<=nsteps; step++){
+    s.lambda = lambda = (double) step/nsteps;
+    lprintf("Load step %d of %d, load factor %g\n", step, nsteps, lambda);
+    for (i=0; i<nnodes; i++){
+      for (j=0; j<ndof; j++){
+	if (ID->array[i][j] == -1)
+	  s.u[ndof*i+j] = lambda*get_essential_bc(running_model->essential_bcs,
+						  i, j);
+      }
+    }
+    npairs = nfactor = factored = 0;
+    rnorm_old = HUGE_VAL;
+    for (iter=0; ; iter++){
+      // Modified Newton and BFGS only build the tangent at the start of
+      // a step, or when modified Newton stalls
+      if (mode == NL_FULL || iter == 0 ||
+	  (mode == NL_MODIFIED && factored == 0)){
+	assemble_internal(&s, K);
+	factored = -1;
+      }
+      else
+	assemble_internal(&s, NULL);
+      rnorm = residual(&s, F, lambda, R, &ref);
+      lprintf("Iteration %d: residual norm %g\n", iter, rnorm);
+      converged = rnorm <= tol*ref || ref == 0.0;
+      if (converged)
+	break;
+      if (iter == max_iter){
+	lprintf("Error: Load step %d did not converge in %d iterations\n",
+	       step, max_iter);
+	break;
+      }
+      if (factored == -1){
+	// Fresh tangent, factored only if another iteration is needed
+	if (luMFA(K) != 0){
+	  lprintf("Error: Zero pivot in the tangent of load step %d\n",
+		  step);
+	  converged = 0;
+	  break;
+	}
+	nfactor++, factored = 1;
+      }
+      else if (mode == NL_MODIFIED && rnorm > NL_STALL*rnorm_old &&
+	  factored == 2){
+	// Refactor at the current iterate and recompute the residual
+	lprintf("Residual stalled, refactoring the tangent\n");
+	factored = 0;
+	iter--;
+	continue;
+      }
+      if (mode == NL_BFGS && iter > 0){
+	// Secant pair from the last update, y = Fint change = Rold - R
+	Y[npairs] = new_vector(nfree);
+	for (k=0, sy=0.0; k<nfree; k++){
+	  Y[npairs]->array[k] = Rold->array[k] - R->array[k];
+	  sy += Y[npairs]->array[k]*du->array[k];
+	}
+	if (sy > 0.0){
+	  S[npairs] = copy_vector(du);
+	  rho[npairs++] = 1.0/sy;
+	}
+	else
+	  free_vector(Y[npairs]);
+      }
+      if (mode == NL_BFGS)
+	bfgs_direction(K, R, S, Y, rho, npairs, alpha, du);
+      else{
+	memcpy(du->array, R->array, nfree*sizeof(double));
+	luLSS(K, du);
+      }
+      if (factored == 1 && mode == NL_MODIFIED)
+	factored = 2;
+      for (i=0; i<nnodes; i++){
+	for (j=0; j<ndof; j++){
+	  P = ID->array[i][j];
+	  if (P != -1)
+	    s.u[ndof*i+j] += du->array[P];
+	}
+      }
+      tmp = Rold->array, Rold->array = R->array, R->array = tmp;
+      rnorm_old = rnorm;
+    }
+    for (k=0; k<npairs; k++)
+      free_vector(S[k]), free_vector(Y[k]);
+    total_iter += iter, total_factor += nfactor;
+    if (!converged)
+      break;
+    lprintf("Step %d converged in %d iterations with %d factorizations\n",
+	   step, iter, nfactor);
+    // Commit the history of the converged state
+    for (i=0; i<nelems; i++){
+      tmp = s.hist[i], s.hist[i] = s.trial[i], s.trial[i] = tmp;
+    }
+  }
+  lprintf("Nonlinear solution: %d iterations, %d factorizations\n",
+	 total_iter, total_factor);
+  U = NULL;
+  if (converged){
+    U = new_vector(nfree);
+    for (i=0; i<nnodes; i++){
+      for (j=0; j<ndof; j++){
+	P = ID->array[i][j];
+	if (P != -1)
+	  U->array[P] = s.u[ndof*i+j];
+      }
+    }
+    lprintf("Solution vector:\n"), print_vector(U);
+  }
+  for (i=0; i<nelems; i++)
+    free(s.hist[i]), free(s.trial[i]);
+  free(s.hist), free(s.trial), free(s.u), free(s.fint);
+  free(S), free(Y), free(rho), free(alpha);
+  free_matrix(K);
+  free_vector(F), free_vector(R), free_vector(Rold), free_vector(du);
+  if (U == NULL){
+    free_matrix(ID);
+    return NULL;
+  }
+  return new_static_soln(ndof, ID, U);
+}
@@ -0,0 +1,15 @@
+/*
+Nonlinear static analysis by load stepping with Newton-Raphson
+equilibrium iterations.  Bars (SBAR) are large deflection trusses and
+plane elements are small strain J2 plasticity in plane strain, both with
+linear isotropic hardening.  The other element types stay linear.
+*/
+
+// Tangent update modes
+#define NL_FULL 0       // New tangent and factorization every iteration
+#define NL_MODIFIED 1   // One factorization per step, refreshed on stalls
+#define NL_BFGS 2       // One factorization per step with BFGS updates
+
+struct static_soln* nonlinear_static_solver(struct model* running_model,
+					    int nsteps, int mode,
+					    int max_iter, double tol);
@@ -0,0 +1,194 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib/log.h"
+#include "lib/list.h"
+#include "lib/linalg.h"
+#include "lib/sparse_linalg.h"
+#include "model.h"
+#include "mesh.h"
+#include "element_types.h"
+#include "bc_data.h"
+#include "solver.h"
+#include "parametric.h"
+
+
+static double* modulus(struct et_def* et){
+  return et->lib_id < 10 ? &et->mprops->E : &et->mprops->K;
+}
+
+
+static double param_scale(struct et_def* et){
+  return *modulus(et)*et->consts[1];
+}
+
+
+static void assemble_unit(struct model* running_model, struct et_def* et,
+			  struct param_system* ps, int t){
+  // Unit stiffness and prescribed value loads of the elements of type et,
+  // with the modulus and real constant 1 set to one
+  struct list* elements = new_list();
+  struct element* e;
+  struct aol_matrix* Ks = new_aol_matrix(ps->K->n, ps->K->n);
+  struct vector* F = new_vector(ps->K->n);
+  struct csr_matrix* K;
+  double E = *modulus(et), c = et->consts[1];
+  int* order = model_element_order(running_model);
+  int i;
+  for (i=0; i<running_model->elements->nitems; i++){
+    e = running_model->elements->array[order != NULL ? order[i] : i];
+    if (e->et_id == et->user_id)
+      append(elements, e);
+  }
+  *modulus(et) = 1.0, et->consts[1] = 1.0;
+  precomputations(running_model->et_defs);
+  construct_sparse_K(running_model->nodes, elements, running_model->et_defs,
+		     ps->ID, Ks, F, running_model->essential_bcs);
+  *modulus(et) = E, et->consts[1] = c;
+  K = aol_to_csr(Ks);
+  ps->units[t] = calloc(ps->K->size > 0 ? ps->K->size : 1, sizeof(double));
+  skyline_scatter(ps->K, K, ps->units[t]);
+  ps->loads[t] = F->array;
+  free(F);
+  free_csr_matrix(K), free_aol_matrix(Ks);
+  free_list(elements);
+}
+
+
+struct param_system* new_param_system(struct model* running_model){
+  // Returns NULL for models with superelements, whose condensed
+  // stiffness and loads are not linear in the parameters
+  struct list* et_defs = running_model->et_defs;
+  struct list* ebcs = running_model->essential_bcs;
+  struct param_system* ps;
+  struct et_def* et;
+  struct param_term* term;
+  int* first;
+  int t, i;
+  for (t=0; t<et_defs->nitems; t++){
+    et = et_defs->array[t];
+    if (et->sedata != NULL || et->lib_id == 9 || et->lib_id == 19){
+      lprintf("Error: Superelement models cannot be solved parametrically\n");
+      return NULL;
+    }
+  }
+  ps = malloc(sizeof(struct param_system));
+  ps->nnodes = running_model->nodes->nitems;
+  ps->nelems = running_model->elements->nitems;
+  ps->nterms = et_defs->nitems;
+  ps->terms = malloc(ps->nterms*sizeof(struct param_term));
+  ps->bc_mode = running_model->bc_mode;
+  ps->nebcs = ebcs->nitems;
+  ps->g = malloc((ps->nebcs > 0 ? ps->nebcs : 1)*sizeof(double));
+  for (i=0; i<ps->nebcs; i++)
+    ps->g[i] = ((struct essential_bc*) ebcs->array[i])->value;
+  ps->ID = new_matrix(ps->nnodes, running_model->ndof);
+  construct_ID(running_model->nodes, running_model->ndof,
+	       ps->bc_mode == BC_ELIMINATE ? ebcs : NULL,
+	       model_node_order(running_model), ps->ID);
+  first = construct_profile(running_model->elements, et_defs, ps->ID,
+			    running_model->free_dof);
+  ps->K = new_skyline_matrix(running_model->free_dof, first);
+  free(first);
+  ps->units = malloc(ps->nterms*sizeof(double*));
+  ps->loads = malloc(ps->nterms*sizeof(double*));
+  for (t=0; t<ps->nterms; t++){
+    et = et_defs->array[t];
+    term = &ps->terms[t];
+    term->user_id = et->user_id;
+    term->v = et->mprops->v;
+    memcpy(term->opts, et->opts, sizeof(term->opts));
+    memcpy(term->consts, et->consts, sizeof(term->consts));
+    assemble_unit(running_model, et, ps, t);
+  }
+  lprintf("Unit matrices of %d element types on a profile of %ld entries\n",
+	  ps->nterms, ps->K->size);
+  return ps;
+}
+
+
+int param_system_current(struct param_system* ps,
+			 struct model* running_model){
+  // Whether the model differs from ps in the parameters alone
+  struct list* et_defs = running_model->et_defs;
+  struct list* ebcs = running_model->essential_bcs;
+  struct essential_bc* ebc;
+  struct param_term* term;
+  struct et_def* et;
+  int t, i;
+  if (running_model->nodes->nitems != ps->nnodes ||
+      running_model->elements->nitems != ps->nelems ||
+      et_defs->nitems != ps->nterms ||
+      running_model->bc_mode != ps->bc_mode)
+    return 0;
+  if (ps->bc_mode == BC_ELIMINATE){
+    // Otherwise the constraints are applied at each solve
+    if (ebcs->nitems != ps->nebcs)
+      return 0;
+    for (i=0; i<ps->nebcs; i++){
+      ebc = ebcs->array[i];
+      if (ebc->value != ps->g[i] ||
+	  ps->ID->array[ebc->node_id][ebc->dof] != -1)
+	return 0;
+    }
+  }
+  for (t=0; t<ps->nterms; t++){
+    et = et_defs->array[t];
+    term = &ps->terms[t];
+    if (et->user_id != term->user_id || et->mprops->v != term->v ||
+	memcmp(et->opts, term->opts, sizeof(term->opts)) != 0)
+      return 0;
+    for (i=0; i<10; i++){
+      if (i != 1 && et->consts[i] != term->consts[i])
+	return 0;
+    }
+  }
+  return 1;
+}
+
+
+struct vector* param_solve(struct param_system* ps,
+			   struct model* running_model, struct vector* Rc){
+  // Recombines and refactors on the fixed profile.  Returns the free
+  // dof solution, or NULL on a zero pivot.  Rc is as for skyline_solve.
+  struct skyline_matrix* K = ps->K;
+  struct vector* F = new_vector(K->n);
+  struct et_def* et;
+  double s;
+  long k;
+  int t, i;
+  precomputations(running_model->et_defs);  // For post-processing
+  memset(K->vals, 0, K->size*sizeof(double));
+  for (t=0; t<ps->nterms; t++){
+    et = running_model->et_defs->array[t];
+    s = param_scale(et);
+    lprintf("Element type %d scaled by %g\n", et->user_id, s);
+    for (k=0; k<K->size; k++)
+      K->vals[k] += s*ps->units[t][k];
+    for (i=0; i<K->n; i++)
+      F->array[i] += s*ps->loads[t][i];
+  }
+  construct_F(running_model->nodes, running_model->nodal_forces,
+	      ps->ID, F, running_model->ndof);
+  lprintf("Force vector:\n"), print_vector(F);
+  if (skyline_solve(K, F, ps->ID, running_model->essential_bcs,
+		    ps->bc_mode, running_model->bc_scale, Rc) != 0){
+    lprintf("Error: Zero pivot in the sparse factorization\n");
+    free_vector(F);
+    return NULL;
+  }
+  lprintf("Solution vector:\n"), print_vector(F);
+  return F;
+}
+
+
+void free_param_system(struct param_system* ps){
+  int t;
+  for (t=0; t<ps->nterms; t++)
+    free(ps->units[t]), free(ps->loads[t]);
+  free(ps->units), free(ps->loads);
+  free(ps->terms), free(ps->g);
+  free_matrix(ps->ID);
+  free_skyline_matrix(ps->K);
+  free(ps);
+}
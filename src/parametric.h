@@ -0,0 +1,44 @@
+/*
+Parametric re-solve for material and thickness sweeps.  The stiffness
+of each element type is linear in its modulus (E, or K for thermal
+types) times real constant 1 (thickness, or bar area) while Poisson's
+ratio and the key options stay fixed:
+    K = sum over types t of E_t*c_t*K_t
+The unit matrices K_t, and the loads of the prescribed values, are
+assembled once on the skyline profile of the mesh.  A solve after MP
+E/K or R 1 changes only recombines them and refactors numerically on
+the same profile.  Any other change to the mesh, constraints or types
+needs a new system, except that under the penalty and augmented
+Lagrange bc modes the constraints are applied at each solve and may
+change freely.
+*/
+
+struct param_term{
+  int user_id;
+  double v;
+  int opts[10];
+  double consts[10];   // consts[1] is a parameter, and not compared
+};
+
+
+struct param_system{
+  int nnodes;
+  int nelems;
+  int nterms;
+  struct param_term* terms;
+  int bc_mode;
+  int nebcs;
+  double* g;                  // Prescribed values of the unit loads
+  struct matrix* ID;
+  struct skyline_matrix* K;   // Profile, with the last factors
+  double** units;             // Unit stiffness of each type on the profile
+  double** loads;             // Unit loads of each type, prescribed values
+};
+
+
+struct param_system* new_param_system(struct model* running_model);
+int param_system_current(struct param_system* ps,
+			 struct model* running_model);
+struct vector* param_solve(struct param_system* ps,
+			   struct model* running_model, struct vector* Rc);
+void free_param_system(struct param_system* ps);
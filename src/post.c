@@ -1,21 +1,52 @@
 #include <stdio.h>
 #include "lib/list.h"
 #include "lib/linalg.h"
+#include "lib/outbuf.h"
+#include "lib/log.h"
 #include "mesh.h"
 #include "model.h"
 #include "solver.h"
 
 
 void print_nodal_soln(struct list* nodes, struct static_soln* sol){
+  // Lines are formatted into one large buffer and written in chunks
+  struct outbuf* ob;
   int i, j, P, c;
+  ob = new_outbuf(log_stream());
   for (i=0; i<nodes->nitems; i++){
     for (j=0; j<sol->ndof; j++){
       c = j == 0 ? 'x' : 'y';
       P = sol->ID->array[i][j];
       if (P != -1)
-	printf("Node %d: %c deflection: %g \n", i, c, sol->U->array[P]);
+	outbuf_printf(ob, "Node %d: %c deflection: %g \n", i, c,
+		      sol->U->array[P]);
       else
-        printf("Node %d: %c dof was constrained\n", i, c);
+        outbuf_printf(ob, "Node %d: %c dof was constrained\n", i, c);
     }
   }
+  free_outbuf(ob);
+}
+
+
+void print_reactions(struct list* nodes, struct static_soln* sol,
+		     double* R){
+  // R holds the reactions node major, printed at the constrained dof
+  struct outbuf* ob;
+  double total[2] = {0.0, 0.0};
+  int i, j, c, ndof = sol->ndof;
+  ob = new_outbuf(log_stream());
+  for (i=0; i<nodes->nitems; i++){
+    for (j=0; j<ndof; j++){
+      c = j == 0 ? 'x' : 'y';
+      if (constrained_dof(sol, i, j)){
+	outbuf_printf(ob, "Node %d: %c reaction: %g \n", i, c, R[ndof*i+j]);
+	total[j] += R[ndof*i+j];
+      }
+    }
+  }
+  outbuf_printf(ob, "Total reaction: %g", total[0]);
+  if (ndof == 2)
+    outbuf_printf(ob, ", %g", total[1]);
+  outbuf_printf(ob, "\n");
+  free_outbuf(ob);
 }
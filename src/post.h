@@ -1 +1,3 @@
 void print_nodal_soln(struct list* nodes, struct static_soln* sol);
+void print_reactions(struct list* nodes, struct static_soln* sol,
+		     double* R);
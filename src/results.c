@@ -0,0 +1,415 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "lib/log.h"
+#include "lib/list.h"
+#include "lib/linalg.h"
+#include "lib/outbuf.h"
+#include "model.h"
+#include "mesh.h"
+#include "element_types.h"
+#include "bc_data.h"
+#include "solver.h"
+#include "shape.h"
+#include "results.h"
+
+
+/***********************************************
+ * Snapshot of the solved model
+ */
+
+
+static unsigned char vtk_type(int lib_id){
+  switch (lib_id%10){
+  case 0: case 1: case 2:
+    return 3;   // VTK_LINE
+  case 3:
+    return 5;   // VTK_TRIANGLE
+  case 4:
+    return 9;   // VTK_QUAD
+  case 6:
+    return 22;  // VTK_QUADRATIC_TRIANGLE
+  case 8:
+    return 23;  // VTK_QUADRATIC_QUAD
+  default:
+    return 2;   // VTK_POLY_VERTEX for superelements
+  }
+}
+
+
+static void element_stress(struct et_def* et, struct matrix* COORDS,
+			   double* ue, double* stress){
+  // Mean stress {sxx, syy, sxy} of plane elements, or heat flux
+  // {qx, qy}, over the integration points.  Bars give the axial stress
+  // as sxx.
+  struct solver_data* sd = et->sdata;
+  struct list* NDERGLBs;
+  double** dN;
+  double eps[3], w, area = 0.0, L2 = 0.0, dx[2];
+  int n = et->nenodes, ndof = et->ndof, ncomp = ndof == 2 ? 3 : 2;
+  int a, i, j, k;
+  for (i=0; i<ncomp; i++)
+    stress[i] = 0.0;
+  if (et->lib_id == 1){
+    for (i=0; i<2; i++){
+      dx[i] = COORDS->array[i][1] - COORDS->array[i][0];
+      L2 += dx[i]*dx[i];
+    }
+    stress[0] = et->mprops->E*(dx[0]*(ue[2]-ue[0]) +
+			       dx[1]*(ue[3]-ue[1]))/L2;
+    return;
+  }
+  if (!integrated_element(et->lib_id) || sd->NDERNATs == NULL ||
+      sd->D == NULL)
+    return;
+  NDERGLBs = construct_NDERGLBs(COORDS, sd->NDERNATs, sd->nint_pts);
+  for (k=0; k<sd->nint_pts; k++){
+    dN = ((struct matrix*) NDERGLBs->array[k])->array;
+    w = sd->int_wts[k]*jacobian(COORDS, sd->NDERNATs->array[k]);
+    eps[0] = eps[1] = eps[2] = 0.0;
+    for (a=0; a<n; a++){
+      if (ndof == 2){
+	eps[0] += dN[a][0]*ue[2*a];
+	eps[1] += dN[a][1]*ue[2*a+1];
+	eps[2] += dN[a][1]*ue[2*a] + dN[a][0]*ue[2*a+1];
+      }
+      else{
+	eps[0] -= dN[a][0]*ue[a];
+	eps[1] -= dN[a][1]*ue[a];
+      }
+    }
+    for (i=0; i<ncomp; i++){
+      for (j=0; j<ncomp; j++)
+	stress[i] += w*sd->D->array[i][j]*eps[j];
+    }
+    area += w;
+    free_matrix(NDERGLBs->array[k]);
+  }
+  free_list(NDERGLBs);
+  for (i=0; i<ncomp; i++)
+    stress[i] /= area;
+}
+
+
+struct result_set* new_result_set(struct model* running_model){
+  struct result_set* rs = malloc(sizeof(struct result_set));
+  struct static_soln* sol = running_model->solution;
+  struct list* nodes = running_model->nodes;
+  struct list* elements = running_model->elements;
+  struct node* nd;
+  struct element* e;
+  struct et_def* et;
+  struct matrix* COORDS;
+  double* ue;
+  int ndof = sol->ndof, i, j, a, n;
+  rs->ndof = ndof;
+  rs->nnodes = nodes->nitems;
+  rs->nelems = elements->nitems;
+  rs->ncomp = ndof == 2 ? 3 : 2;
+  rs->xy = malloc(2*rs->nnodes*sizeof(double));
+  rs->u = malloc(ndof*rs->nnodes*sizeof(double));
+  rs->reactions = malloc(ndof*rs->nnodes*sizeof(double));
+  for (i=0; i<rs->nnodes; i++){
+    nd = nodes->array[i];
+    rs->xy[2*i] = nd->x, rs->xy[2*i+1] = nd->y;
+  }
+  construct_nodal_values(running_model, sol, rs->u);
+  if (construct_reactions(running_model, sol, rs->u, rs->reactions) != 0){
+    free(rs->xy), free(rs->u), free(rs->reactions), free(rs);
+    return NULL;
+  }
+  rs->offsets = malloc((rs->nelems+1)*sizeof(int));
+  rs->offsets[0] = 0;
+  for (i=0; i<rs->nelems; i++){
+    e = elements->array[i];
+    et = get_et_def(running_model->et_defs, e->et_id);
+    rs->offsets[i+1] = rs->offsets[i] + et->nenodes;
+  }
+  rs->conn = malloc((rs->offsets[rs->nelems] > 0 ?
+		     rs->offsets[rs->nelems] : 1)*sizeof(int));
+  rs->types = malloc((rs->nelems > 0 ? rs->nelems : 1));
+  rs->stress = malloc((rs->nelems > 0 ? rs->nelems : 1)*rs->ncomp*
+		      sizeof(double));
+  for (i=0; i<rs->nelems; i++){
+    e = elements->array[i];
+    et = get_et_def(running_model->et_defs, e->et_id);
+    n = et->nenodes*ndof;
+    rs->types[i] = vtk_type(et->lib_id);
+    memcpy(&rs->conn[rs->offsets[i]], e->IEN, et->nenodes*sizeof(int));
+    ue = malloc(n*sizeof(double));
+    for (a=0; a<et->nenodes; a++){
+      for (j=0; j<ndof; j++)
+	ue[ndof*a+j] = rs->u[ndof*e->IEN[a]+j];
+    }
+    COORDS = construct_COORDS(nodes, e->IEN, et->nenodes);
+    element_stress(et, COORDS, ue, &rs->stress[rs->ncomp*i]);
+    free_matrix(COORDS), free(ue);
+  }
+  return rs;
+}
+
+
+void free_result_set(struct result_set* rs){
+  free(rs->xy), free(rs->u), free(rs->reactions);
+  free(rs->offsets), free(rs->conn), free(rs->types), free(rs->stress);
+  free(rs);
+}
+
+
+/***********************************************
+ * Writers
+ */
+
+
+static void write_block_size(struct outbuf* ob, uint64_t nbytes){
+  // Every appended VTK array is preceded by its size (header_type UInt64)
+  outbuf_write(ob, &nbytes, sizeof(uint64_t));
+}
+
+
+static void write_padded(struct outbuf* ob, double* values, int n,
+			 int ncomp){
+  // Pads ncomp components to the 3 VTK expects for vectors
+  double v[3] = {0.0, 0.0, 0.0};
+  int i;
+  write_block_size(ob, 3*n*sizeof(double));
+  for (i=0; i<n; i++){
+    memcpy(v, &values[ncomp*i], ncomp*sizeof(double));
+    outbuf_write(ob, v, 3*sizeof(double));
+  }
+}
+
+
+static void vtk_array(struct outbuf* ob, const char* type, const char* name,
+		      int ncomp, uint64_t* offset, uint64_t nbytes){
+  outbuf_printf(ob, "        <DataArray type=\"%s\" Name=\"%s\" "
+		"NumberOfComponents=\"%d\" format=\"appended\" "
+		"offset=\"%llu\"/>\n", type, name, ncomp,
+		(unsigned long long) *offset);
+  *offset += sizeof(uint64_t) + nbytes;
+}
+
+
+static void write_vtk(struct outbuf* ob, struct result_set* rs){
+  const uint16_t one = 1;
+  const char* order = *(const char*) &one ? "LittleEndian" : "BigEndian";
+  int nn = rs->nnodes, ne = rs->nelems, nconn = rs->offsets[ne];
+  int vcomp = rs->ndof == 2 ? 3 : 1;   // Displacement vector or temperature
+  uint64_t offset = 0;
+  outbuf_printf(ob, "<?xml version=\"1.0\"?>\n");
+  outbuf_printf(ob, "<VTKFile type=\"UnstructuredGrid\" version=\"1.0\" "
+		"byte_order=\"%s\" header_type=\"UInt64\">\n", order);
+  outbuf_printf(ob, "  <UnstructuredGrid>\n");
+  outbuf_printf(ob, "    <Piece NumberOfPoints=\"%d\" "
+		"NumberOfCells=\"%d\">\n", nn, ne);
+  outbuf_printf(ob, "      <PointData>\n");
+  vtk_array(ob, "Float64", rs->ndof == 2 ? "Displacement" : "Temperature",
+	    vcomp, &offset, (uint64_t) vcomp*nn*sizeof(double));
+  vtk_array(ob, "Float64", "Reaction", vcomp, &offset,
+	    (uint64_t) vcomp*nn*sizeof(double));
+  outbuf_printf(ob, "      </PointData>\n");
+  outbuf_printf(ob, "      <CellData>\n");
+  vtk_array(ob, "Float64", rs->ndof == 2 ? "Stress" : "HeatFlux", 3,
+	    &offset, (uint64_t) 3*ne*sizeof(double));
+  outbuf_printf(ob, "      </CellData>\n");
+  outbuf_printf(ob, "      <Points>\n");
+  vtk_array(ob, "Float64", "Points", 3, &offset,
+	    (uint64_t) 3*nn*sizeof(double));
+  outbuf_printf(ob, "      </Points>\n");
+  outbuf_printf(ob, "      <Cells>\n");
+  vtk_array(ob, "Int32", "connectivity", 1, &offset,
+	    (uint64_t) nconn*sizeof(int32_t));
+  vtk_array(ob, "Int32", "offsets", 1, &offset,
+	    (uint64_t) ne*sizeof(int32_t));
+  vtk_array(ob, "UInt8", "types", 1, &offset, (uint64_t) ne);
+  outbuf_printf(ob, "      </Cells>\n");
+  outbuf_printf(ob, "    </Piece>\n");
+  outbuf_printf(ob, "  </UnstructuredGrid>\n");
+  outbuf_printf(ob, "  <AppendedData encoding=\"raw\">\n_");
+  // Blocks in the order of their offsets above
+  if (rs->ndof == 2){
+    write_padded(ob, rs->u, nn, 2);
+    write_padded(ob, rs->reactions, nn, 2);
+  }
+  else{
+    write_block_size(ob, nn*sizeof(double));
+    outbuf_write(ob, rs->u, nn*sizeof(double));
+    write_block_size(ob, nn*sizeof(double));
+    outbuf_write(ob, rs->reactions, nn*sizeof(double));
+  }
+  write_padded(ob, rs->stress, ne, rs->ncomp);
+  write_padded(ob, rs->xy, nn, 2);
+  write_block_size(ob, nconn*sizeof(int32_t));
+  outbuf_write(ob, rs->conn, nconn*sizeof(int32_t));
+  write_block_size(ob, ne*sizeof(int32_t));
+  outbuf_write(ob, &rs->offsets[1], ne*sizeof(int32_t));
+  write_block_size(ob, ne);
+  outbuf_write(ob, rs->types, ne);
+  outbuf_printf(ob, "\n  </AppendedData>\n</VTKFile>\n");
+}
+
+
+static void write_binary(struct outbuf* ob, struct result_set* rs){
+  const char magic[8] = "FEARES1";
+  int32_t header[4] = {rs->ndof, rs->nnodes, rs->nelems, rs->ncomp};
+  int nn = rs->nnodes, ne = rs->nelems;
+  outbuf_write(ob, magic, sizeof(magic));
+  outbuf_write(ob, header, sizeof(header));
+  outbuf_write(ob, rs->xy, 2*nn*sizeof(double));
+  outbuf_write(ob, rs->u, rs->ndof*nn*sizeof(double));
+  outbuf_write(ob, rs->reactions, rs->ndof*nn*sizeof(double));
+  outbuf_write(ob, rs->offsets, (ne+1)*sizeof(int32_t));
+  outbuf_write(ob, rs->conn, rs->offsets[ne]*sizeof(int32_t));
+  outbuf_write(ob, rs->types, ne);
+  outbuf_write(ob, rs->stress, rs->ncomp*ne*sizeof(double));
+}
+
+
+#define WRITE_OK 0
+#define WRITE_NOT_OPENED 1
+#define WRITE_FAILED 2    // Short write or failed close, file incomplete
+
+
+static int write_results(struct result_set* rs, int format,
+			 char* filename, size_t* nbytes){
+  // Returns WRITE_*, and logs nothing, since it may run on the writer
+  // thread.  nbytes receives the bytes handed to the file.
+  FILE* file = fopen(filename, "wb");
+  struct outbuf* ob;
+  int status;
+  *nbytes = 0;
+  if (file == NULL)
+    return WRITE_NOT_OPENED;
+  ob = new_outbuf(file);
+  if (format == RES_VTK)
+    write_vtk(ob, rs);
+  else
+    write_binary(ob, rs);
+  outbuf_flush(ob);
+  *nbytes = ob->written;
+  status = ob->error ? WRITE_FAILED : WRITE_OK;
+  free_outbuf(ob);
+  if (ferror(file))
+    status = WRITE_FAILED;
+  if (fclose(file) != 0)
+    status = WRITE_FAILED;
+  return status;
+}
+
+
+static void report_write(int status, size_t nbytes, char* filename){
+  if (status == WRITE_NOT_OPENED)
+    lprintf("Error: Could not open %s for writing\n", filename);
+  else if (status == WRITE_FAILED)
+    lprintf("Error: Writing %s failed, the file is incomplete\n",
+	    filename);
+  else
+    lprintf("Wrote %zu bytes to %s\n", nbytes, filename);
+}
+
+
+int write_result_set(struct result_set* rs, int format, char* filename){
+  // Returns 1 if the file could not be written
+  size_t nbytes;
+  int status = write_results(rs, format, filename, &nbytes);
+  report_write(status, nbytes, filename);
+  return status != WRITE_OK;
+}
+
+
+/***********************************************
+ * Background writer
+ */
+
+
+struct writer_job{
+  struct result_set* rs;
+  int format;
+  char* filename;
+  size_t nbytes;
+  int status;           // WRITE_*
+};
+
+
+static void* writer_main(void* arg){
+  struct writer_job* job = arg;
+  job->status = write_results(job->rs, job->format, job->filename,
+			      &job->nbytes);
+  free_result_set(job->rs);
+  job->rs = NULL;
+  return job;
+}
+
+
+// Writers with a write in flight, waited for when the program exits
+static struct result_writer* pending = NULL;
+static pthread_mutex_t pending_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+static void wait_pending_writers(){
+  while (pending != NULL)
+    wait_result_writer(pending);
+}
+
+
+struct result_writer* new_result_writer(){
+  struct result_writer* w = malloc(sizeof(struct result_writer));
+  w->active = 0;
+  w->next = NULL;
+  return w;
+}
+
+
+void free_result_writer(struct result_writer* w){
+  wait_result_writer(w);
+  free(w);
+}
+
+
+void start_result_writer(struct result_writer* w, struct result_set* rs,
+			 int format, char* filename){
+  // Takes ownership of rs.  One write is in flight at a time, so a
+  // previous write is waited for first.
+  static int registered = 0;
+  struct writer_job* job = malloc(sizeof(struct writer_job));
+  wait_result_writer(w);
+  job->rs = rs;
+  job->format = format;
+  job->filename = malloc(strlen(filename)+1);
+  strcpy(job->filename, filename);
+  job->nbytes = 0;
+  job->status = WRITE_OK;
+  if (pthread_create(&w->thread, NULL, writer_main, job) != 0){
+    lprintf("Could not start the writer thread, writing in the foreground\n");
+    writer_main(job);
+    report_write(job->status, job->nbytes, job->filename);
+    free(job->filename), free(job);
+    return;
+  }
+  lprintf("Writing %s in the background\n", filename);
+  pthread_mutex_lock(&pending_lock);
+  if (!registered)
+    registered = atexit(wait_pending_writers) == 0;
+  w->active = 1;
+  w->next = pending;
+  pending = w;
+  pthread_mutex_unlock(&pending_lock);
+}
+
+
+void wait_result_writer(struct result_writer* w){
+  struct writer_job* job;
+  struct result_writer** p;
+  if (!w->active)
+    return;
+  pthread_join(w->thread, (void**) &job);
+  pthread_mutex_lock(&pending_lock);
+  for (p=&pending; *p != w; p=&(*p)->next);
+  *p = w->next;
+  w->active = 0;
+  pthread_mutex_unlock(&pending_lock);
+  report_write(job->status, job->nbytes, job->filename);
+  free(job->filename), free(job);
+}
@@ -0,0 +1,59 @@
+/*
+Result files.  A snapshot of the solved model (node coordinates,
+connectivity, nodal displacements and reactions, element stresses) is
+streamed through large output buffers as either
+
+  VTK XML unstructured grid (.vtu) with the arrays as appended raw
+  binary, or
+
+  native binary, all values in host byte order:
+    char    magic[8]            "FEARES1"
+    int32   ndof, nnodes, nelems, ncomp
+    double  xy[2*nnodes]
+    double  u[ndof*nnodes]
+    double  reactions[ndof*nnodes]
+    int32   offsets[nelems+1]   Element e is conn[offsets[e]..offsets[e+1]-1]
+    int32   conn[offsets[nelems]]
+    uint8   vtk_types[nelems]
+    double  stress[ncomp*nelems]
+
+The snapshot owns copies of everything it writes, so the write can run
+on a background thread while the model moves on.
+*/
+
+#include <pthread.h>
+
+#define RES_VTK 0
+#define RES_BINARY 1
+
+
+struct result_set{
+  int ndof;
+  int nnodes;
+  int nelems;
+  int ncomp;            // Stress components per element
+  double* xy;
+  double* u;            // Solved and prescribed values, node major
+  double* reactions;    // Zero on free dof
+  int* offsets;
+  int* conn;
+  unsigned char* types; // VTK cell types
+  double* stress;       // Element mean {sxx, syy, sxy} or heat flux
+};
+
+
+struct result_writer{
+  pthread_t thread;
+  int active;
+  struct result_writer* next;  // Writers still running at exit
+};
+
+
+struct result_set* new_result_set(struct model* running_model);
+int write_result_set(struct result_set* rs, int format, char* filename);
+void free_result_set(struct result_set* rs);
+struct result_writer* new_result_writer();
+void free_result_writer(struct result_writer* w);
+void start_result_writer(struct result_writer* w, struct result_set* rs,
+			 int format, char* filename);
+void wait_result_writer(struct result_writer* w);
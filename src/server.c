@@ -0,0 +1,310 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "lib/log.h"
+#include "lib/list.h"
+#include "lib/strfuncs.h"
+#include "model.h"
+#include "mesh.h"
+#include "element_types.h"
+#include "interpreter.h"
+#include "ke_batch.h"
+#include "server.h"
+
+
+#define MAXBUFFER 1000
+
+
+// A named model kept between requests
+struct resident{
+  char* name;
+  struct model* model;    // NULL once finished
+  int refs;               // Connections working on it
+  int listed;             // Still found by name
+  pthread_mutex_t lock;   // Held while a command runs on the model
+  struct resident* next;
+};
+
+
+struct connection{
+  struct server* server;
+  int fd;
+  struct connection* next;
+};
+
+
+struct server{
+  int fd;
+  int stopping;
+  struct resident* models;
+  struct connection* clients;
+  int nclients;
+  pthread_mutex_t lock;   // Guards everything above but the model data
+  pthread_cond_t idle;    // Signalled as clients disconnect
+};
+
+
+/***********************************************
+ * Resident models
+ */
+
+
+static struct resident* acquire_model(struct server* s, char* name){
+  struct resident* r;
+  pthread_mutex_lock(&s->lock);
+  for (r=s->models; r != NULL && strcmp(r->name, name) != 0; r=r->next);
+  if (r == NULL){
+    r = malloc(sizeof(struct resident));
+    r->name = malloc(strlen(name)+1);
+    strcpy(r->name, name);
+    r->model = new_model();
+    r->refs = 0;
+    r->listed = 1;
+    pthread_mutex_init(&r->lock, NULL);
+    r->next = s->models;
+    s->models = r;
+  }
+  r->refs++;
+  pthread_mutex_unlock(&s->lock);
+  return r;
+}
+
+
+static void free_resident(struct resident* r){
+  if (r->model != NULL)
+    free_model(r->model);
+  pthread_mutex_destroy(&r->lock);
+  free(r->name);
+  free(r);
+}
+
+
+static void release_model(struct server* s, struct resident* r){
+  // A finished model is freed by the last connection to let go of it
+  if (r == NULL)
+    return;
+  pthread_mutex_lock(&s->lock);
+  r->refs--;
+  if (r->refs > 0 || r->listed)
+    r = NULL;
+  pthread_mutex_unlock(&s->lock);
+  if (r != NULL)
+    free_resident(r);
+}
+
+
+static void unlist_model(struct server* s, struct resident* r){
+  struct resident** p;
+  pthread_mutex_lock(&s->lock);
+  for (p=&s->models; *p != r; p=&(*p)->next);
+  *p = r->next;
+  r->listed = 0;
+  pthread_mutex_unlock(&s->lock);
+}
+
+
+/***********************************************
+ * Client connections
+ */
+
+
+static void stop_server(struct server* s){
+  // Stops accepting, and ends every connection after its current command
+  struct connection* c;
+  pthread_mutex_lock(&s->lock);
+  s->stopping = 1;
+  shutdown(s->fd, SHUT_RDWR);
+  for (c=s->clients; c != NULL; c=c->next)
+    shutdown(c->fd, SHUT_RD);
+  pthread_mutex_unlock(&s->lock);
+}
+
+
+static int serve_command(struct server* s, struct resident** current,
+			 struct instruction* next_instruction){
+  struct resident* r = *current;
+  char* command = next_instruction->command;
+  int status = 0;
+  strtoupper(command);
+  if (strcmp("MODEL", command) == 0){
+    if (next_instruction->argc != 1){
+      lprintf("Error: MODEL takes a model name\n");
+      return 1;
+    }
+    release_model(s, r);
+    *current = acquire_model(s, next_instruction->argv[0]);
+    lprintf("Working on model %s\n", (*current)->name);
+    return 0;
+  }
+  if (strcmp("SHUTDOWN", command) == 0){
+    lprintf("Shutting down\n");
+    stop_server(s);
+    return 0;
+  }
+  if (r == NULL){
+    lprintf("Error: No model selected\n");
+    return 1;
+  }
+  pthread_mutex_lock(&r->lock);
+  if (r->model == NULL){
+    lprintf("Error: Model %s was finished\n", r->name);
+    status = 1;
+  }
+  else if (strcmp("FINISH", command) == 0){
+    free_model(r->model);
+    r->model = NULL;
+    unlist_model(s, r);
+    lprintf("Finished model %s\n", r->name);
+  }
+  else
+    status = execute(r->model, next_instruction);
+  pthread_mutex_unlock(&r->lock);
+  return status;
+}
+
+
+static void* client_main(void* arg){
+  struct connection* c = arg;
+  struct server* s = c->server;
+  struct connection** p;
+  struct resident* current = NULL;
+  struct instruction next_instruction;
+  char buffer[MAXBUFFER];
+  char* fields[MAXFIELDS];
+  FILE* in = fdopen(c->fd, "r");
+  FILE* out = fdopen(dup(c->fd), "w");
+  int status;
+  next_instruction.argv = fields;
+  set_log_stream(out);
+  while (fgets(buffer, MAXBUFFER, in) != NULL){
+    status = 0;
+    if (command_line(buffer)){
+      status = parse(buffer, &next_instruction);
+      if (status == 0)
+	status = serve_command(s, &current, &next_instruction);
+    }
+    lprintf("END %d\n", status);
+    fflush(out);
+  }
+  release_model(s, current);
+  set_log_stream(NULL);
+  fclose(out);
+  pthread_mutex_lock(&s->lock);
+  for (p=&s->clients; *p != c; p=&(*p)->next);
+  *p = c->next;
+  fclose(in);  // Closed under the lock, so stop_server never sees it
+  s->nclients--;
+  pthread_cond_signal(&s->idle);
+  pthread_mutex_unlock(&s->lock);
+  free(c);
+  return NULL;
+}
+
+
+/***********************************************
+ * Server
+ */
+
+
+static int open_socket(char* socket_path){
+  // Returns the listening socket, or -1.  A stale socket left by an
+  // earlier server is replaced, any other file is not.
+  struct sockaddr_un addr;
+  struct stat st;
+  int fd;
+  if (strlen(socket_path) >= sizeof(addr.sun_path)){
+    lprintf("Error: Socket path %s is too long\n", socket_path);
+    return -1;
+  }
+  if (stat(socket_path, &st) == 0 && S_ISSOCK(st.st_mode))
+    unlink(socket_path);
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, socket_path);
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd == -1 || bind(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0 ||
+      listen(fd, 16) != 0){
+    lprintf("Error: Could not listen on %s: %s\n", socket_path,
+	    strerror(errno));
+    if (fd != -1)
+      close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+
+int run_server(char* socket_path){
+  // Returns when a client sends SHUTDOWN and all clients are gone
+  struct server s;
+  struct connection* c;
+  struct resident* r;
+  pthread_t thread;
+  pthread_attr_t attr;
+  int fd;
+  s.fd = open_socket(socket_path);
+  if (s.fd == -1)
+    return 1;
+  s.stopping = 0;
+  s.models = NULL;
+  s.clients = NULL;
+  s.nclients = 0;
+  pthread_mutex_init(&s.lock, NULL);
+  pthread_cond_init(&s.idle, NULL);
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  signal(SIGPIPE, SIG_IGN);  // A client going away is not our end
+  ke_batch_width();          // Detected once, before the clients race
+  lprintf("Listening on %s\n", socket_path);
+  while (1){
+    fd = accept(s.fd, NULL, NULL);
+    if (fd == -1){
+      if (errno == EINTR || errno == ECONNABORTED){
+	if (!s.stopping)
+	  continue;
+      }
+      break;
+    }
+    c = malloc(sizeof(struct connection));
+    c->server = &s;
+    c->fd = fd;
+    pthread_mutex_lock(&s.lock);
+    if (s.stopping){
+      pthread_mutex_unlock(&s.lock);
+      close(fd), free(c);
+      break;
+    }
+    c->next = s.clients;
+    s.clients = c;
+    s.nclients++;
+    if (pthread_create(&thread, &attr, client_main, c) != 0){
+      lprintf("Error: Could not start a client thread\n");
+      s.clients = c->next;
+      s.nclients--;
+      close(fd), free(c);
+    }
+    pthread_mutex_unlock(&s.lock);
+  }
+  pthread_mutex_lock(&s.lock);
+  while (s.nclients > 0)
+    pthread_cond_wait(&s.idle, &s.lock);
+  pthread_mutex_unlock(&s.lock);
+  while ((r = s.models) != NULL){
+    s.models = r->next;
+    free_resident(r);
+  }
+  pthread_attr_destroy(&attr);
+  pthread_cond_destroy(&s.idle);
+  pthread_mutex_destroy(&s.lock);
+  close(s.fd);
+  unlink(socket_path);
+  lprintf("Server stopped\n");
+  return 0;
+}
@@ -0,0 +1,22 @@
+/*
+Server mode.  myfea listens on a Unix domain socket and keeps models
+resident between requests, so a client pays no startup, parsing or
+assembly for work on a model it has already built.  The dense solver's
+factors stay with the solution, so RESOLVE answers new load cases
+without assembly or factorization.
+
+Each client connection is served by its own thread.  A client sends
+script lines, one per line, and after the output of each line the
+server sends the line
+    END status
+with status 0 on success and 1 on failure.  On top of the script
+commands there are
+    MODEL, name     Work on the resident model name, created if new
+    SHUTDOWN        Stop the server.  Other clients are disconnected
+                    after their current command.
+FINISH frees the current model and removes it from the server.
+Commands on one model are run one at a time, while different models
+are worked on in parallel.
+*/
+
+int run_server(char* socket_path);
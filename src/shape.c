@@ -7,6 +7,9 @@ for all n shape functions of that element.
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "lib/log.h"
 #include "lib/geom.h"
 #include "lib/list.h"
 #include "lib/linalg.h"
@@ -40,6 +43,132 @@ construct_COORDS(struct list* nodes, int IEN[], int nenodes){
 }
 
 
+static struct vector*
+Tri3_N(struct point* pt){
+  struct vector* N = new_vector(3);
+  N->array[0] = 1.0-pt->x-pt->y;
+  N->array[1] = pt->x;
+  N->array[2] = pt->y;
+  return N;
+}
+
+
+static struct vector*
+Tri6_N(struct point* pt){
+  double r = pt->x, s = pt->y, L = 1.0-r-s;
+  struct vector* N = new_vector(6);
+  N->array[0] = L*(2.0*L-1.0);
+  N->array[1] = r*(2.0*r-1.0);
+  N->array[2] = s*(2.0*s-1.0);
+  N->array[3] = 4.0*L*r;
+  N->array[4] = 4.0*r*s;
+  N->array[5] = 4.0*s*L;
+  return N;
+}
+
+
+static struct vector*
+Plane4_N(struct point* pt){
+  double x = pt->x, y = pt->y;
+  struct vector* N = new_vector(4);
+  N->array[0] = 0.25*(1-x)*(1-y);
+  N->array[1] = 0.25*(1+x)*(1-y);
+  N->array[2] = 0.25*(1+x)*(1+y);
+  N->array[3] = 0.25*(1-x)*(1+y);
+  return N;
+}
+
+
+static struct vector*
+Plane8_N(struct point* pt){
+  static const double xa[8] = {-1, 1, 1, -1, 0, 1, 0, -1};
+  static const double ya[8] = {-1, -1, 1, 1, -1, 0, 1, 0};
+  double x = pt->x, y = pt->y;
+  struct vector* N = new_vector(8);
+  int a;
+  for (a=0; a<4; a++)
+    N->array[a] = 0.25*(1+x*xa[a])*(1+y*ya[a])*(x*xa[a]+y*ya[a]-1);
+  for (a=4; a<8; a++){
+    if (xa[a] == 0)
+      N->array[a] = 0.5*(1-x*x)*(1+y*ya[a]);
+    else
+      N->array[a] = 0.5*(1+x*xa[a])*(1-y*y);
+  }
+  return N;
+}
+
+
+static struct vector*
+construct_N(int lib_id, struct point* pt){
+  // Get shape function values in natural coordinates
+  if (lib_id == 3 || lib_id == 13)
+    return Tri3_N(pt);
+
+  else if (lib_id == 4 || lib_id == 14)
+    return Plane4_N(pt);
+
+  else if (lib_id == 6 || lib_id == 16)
+    return Tri6_N(pt);
+
+  else if (lib_id == 8 || lib_id == 18)
+    return Plane8_N(pt);
+
+  else{
+    lprintf("Invalid library element id\n");
+    return NULL;
+  }
+}
+
+
+struct list*
+construct_Ns(struct et_def* et){
+  // Shape function values at each integration point of the type
+  struct point pt;
+  struct list* Ns = new_list();
+  int i;
+  for (i=0; i<et->sdata->nint_pts; i++){
+    pt.x = et->sdata->int_pts[i][0];
+    pt.y = et->sdata->int_pts[i][1];
+    append(Ns, construct_N(et->lib_id, &pt));
+  }
+  return Ns;
+}
+
+
+static struct matrix*
+Tri3_NDERNAT(struct point* pt){
+  // 3-node linear triangular elements
+  // N0 = 1-r-s, N1 = r, N2 = s
+  struct matrix* NDERNAT = new_matrix(3, 2);
+  NDERNAT->array[0][0] = -1.0;
+  NDERNAT->array[0][1] = -1.0;
+  NDERNAT->array[1][0] = 1.0;
+  NDERNAT->array[2][1] = 1.0;
+  return NDERNAT;
+}
+
+
+static struct matrix*
+Tri6_NDERNAT(struct point* pt){
+  // 6-node quadratic triangular elements
+  // Corners 0-2 as Tri3, then midside nodes 3-5 on the edges
+  // 0-1, 1-2 and 2-0
+  double r = pt->x, s = pt->y, L = 1.0-r-s;
+  struct matrix* NDERNAT = new_matrix(6, 2);
+  NDERNAT->array[0][0] = 1.0-4.0*L;
+  NDERNAT->array[0][1] = 1.0-4.0*L;
+  NDERNAT->array[1][0] = 4.0*r-1.0;
+  NDERNAT->array[2][1] = 4.0*s-1.0;
+  NDERNAT->array[3][0] = 4.0*(L-r);
+  NDERNAT->array[3][1] = -4.0*r;
+  NDERNAT->array[4][0] = 4.0*s;
+  NDERNAT->array[4][1] = 4.0*r;
+  NDERNAT->array[5][0] = -4.0*s;
+  NDERNAT->array[5][1] = 4.0*(L-s);
+  return NDERNAT;
+}
+
+
 static struct matrix*
 Plane4_NDERNAT(struct point* pt){
   // 4-node linear quadrilateral elements
@@ -60,8 +189,27 @@ Plane4_NDERNAT(struct point* pt){
 static struct matrix*
 Plane8_NDERNAT(struct point* pt){
   // 8-node serendipity quadrilateral elements
+  // Corners 0-3 as Plane4, then midside nodes 4-7 on the edges
+  // 0-1, 1-2, 2-3 and 3-0
+  static const double xa[8] = {-1, 1, 1, -1, 0, 1, 0, -1};
+  static const double ya[8] = {-1, -1, 1, 1, -1, 0, 1, 0};
   struct matrix* NDERNAT = new_matrix(8, 2);
   double x = pt->x, y = pt->y;
+  int a;
+  for (a=0; a<4; a++){
+    NDERNAT->array[a][0] = 0.25*xa[a]*(1+y*ya[a])*(2*x*xa[a]+y*ya[a]);
+    NDERNAT->array[a][1] = 0.25*ya[a]*(1+x*xa[a])*(x*xa[a]+2*y*ya[a]);
+  }
+  for (a=4; a<8; a++){
+    if (xa[a] == 0){
+      NDERNAT->array[a][0] = -x*(1+y*ya[a]);
+      NDERNAT->array[a][1] = 0.5*ya[a]*(1-x*x);
+    }
+    else{
+      NDERNAT->array[a][0] = 0.5*xa[a]*(1-y*y);
+      NDERNAT->array[a][1] = -y*(1+x*xa[a]);
+    }
+  }
   return NDERNAT;
 }
 
@@ -70,14 +218,20 @@ static struct matrix*
 construct_NDERNAT(int lib_id, struct point* pt){
   // Get shape function derivative matrix in natural coordinates
   // Need only be computed once for each element family
-  if (lib_id == 4 || lib_id == 14)
+  if (lib_id == 3 || lib_id == 13)
+    return Tri3_NDERNAT(pt);
+
+  else if (lib_id == 4 || lib_id == 14)
     return Plane4_NDERNAT(pt);
+
+  else if (lib_id == 6 || lib_id == 16)
+    return Tri6_NDERNAT(pt);
   
   else if (lib_id == 8 || lib_id == 18)
     return Plane8_NDERNAT(pt);
   
   else{
-    printf("Invalid library element id\n");
+    lprintf("Invalid library element id\n");
     return NULL;
   }
 }
@@ -85,17 +239,82 @@ construct_NDERNAT(int lib_id, struct point* pt){
 
 struct list*
 construct_NDERNATs(struct et_def* et){
-  struct point* pt;
+  struct point pt;
   struct list* NDERNATs = new_list();
   int i;
   for (i=0; i<et->sdata->nint_pts; i++){
-    pt = et->sdata->int_pts->array[i];
-    append(NDERNATs, construct_NDERNAT(et->lib_id, pt));
+    pt.x = et->sdata->int_pts[i][0];
+    pt.y = et->sdata->int_pts[i][1];
+    append(NDERNATs, construct_NDERNAT(et->lib_id, &pt));
   }
   return NDERNATs;
 }
 
 
+double* construct_H(struct et_def* et){
+  // Integrals over the parent element of products of shape function
+  // derivatives in natural coordinates, using the type's own rule:
+  //     H[((a*n+b)*2+i)*2+j] = sum_k w_k*Na,i(k)*Nb,j(k)
+  // With a constant Jacobian the global derivative integrals, and so
+  // KE, follow from H without visiting the integration points.
+  int n = et->nenodes;
+  double* H = calloc(4*n*n, sizeof(double));
+  double **dN, w;
+  int a, b, i, j, k;
+  for (k=0; k<et->sdata->nint_pts; k++){
+    dN = ((struct matrix*) et->sdata->NDERNATs->array[k])->array;
+    w = et->sdata->int_wts[k];
+    for (a=0; a<n; a++){
+      for (b=0; b<n; b++){
+	for (i=0; i<2; i++){
+	  for (j=0; j<2; j++)
+	    H[((a*n+b)*2+i)*2+j] += w*dN[a][i]*dN[b][j];
+	}
+      }
+    }
+  }
+  return H;
+}
+
+
+#define AFFINE_TOL 1e-10
+
+
+static int midside_affine(struct matrix* COORDS, int ncorners, double tol){
+  // Midside nodes k = ncorners..2*ncorners-1 lie at their edge midpoints
+  double** X = COORDS->array;
+  int k, a, b;
+  for (k=0; k<ncorners; k++){
+    a = k, b = (k+1)%ncorners;
+    if (fabs(X[0][ncorners+k] - 0.5*(X[0][a] + X[0][b])) > tol ||
+	fabs(X[1][ncorners+k] - 0.5*(X[1][a] + X[1][b])) > tol)
+      return 0;
+  }
+  return 1;
+}
+
+
+int affine_element(int lib_id, struct matrix* COORDS){
+  // True when the map from the parent element is affine, so the
+  // Jacobian is the same at every point: parallelogram quads and
+  // triangles, with any midside nodes at their edge midpoints
+  double** X = COORDS->array;
+  double size = fabs(X[0][1] - X[0][0]) + fabs(X[1][1] - X[1][0]) +
+    fabs(X[0][2] - X[0][1]) + fabs(X[1][2] - X[1][1]);
+  double tol = AFFINE_TOL*size;
+  int parallelogram;
+  if (lib_id == 6 || lib_id == 16)
+    return midside_affine(COORDS, 3, tol);
+  if (lib_id != 4 && lib_id != 8 && lib_id != 14 && lib_id != 18)
+    return 0;
+  parallelogram = fabs(X[0][0] + X[0][2] - X[0][1] - X[0][3]) <= tol &&
+    fabs(X[1][0] + X[1][2] - X[1][1] - X[1][3]) <= tol;
+  if (lib_id == 8 || lib_id == 18)
+    return parallelogram && midside_affine(COORDS, 4, tol);
+  return parallelogram;
+}
+
+
 static struct matrix*
 construct_NDERGLB(struct matrix* COORDS, struct matrix* NDERNAT){
   struct matrix* J = mmmult(COORDS, NDERNAT);
@@ -121,3 +340,43 @@ construct_NDERGLBs(struct matrix* COORDS,
 
 
 
+
+
+#define MAXNEWTON 20
+#define LOCATE_TOL 1e-9
+
+
+struct vector* locate_point(int lib_id, struct matrix* COORDS,
+			    double x, double y){
+  // Shape function values at the point (x, y), or NULL when it is
+  // outside the element.  The natural coordinates are found by Newton
+  // iteration on the isoparametric map, from the element centre.
+  struct point pt;
+  struct vector* N;
+  struct matrix *NDERNAT, *J;
+  double** X = COORDS->array;
+  double rx, ry, det, dr, ds;
+  int tri = lib_id%10 == 3 || lib_id%10 == 6, a, it;
+  pt.x = pt.y = tri ? 1.0/3.0 : 0.0;
+  for (it=0; it<MAXNEWTON; it++){
+    N = construct_N(lib_id, &pt);
+    NDERNAT = construct_NDERNAT(lib_id, &pt);
+    J = mmmult(COORDS, NDERNAT);
+    rx = x, ry = y;
+    for (a=0; a<N->n; a++)
+      rx -= N->array[a]*X[0][a], ry -= N->array[a]*X[1][a];
+    det = determinant2x2(J);
+    dr = det != 0.0 ? (J->array[1][1]*rx - J->array[0][1]*ry)/det : 0.0;
+    ds = det != 0.0 ? (J->array[0][0]*ry - J->array[1][0]*rx)/det : 0.0;
+    free_vector(N), free_matrix(NDERNAT), free_matrix(J);
+    pt.x += dr, pt.y += ds;
+    if (fabs(dr) + fabs(ds) < 1e-12)
+      break;
+  }
+  if (tri && (pt.x < -LOCATE_TOL || pt.y < -LOCATE_TOL ||
+	      pt.x + pt.y > 1.0+LOCATE_TOL))
+    return NULL;
+  if (!tri && (fabs(pt.x) > 1.0+LOCATE_TOL || fabs(pt.y) > 1.0+LOCATE_TOL))
+    return NULL;
+  return construct_N(lib_id, &pt);
+}
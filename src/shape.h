@@ -1,5 +1,10 @@
 double jacobian(struct matrix* COORDS, struct matrix* NDERNAT);
 struct matrix* construct_COORDS(struct list* nodes, int IEN[], int nenodes);
+struct list* construct_Ns(struct et_def* et);
 struct list* construct_NDERNATs(struct et_def* et);
+double* construct_H(struct et_def* et);
+int affine_element(int lib_id, struct matrix* COORDS);
 struct list* construct_NDERGLBs(struct matrix* COORDS,
 				struct list* NDERNATs, int nint_pts);
+struct vector* locate_point(int lib_id, struct matrix* COORDS,
+			    double x, double y);
@@ -1,8 +1,17 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
+#include <float.h>
+#include <string.h>
+#include <assert.h>
+#include <sys/mman.h>
+#include "lib/log.h"
 #include "lib/list.h"
 #include "lib/geom.h"
 #include "lib/linalg.h"
+#include "lib/quadrature.h"
+#include "lib/sparse_linalg.h"
+#include "lib/amg.h"
 #include "model.h"
 #include "mesh.h"
 #include "element_types.h"
@@ -10,38 +19,92 @@
 #include "stiffness.h"
 #include "solver.h"
 #include "shape.h"
+#include "superelement.h"
+#include "ke_batch.h"
 
 
-static void precomputations(struct list* et_defs){
+#define MAXREFINE 30     // Refinement steps before falling back
+#define STALL_RATIO 0.5  // Minimum residual reduction per step
+#define CG_TOL 1e-10     // Relative residual of the iterative solvers
+#define PENALTY_SCALE 1e8   // Default penalty over the largest pivot
+#define LAGRANGE_SCALE 1e4  // Default augmented Lagrange penalty
+#define BC_TOL 1e-12     // Relative constraint error of augmented Lagrange
+#define BC_MAXITER 50    // Multiplier updates before giving up
+
+
+int check_et_defs(struct list* et_defs){
+  // Returns 1, with the reason logged, for a type the solvers cannot
+  // handle, which precomputations and assembly then must not meet
+  struct et_def* et;
+  struct matrix* D;
+  int i;
+  for (i=0; i<et_defs->nitems; i++){
+    et = et_defs->array[i];
+    if (select_KE_kernel(et) == NULL)
+      return 1;
+    if (integrated_element(et->lib_id)){
+      if (get_quad_rule(et->lib_id, et->opts[0], et->opts[2]) == NULL)
+	return 1;
+      D = construct_D(et);
+      if (D == NULL)
+	return 1;
+      free_matrix(D);
+    }
+  }
+  return 0;
+}
+
+
+void precomputations(struct list* et_defs){
   // Perform any computations that apply to all elements of the same type
   // and store them in the type definition's solver data
   int i, j, lib_id, integration;
   struct et_def* et;
+  const struct quad_rule* rule;
   for (i=0; i<et_defs->nitems; i++){
     et = et_defs->array[i];
     lib_id = et->lib_id;
     integration = et->opts[0];
     if (integrated_element(lib_id)){
-      printf("Computing integration values\n");
-      et->sdata->nint_pts = get_nint_pts(lib_id, integration);
-      et->sdata->int_pts = get_int_pts(lib_id, integration);
-      et->sdata->int_wts = get_int_wts(lib_id, integration);
+      lprintf("Computing integration values\n");
+      rule = get_quad_rule(lib_id, integration, et->opts[2]);
+      et->sdata->nint_pts = rule->npts;
+      et->sdata->int_pts = rule->pts;
+      et->sdata->int_wts = rule->wts;
+      // Replaces the values of an earlier solve, which resident models
+      // would otherwise leak on every solve
+      if (et->sdata->D != NULL)
+	free_matrix(et->sdata->D);
+      if (et->sdata->NDERNATs != NULL){
+	for (j=0; j<et->sdata->NDERNATs->nitems; j++)
+	  free_matrix(et->sdata->NDERNATs->array[j]);
+	free_list(et->sdata->NDERNATs);
+      }
       et->sdata->D = construct_D(et);
       // List of shape function derivatives in natural coordinates for each
       // integration point (e, n).  Stored in convenient array.
       et->sdata->NDERNATs = construct_NDERNATs(et);
+      // Only the isoparametric kernels have an affine fast path
+      if (et->sdata->H != NULL)
+	free(et->sdata->H);
+      et->sdata->H = NULL;
+      if (lib_id != 3 && lib_id != 13)
+	et->sdata->H = construct_H(et);
     }
   }
 }
 
 
-static void construct_ID(struct list* nodes, int ndof,
-			 struct list* essential_bcs, struct matrix* ID){
-  printf("Constructing ID matrix\n");
-  int i, j, eqn = 0, nnodes = nodes->nitems;
-  for (i=0; i<nnodes; i++){
+void construct_ID(struct list* nodes, int ndof,
+		  struct list* essential_bcs, int* order, struct matrix* ID){
+  // With essential_bcs NULL every dof gets an equation.  The equations
+  // follow the nodes in order, or in input order when it is NULL.
+  lprintf("Constructing ID matrix\n");
+  int i, j, k, eqn = 0, nnodes = nodes->nitems;
+  for (k=0; k<nnodes; k++){
+    i = order != NULL ? order[k] : k;
     for (j=0; j<ndof; j++){
-      if (is_constrained(essential_bcs, i, j))
+      if (essential_bcs != NULL && is_constrained(essential_bcs, i, j))
 	ID->array[i][j] = -1;
       else
 	ID->array[i][j] = eqn++;
@@ -50,58 +113,300 @@ static void construct_ID(struct list* nodes, int ndof,
 }
 
 
-static void assemble_KE(struct matrix* K, struct vector* F, struct matrix* KE,
-			struct matrix* ID, int IEN[],
-			struct list* essential_bcs, int nenodes, int ndof){
-  // IEN maps local node numbers (starting at 0) to global node numbers
-  // ID maps global node numbers and dof to equation numbers
-  int i, j, k, l, p, q, P, Q;
-  double g;
-  for (i=0; i<nenodes; i++){
-    for (j=0; j<ndof; j++){
-      p = ndof*i+j;                     // Local row number
-      P = ID->array[IEN[i]][j];         // Global row number
-      if (P != -1){
-	for (k=0; k<nenodes; k++){
-	  for (l=0; l<ndof; l++){
-	    q = ndof*k+l;               // Local col number
-	    Q = ID->array[IEN[k]][l];   // Global col number
-	    if (Q != -1)
-	      K->array[P][Q] += KE->array[p][q];
-	    else{
-	      g = get_essential_bc(essential_bcs, IEN[k], l);
-	      F->array[P] -= KE->array[p][q]*g;
-	    }
+/*
+ * The constrained rows K_cf and K_cc, thrown away in the equations, are
+ * kept in a coupling when one is given.  Its columns are the free
+ * equations followed by the constrained dof numbers of CID.
+ */
+struct coupling{
+  struct matrix* CID;     // Constrained dof numbers, -1 on free dof
+  int nfree;
+  struct aol_matrix* K;
+  struct vector* F;       // Superelement loads on the constrained dof
+};
+
+
+/*
+ * Location vectors.  Element e has the equation number of each of its
+ * dof at LM[start[e]] onwards, or -1-C for constrained dof number C
+ * (the numbering of CID), so assembly needs no lookups in ID.
+ */
+struct location_map{
+  int* LM;
+  int* start;
+  double* g;              // Prescribed value of each constrained dof
+};
+
+
+static struct location_map* new_location_map(struct list* elements,
+					     struct list* et_defs,
+					     struct matrix* ID,
+					     struct list* essential_bcs){
+  struct location_map* lm = malloc(sizeof(struct location_map));
+  struct essential_bc* ebc;
+  struct element* e;
+  int nnodes = ID->nrows, ndof = ID->ncols, nc = 0, i, a;
+  int* eq = malloc((nnodes*ndof > 0 ? nnodes*ndof : 1)*sizeof(int));
+  for (i=0; i<nnodes*ndof; i++){
+    eq[i] = ID->array[i/ndof][i%ndof];
+    if (eq[i] == -1)
+      eq[i] = -1-nc++;
+  }
+  lm->g = malloc((nc > 0 ? nc : 1)*sizeof(double));
+  for (i=essential_bcs->nitems-1; i>=0; i--){
+    // Backwards, so the first of several values on a dof is kept
+    ebc = essential_bcs->array[i];
+    a = eq[ndof*ebc->node_id+ebc->dof];
+    if (a < 0)
+      lm->g[-1-a] = ebc->value;
+  }
+  lm->start = malloc((elements->nitems+1)*sizeof(int));
+  lm->start[0] = 0;
+  for (i=0; i<elements->nitems; i++){
+    e = elements->array[i];
+    lm->start[i+1] = lm->start[i] +
+      ndof*get_et_def(et_defs, e->et_id)->nenodes;
+  }
+  lm->LM = malloc((lm->start[i] > 0 ? lm->start[i] : 1)*sizeof(int));
+  for (i=0; i<elements->nitems; i++){
+    e = elements->array[i];
+    for (a=lm->start[i]; a<lm->start[i+1]; a++)
+      lm->LM[a] = eq[ndof*e->IEN[(a-lm->start[i])/ndof] +
+		     (a-lm->start[i])%ndof];
+  }
+  free(eq);
+  return lm;
+}
+
+
+static void free_location_map(struct location_map* lm){
+  free(lm->LM), free(lm->start), free(lm->g);
+  free(lm);
+}
+
+
+static void assemble_KE(struct matrix* K, struct aol_matrix* Ks,
+			struct vector* F, struct matrix* KE, int LM[],
+			int n, double* g, struct coupling* Kc){
+  // LM maps the n local dof to equation numbers, or to -1-C for the
+  // constrained dof C with prescribed value g[C]
+  // Entries go to the dense K, or to the sparse Ks when K is NULL
+  int p, q, P, Q;
+  double* KEp;
+  for (p=0; p<n; p++){
+    P = LM[p];
+    KEp = KE->array[p];
+    if (P >= 0){
+      for (q=0; q<n; q++){
+	Q = LM[q];
+	if (Q >= 0 && K != NULL)
+	  K->array[P][Q] += KEp[q];
+	else if (Q >= 0)
+	  add_aol_element(Ks, P, Q, KEp[q]);
+	else
+	  F->array[P] -= KEp[q]*g[-1-Q];
+      }
+    }
+    else if (Kc != NULL){
+      for (q=0; q<n; q++){
+	Q = LM[q];
+	add_aol_element(Kc->K, -1-P, Q >= 0 ? Q : Kc->nfree-1-Q, KEp[q]);
+      }
+    }
+  }
+}
+
+
+static void assemble_FE(struct vector* F, struct vector* FE, int LM[],
+			int n, struct coupling* Kc){
+  // Adds an element load vector to the free equations of F, and to the
+  // constrained dof of Kc
+  int p;
+  for (p=0; p<n; p++){
+    if (LM[p] >= 0)
+      F->array[LM[p]] += FE->array[p];
+    else if (Kc != NULL)
+      Kc->F->array[-1-LM[p]] += FE->array[p];
+  }
+}
+
+
+static void assemble_element(struct list* nodes, struct element* e,
+			     struct et_def* et, struct matrix* KE,
+			     struct location_map* lm, int index,
+			     struct matrix* K, struct aol_matrix* Ks,
+			     struct vector* F, struct coupling* Kc){
+  struct matrix* COORDS;
+  struct vector* FE;
+  int* LM = lm->LM + lm->start[index];
+  int n = lm->start[index+1] - lm->start[index];
+  print_matrix(KE);
+  assemble_KE(K, Ks, F, KE, LM, n, lm->g, Kc);
+  if (et->sedata != NULL){
+    // Superelements carry the condensed loads of their interior
+    COORDS = construct_COORDS(nodes, e->IEN, et->nenodes);
+    FE = Superelement_FE(et->sedata, COORDS);
+    assemble_FE(F, FE, LM, n, Kc);
+    free_matrix(COORDS), free_vector(FE);
+  }
+}
+
+
+/*
+ * Elements are assembled in batches of one element type, so the type's
+ * data and stiffness kernel are looked up once per batch.  perm keeps
+ * the input element number of each position in the batched order, in
+ * which a batch follows the assembly order of the mesh.
+ */
+struct element_batches{
+  int nbatches;
+  struct et_def** ets;  // Element type of each batch
+  int* start;           // Batch b is perm[start[b]] to perm[start[b+1]-1]
+  int* perm;
+};
+
+
+static struct element_batches* group_elements(struct list* elements,
+					      struct list* et_defs,
+					      int* order){
+  // Stable counting sort of the elements, in order or else input
+  // order, by element type
+  struct element_batches* eb = malloc(sizeof(struct element_batches));
+  int nets = et_defs->nitems, ne = elements->nitems;
+  int* type = malloc(ne*sizeof(int));
+  int* count = calloc(nets+1, sizeof(int));
+  int i, k, b;
+  struct element* e;
+  for (i=0; i<ne; i++){
+    e = elements->array[i];
+    for (b=0; b<nets; b++){
+      if (((struct et_def*) et_defs->array[b])->user_id == e->et_id)
+	break;
+    }
+    assert(b < nets);
+    type[i] = b;
+    count[b+1]++;
+  }
+  eb->ets = malloc(nets*sizeof(struct et_def*));
+  eb->start = malloc((nets+1)*sizeof(int));
+  eb->perm = malloc(ne*sizeof(int));
+  eb->nbatches = 0;
+  eb->start[0] = 0;
+  for (b=0; b<nets; b++){
+    count[b+1] += count[b];
+    if (count[b+1] > count[b]){
+      eb->ets[eb->nbatches++] = et_defs->array[b];
+      eb->start[eb->nbatches] = count[b+1];
+    }
+  }
+  for (k=0; k<ne; k++){
+    i = order != NULL ? order[k] : k;
+    eb->perm[count[type[i]]++] = i;
+  }
+  free(type), free(count);
+  return eb;
+}
+
+
+static void free_element_batches(struct element_batches* eb){
+  free(eb->ets), free(eb->start), free(eb->perm);
+  free(eb);
+}
+
+
+static void assemble_K(struct list* nodes, struct list* elements,
+		       struct list* et_defs, struct matrix* ID,
+		       struct matrix* K, struct aol_matrix* Ks,
+		       struct vector* F, struct list* essential_bcs,
+		       struct coupling* Kc, int* order){
+  // order, if given, is the order to assemble the elements in
+  struct element_batches* eb = group_elements(elements, et_defs, order);
+  struct location_map* lm = new_location_map(elements, et_defs, ID,
+					     essential_bcs);
+  struct element* e;
+  struct element* lanes[KE_BATCH_MAX];
+  int index[KE_BATCH_MAX];
+  struct et_def* et;
+  struct matrix *KE, *COORDS;
+  struct matrix* KEs[KE_BATCH_MAX];
+  KE_kernel kernel;
+  int b, i, j, n, first, last, nenodes, width = ke_batch_width();
+  for (b=0; b<eb->nbatches; b++){
+    et = eb->ets[b];
+    nenodes = et->nenodes;
+    first = eb->start[b], last = eb->start[b+1];
+    lprintf("Assembling %d elements of type %d\n", last-first, et->user_id);
+    et->sdata->naffine = 0;
+    if (batched_element(et)){
+      // Affine elements take the closed form directly, the others go
+      // through the SIMD kernels several elements at a time
+      n = 0;
+      for (i=first; i<=last; i++){
+	if (i < last){
+	  e = elements->array[eb->perm[i]];
+	  COORDS = construct_COORDS(nodes, e->IEN, nenodes);
+	  KE = Affine_KE(et, COORDS);
+	  free_matrix(COORDS);
+	  if (KE != NULL){
+	    lprintf("Assembling stiffness matrix for element %d\n", eb->perm[i]);
+	    assemble_element(nodes, e, et, KE, lm, eb->perm[i], K, Ks, F, Kc);
+	    free_matrix(KE);
+	    continue;
 	  }
+	  lanes[n] = e, index[n++] = eb->perm[i];
 	}
+	if (n == width || (i == last && n > 0)){
+	  batch_KE(et, nodes, lanes, n, KEs);
+	  for (j=0; j<n; j++){
+	    lprintf("Assembling stiffness matrix for element %d\n", index[j]);
+	    assemble_element(nodes, lanes[j], et, KEs[j], lm, index[j], K, Ks,
+			     F, Kc);
+	    free_matrix(KEs[j]);
+	  }
+	  n = 0;
+	}
+      }
+    }
+    else{
+      kernel = select_KE_kernel(et);
+      for (i=first; i<last; i++){
+	lprintf("Assembling stiffness matrix for element %d\n", eb->perm[i]);
+	e = elements->array[eb->perm[i]];
+	COORDS = construct_COORDS(nodes, e->IEN, nenodes);
+	KE = kernel(et, COORDS);
+	assemble_element(nodes, e, et, KE, lm, eb->perm[i], K, Ks, F, Kc);
+	free_matrix(KE), free_matrix(COORDS);
       }
     }
+    if (et->sdata->naffine > 0)
+      lprintf("%d of %d elements of type %d took the affine fast path\n",
+	     et->sdata->naffine, last-first, et->user_id);
   }
+  free_element_batches(eb);
+  free_location_map(lm);
 }
 
 
-static void construct_K(struct list* nodes, struct list* elements,
+void construct_K(struct list* nodes, struct list* elements,
+		 struct list* et_defs, struct matrix* ID,
+		 struct matrix* K, struct vector* F, int free_dof,
+		 struct list* essential_bcs){
+  assemble_K(nodes, elements, et_defs, ID, K, NULL, F, essential_bcs, NULL,
+	     NULL);
+}
+
+
+void construct_sparse_K(struct list* nodes, struct list* elements,
 			struct list* et_defs, struct matrix* ID,
-			struct matrix* K, struct vector* F, int free_dof,
+			struct aol_matrix* K, struct vector* F,
 			struct list* essential_bcs){
-  struct element* e;
-  struct et_def* et;
-  struct matrix *KE;
-  int i;
-  for (i=0; i<elements->nitems; i++){
-    printf("Assembling stiffness matrix for element %d\n", i);
-    e = elements->array[i];
-    et = get_et_def(et_defs, e->et_id);
-    KE = construct_KE(e, et, nodes);
-    print_matrix(KE);
-    assemble_KE(K, F, KE, ID, e->IEN, essential_bcs, et->nenodes, et->ndof);
-    free_matrix(KE);
-  }
+  assemble_K(nodes, elements, et_defs, ID, NULL, K, F, essential_bcs, NULL,
+	     NULL);
 }
 
 
-static void construct_F(struct list* nodes, struct list* nodal_forces,
-			struct matrix* ID, struct vector* F, int ndof){
+void construct_F(struct list* nodes, struct list* nodal_forces,
+		 struct matrix* ID, struct vector* F, int ndof){
   int i, j, P;
   for (i=0; i<nodes->nitems; i++){
     for (j=0; j<ndof; j++){
@@ -113,42 +418,709 @@ static void construct_F(struct list* nodes, struct list* nodal_forces,
 }
 
 
-static struct static_soln* new_static_soln(int ndof, struct matrix* ID,
-					   struct vector* U){
+int* construct_profile(struct list* elements, struct list* et_defs,
+		       struct matrix* ID, int free_dof){
+  // Symbolic analysis for skyline storage.  The profile of column Q
+  // starts at the lowest equation sharing an element with it.
+  int* first = malloc((free_dof > 0 ? free_dof : 1)*sizeof(int));
+  struct element* e;
+  struct et_def* et;
+  int i, k, l, P, low;
+  for (P=0; P<free_dof; P++)
+    first[P] = P;
+  for (i=0; i<elements->nitems; i++){
+    e = elements->array[i];
+    et = get_et_def(et_defs, e->et_id);
+    low = free_dof;
+    for (k=0; k<et->nenodes; k++){
+      for (l=0; l<et->ndof; l++){
+	P = ID->array[e->IEN[k]][l];
+	if (P != -1 && P < low)
+	  low = P;
+      }
+    }
+    for (k=0; k<et->nenodes; k++){
+      for (l=0; l<et->ndof; l++){
+	P = ID->array[e->IEN[k]][l];
+	if (P != -1 && low < first[P])
+	  first[P] = low;
+      }
+    }
+  }
+  return first;
+}
+
+
+struct static_soln* new_static_soln(int ndof, struct matrix* ID,
+				    struct vector* U){
   struct static_soln* sol = malloc(sizeof(struct static_soln));
   sol->ndof = ndof;
   sol->ID = ID;
   sol->U = U;
+  sol->LU = NULL;
+  sol->F0 = NULL;
+  sol->CID = NULL;
+  sol->G = NULL;
+  sol->Kc = NULL;
+  sol->Fc = NULL;
+  sol->Rc = NULL;
+  sol->map = NULL;
+  sol->map_size = 0;
   return sol;
 }
 
 
 void free_static_soln(struct static_soln* sol){
   free_matrix(sol->ID);
-  free_vector(sol->U);
+  if (sol->CID != NULL)
+    free_matrix(sol->CID), free_vector(sol->G);
+  if (sol->Kc != NULL)
+    free_csr_matrix(sol->Kc), free_vector(sol->Fc);
+  if (sol->Rc != NULL)
+    free_vector(sol->Rc);
+  if (sol->map != NULL){
+    // Only the headers are on the heap, the values are in the mapping
+    if (sol->LU != NULL)
+      free(sol->LU->array), free(sol->LU);
+    if (sol->F0 != NULL)
+      free(sol->F0);
+    free(sol->U);
+    munmap(sol->map, sol->map_size);
+  }
+  else{
+    if (sol->LU != NULL)
+      free_matrix(sol->LU);
+    if (sol->F0 != NULL)
+      free_vector(sol->F0);
+    free_vector(sol->U);
+  }
   free(sol);
 }
 
 
+static struct matrix* construct_CID(struct matrix* ID, int* nc){
+  // Numbers the constrained dof in node order
+  struct matrix* CID = new_matrix(ID->nrows, ID->ncols);
+  int i, j;
+  *nc = 0;
+  for (i=0; i<ID->nrows; i++){
+    for (j=0; j<ID->ncols; j++)
+      CID->array[i][j] = ID->array[i][j] == -1 ? (*nc)++ : -1;
+  }
+  return CID;
+}
+
+
+static struct vector* constrained_values(struct list* essential_bcs,
+					 struct matrix* CID, int nc){
+  struct vector* g = new_vector(nc);
+  int i, j;
+  for (i=0; i<CID->nrows; i++){
+    for (j=0; j<CID->ncols; j++){
+      if (CID->array[i][j] != -1)
+	g->array[(int) CID->array[i][j]] =
+	  get_essential_bc(essential_bcs, i, j);
+    }
+  }
+  return g;
+}
+
+
+void number_constrained_dof(struct static_soln* sol,
+			    struct list* essential_bcs){
+  // Records the prescribed values the solution was found with
+  int nc;
+  sol->CID = construct_CID(sol->ID, &nc);
+  sol->G = constrained_values(essential_bcs, sol->CID, nc);
+}
+
+
+void keep_constraint_forces(struct static_soln* sol,
+			    struct list* essential_bcs, struct vector* Rc){
+  // Moves Rc, the constraint forces of skyline_solve, into a solution
+  // whose constrained dof kept their equations.  CID numbers them in
+  // essential bc order.
+  struct essential_bc* ebc;
+  int i, j;
+  sol->CID = new_matrix(sol->ID->nrows, sol->ID->ncols);
+  for (i=0; i<sol->ID->nrows; i++){
+    for (j=0; j<sol->ID->ncols; j++)
+      sol->CID->array[i][j] = -1;
+  }
+  for (i=0; i<essential_bcs->nitems; i++){
+    ebc = essential_bcs->array[i];
+    sol->CID->array[ebc->node_id][ebc->dof] = i;
+  }
+  sol->G = constrained_values(essential_bcs, sol->CID, Rc->n);
+  sol->Rc = Rc;
+}
+
+
+int constrained_dof(struct static_soln* sol, int node, int dof){
+  if (sol->CID != NULL)
+    return sol->CID->array[node][dof] != -1;
+  return sol->ID->array[node][dof] == -1;
+}
+
+
+static struct coupling* new_coupling(struct matrix* ID, int nfree){
+  struct coupling* Kc = malloc(sizeof(struct coupling));
+  int nc;
+  Kc->CID = construct_CID(ID, &nc);
+  Kc->nfree = nfree;
+  Kc->K = new_aol_matrix(nc, nfree+nc);
+  Kc->F = new_vector(nc);
+  return Kc;
+}
+
+
+static void free_coupling(struct coupling* Kc){
+  free_matrix(Kc->CID);
+  free_aol_matrix(Kc->K);
+  free_vector(Kc->F);
+  free(Kc);
+}
+
+
+static void keep_coupling(struct static_soln* sol, struct coupling* Kc,
+			  struct list* essential_bcs){
+  // Moves the assembled coupling into the solution
+  sol->CID = Kc->CID;
+  sol->G = constrained_values(essential_bcs, Kc->CID, Kc->F->n);
+  sol->Kc = aol_to_csr(Kc->K);
+  sol->Fc = Kc->F;
+  free_aol_matrix(Kc->K);
+  free(Kc);
+}
+
+
+static void assemble_dense_system(struct model* running_model,
+				  struct matrix* ID, struct matrix* K,
+				  struct vector* F, struct vector* F0,
+				  struct coupling** Kc){
+  // F0, if given, receives the load before the nodal forces are added.
+  // Kc, if given, receives the coupling to the constrained dof.
+  precomputations(running_model->et_defs);
+  construct_ID(running_model->nodes, running_model->ndof,
+	       running_model->essential_bcs, model_node_order(running_model),
+	       ID);
+  lprintf("ID Matrix\n"), print_matrix(ID);
+  if (Kc != NULL)
+    *Kc = new_coupling(ID, running_model->free_dof);
+  assemble_K(running_model->nodes, running_model->elements,
+	     running_model->et_defs, ID, K, NULL, F,
+	     running_model->essential_bcs, Kc != NULL ? *Kc : NULL,
+	     model_element_order(running_model));
+  lprintf("Stiffness matrix:\n"), print_matrix(K);
+  if (F0 != NULL)
+    memcpy(F0->array, F->array, F->n*sizeof(double));
+  construct_F(running_model->nodes, running_model->nodal_forces,
+	      ID, F, running_model->ndof);
+  lprintf("Force vector:\n"), print_vector(F);
+}
+
+
 struct static_soln* dense_static_solver(struct model* running_model){
+  // The factors are kept with the solution for later load cases
   struct matrix* ID = new_matrix(running_model->nodes->nitems,
 				running_model->ndof);
   struct matrix* K = new_matrix(running_model->free_dof,
 				running_model->free_dof);
   struct vector* F = new_vector(running_model->free_dof);
-  precomputations(running_model->et_defs);
-  construct_ID(running_model->nodes, running_model->ndof,
-	       running_model->essential_bcs, ID);
-  printf("ID Matrix\n"), print_matrix(ID);
-  construct_K(running_model->nodes, running_model->elements,
-	      running_model->et_defs, ID, K, F, running_model->free_dof,
-	      running_model->essential_bcs);
-  printf("Stiffness matrix:\n"), print_matrix(K);
+  struct vector* F0 = new_vector(running_model->free_dof);
+  struct static_soln* sol;
+  struct coupling* Kc;
+  assemble_dense_system(running_model, ID, K, F, F0, &Kc);
+  if (luMFA(K) != 0){
+    lprintf("Error: Zero pivot in the dense factorization\n");
+    free_matrix(ID), free_matrix(K), free_vector(F), free_vector(F0);
+    free_coupling(Kc);
+    return NULL;
+  }
+  luLSS(K, F);  // Reduces F to U
+  lprintf("Solution vector:\n"), print_vector(F);
+  sol = new_static_soln(running_model->ndof, ID, F);
+  sol->LU = K, sol->F0 = F0;
+  keep_coupling(sol, Kc, running_model->essential_bcs);
+  return sol;
+}
+
+
+static int update_prescribed(struct model* running_model,
+			     struct static_soln* sol){
+  // Moves F0 to the current prescribed values through K_fc, the
+  // transpose of the kept K_cf.  Returns 1 if they changed and the
+  // coupling was not kept.
+  struct csr_matrix* Kc = sol->Kc;
+  struct vector* g = constrained_values(running_model->essential_bcs,
+					sol->CID, sol->G->n);
+  double dg;
+  int c, k, nchanged = 0;
+  for (c=0; c<g->n; c++){
+    dg = g->array[c] - sol->G->array[c];
+    if (dg == 0.0)
+      continue;
+    if (Kc == NULL){
+      lprintf("Error: Prescribed values changed, and the coupling to "
+	      "them was not kept\n");
+      free_vector(g);
+      return 1;
+    }
+    for (k=Kc->rowptr[c]; k<Kc->rowptr[c+1] && Kc->cols[k] < sol->U->n; k++)
+      sol->F0->array[Kc->cols[k]] -= Kc->vals[k]*dg;
+    sol->G->array[c] = g->array[c];
+    nchanged++;
+  }
+  if (nchanged > 0)
+    lprintf("Updated %d prescribed values\n", nchanged);
+  free_vector(g);
+  return 0;
+}
+
+
+int resolve_static_soln(struct model* running_model,
+			struct static_soln* sol){
+  // Solves for the current nodal forces and prescribed values with the
+  // kept factors.  The mesh and the constrained dof must be those of the
+  // factorization.  Returns 1 if they no longer match it.
+  struct essential_bc* ebc;
+  struct vector* F;
+  int i;
+  if (sol->LU == NULL){
+    lprintf("Error: Solution has no factorization to reuse\n");
+    return 1;
+  }
+  if (running_model->nodes->nitems != sol->ID->nrows ||
+      running_model->free_dof != sol->LU->nrows){
+    lprintf("Error: Mesh or constraints changed since the factorization\n");
+    return 1;
+  }
+  for (i=0; i<running_model->essential_bcs->nitems; i++){
+    ebc = running_model->essential_bcs->array[i];
+    if (sol->ID->array[ebc->node_id][ebc->dof] != -1){
+      lprintf("Error: Mesh or constraints changed since the "
+	     "factorization\n");
+      return 1;
+    }
+  }
+  if (update_prescribed(running_model, sol) != 0)
+    return 1;
+  F = copy_vector(sol->F0);
   construct_F(running_model->nodes, running_model->nodal_forces,
-	      ID, F, running_model->ndof);
-  printf("Force vector:\n"), print_vector(F);
-  gaussLSS(K, F);  // Reduces F to U
+	      sol->ID, F, sol->ndof);
+  lprintf("Force vector:\n"), print_vector(F);
+  luLSS(sol->LU, F);
+  // Written in place, U may be in a checkpoint mapping
+  memcpy(sol->U->array, F->array, F->n*sizeof(double));
+  free_vector(F);
+  lprintf("Solution vector:\n"), print_vector(sol->U);
+  return 0;
+}
+
+
+void construct_nodal_values(struct model* running_model,
+			    struct static_soln* sol, double* u){
+  // Solved and prescribed values, node major.  The prescribed values
+  // are those the solution was found with, whatever D and DDELE did since.
+  int ndof = sol->ndof, i, j, P;
+  for (i=0; i<sol->ID->nrows; i++){
+    for (j=0; j<ndof; j++){
+      P = sol->ID->array[i][j];
+      if (P == -1)
+	u[ndof*i+j] = sol->G->array[(int) sol->CID->array[i][j]];
+      else
+	u[ndof*i+j] = sol->U->array[P];
+    }
+  }
+}
+
+
+static void element_reactions(struct model* running_model,
+			      struct static_soln* sol, double* u, double* R){
+  // Element forces KE*ue, less superelement interior loads, gathered at
+  // the constrained dof
+  struct element* e;
+  struct et_def* et;
+  struct matrix *COORDS, *KE;
+  struct vector* FS;
+  double *ue, *r;
+  int ndof = sol->ndof, i, j, a, b, n;
+  for (i=0; i<running_model->elements->nitems; i++){
+    e = running_model->elements->array[i];
+    et = get_et_def(running_model->et_defs, e->et_id);
+    n = et->nenodes*ndof;
+    ue = malloc(n*sizeof(double));
+    for (a=0; a<et->nenodes; a++){
+      for (j=0; j<ndof; j++)
+	ue[ndof*a+j] = u[ndof*e->IEN[a]+j];
+    }
+    COORDS = construct_COORDS(running_model->nodes, e->IEN, et->nenodes);
+    KE = select_KE_kernel(et)(et, COORDS);
+    FS = et->sedata != NULL ? Superelement_FE(et->sedata, COORDS) : NULL;
+    for (a=0; a<n; a++){
+      if (sol->ID->array[e->IEN[a/ndof]][a%ndof] != -1)
+	continue;
+      r = &R[ndof*e->IEN[a/ndof]+a%ndof];
+      for (b=0; b<n; b++)
+	*r += KE->array[a][b]*ue[b];
+      if (FS != NULL)
+	*r -= FS->array[a];
+    }
+    free_matrix(KE), free_matrix(COORDS), free(ue);
+    if (FS != NULL)
+      free_vector(FS);
+  }
+}
+
+
+int construct_reactions(struct model* running_model,
+			struct static_soln* sol, double* u, double* R){
+  // R, zero on free dof, receives the support reactions for the nodal
+  // values u.  The kept K_cf and K_cc give them with one product,
+  // otherwise every element stiffness is formed again.  Under BCMODE 1
+  // and 2 they are the kept constraint forces.  Returns 1 when the
+  // solution has none.
+  struct csr_matrix* Kc = sol->Kc;
+  struct essential_bc* ebc;
+  int ndof = sol->ndof, nfree = sol->U->n, i, j, C;
+  double *x, *r;
+  memset(R, 0, ndof*sol->ID->nrows*sizeof(double));
+  if (sol->Rc != NULL){
+    // Already net of the nodal forces
+    for (i=0; i<sol->ID->nrows; i++){
+      for (j=0; j<ndof; j++){
+	C = sol->CID->array[i][j];
+	if (C != -1)
+	  R[ndof*i+j] = sol->Rc->array[C];
+      }
+    }
+    return 0;
+  }
+  for (i=0; i<running_model->essential_bcs->nitems; i++){
+    ebc = running_model->essential_bcs->array[i];
+    if (sol->ID->array[ebc->node_id][ebc->dof] != -1){
+      lprintf("Error: Supports changed since the last solve, or its "
+	      "reactions were not kept\n");
+      return 1;
+    }
+  }
+  if (Kc != NULL){
+    x = malloc((nfree+Kc->nrows)*sizeof(double));
+    r = malloc((Kc->nrows > 0 ? Kc->nrows : 1)*sizeof(double));
+    memcpy(x, sol->U->array, nfree*sizeof(double));
+    for (i=0; i<sol->ID->nrows; i++){
+      for (j=0; j<ndof; j++){
+	C = sol->CID->array[i][j];
+	if (C != -1)
+	  x[nfree+C] = u[ndof*i+j];
+      }
+    }
+    csr_mvmult(Kc, x, r);
+    for (i=0; i<sol->ID->nrows; i++){
+      for (j=0; j<ndof; j++){
+	C = sol->CID->array[i][j];
+	if (C != -1)
+	  R[ndof*i+j] = r[C] - sol->Fc->array[C];
+      }
+    }
+    free(x), free(r);
+  }
+  else
+    element_reactions(running_model, sol, u, R);
+  for (i=0; i<sol->ID->nrows; i++){
+    for (j=0; j<ndof; j++){
+      if (sol->ID->array[i][j] == -1)
+	R[ndof*i+j] -= get_nodal_force(running_model->nodal_forces, i, j);
+    }
+  }
+  return 0;
+}
+
+
+static struct vector* refine_solution(struct matrix* K, struct vector* F){
+  // Iterative refinement of a single precision solve.  Residuals are
+  // computed against the double precision K, so the solution converges
+  // to double precision accuracy for reasonably conditioned K.
+  // Returns NULL when the refinement stalls.
+  struct fmatrix* Ks = single_matrix(K);
+  struct vector *U, *R, *KU;
+  double Knorm, rnorm, rnorm_old = HUGE_VAL;
+  int i, step;
+  if (sluMFA(Ks) != 0){
+    lprintf("Single precision factorization broke down\n");
+    free_fmatrix(Ks);
+    return NULL;
+  }
+  Knorm = mnorm_inf(K);
+  U = new_vector(F->n);
+  R = copy_vector(F);
+  for (step=1; step<=MAXREFINE; step++){
+    sluLSS(Ks, R);  // Correction
+    for (i=0; i<U->n; i++)
+      U->array[i] += R->array[i];
+    KU = mvmult(K, U);
+    for (i=0; i<U->n; i++)
+      R->array[i] = F->array[i] - KU->array[i];
+    free_vector(KU);
+    rnorm = vnorm_inf(R);
+    lprintf("Refinement step %d: residual norm %g\n", step, rnorm);
+    if (rnorm <= vnorm_inf(U)*Knorm*DBL_EPSILON*sqrt(U->n))
+      break;
+    if (!isfinite(rnorm) || rnorm > STALL_RATIO*rnorm_old){
+      step = MAXREFINE+1;
+      break;
+    }
+    rnorm_old = rnorm;
+  }
+  free_fmatrix(Ks), free_vector(R);
+  if (step > MAXREFINE){
+    free_vector(U);
+    return NULL;
+  }
+  lprintf("Converged to double precision in %d refinement steps\n", step);
+  return U;
+}
+
+
+struct static_soln* mixed_static_solver(struct model* running_model){
+  struct matrix* ID = new_matrix(running_model->nodes->nitems,
+				running_model->ndof);
+  struct matrix* K = new_matrix(running_model->free_dof,
+				running_model->free_dof);
+  struct vector* F = new_vector(running_model->free_dof);
+  struct vector* U;
+  assemble_dense_system(running_model, ID, K, F, NULL, NULL);
+  U = refine_solution(K, F);
+  if (U == NULL){
+    lprintf("Refinement stalled, falling back to double precision\n");
+    U = F, F = NULL;
+    if (luMFA(K) != 0){
+      lprintf("Error: Zero pivot in the dense factorization\n");
+      free_matrix(ID), free_matrix(K), free_vector(U);
+      return NULL;
+    }
+    luLSS(K, U);
+  }
   free_matrix(K);
-  printf("Solution vector:\n"), print_vector(F);
-  return new_static_soln(running_model->ndof, ID, F);
+  if (F != NULL)
+    free_vector(F);
+  lprintf("Solution vector:\n"), print_vector(U);
+  return new_static_soln(running_model->ndof, ID, U);
+}
+
+
+struct static_soln* skyline_static_solver(struct model* running_model){
+  // Sparse assembly, factored as LDL^T in skyline storage
+  int ndof = running_model->ndof, free_dof = running_model->free_dof;
+  struct matrix* ID = new_matrix(running_model->nodes->nitems, ndof);
+  struct aol_matrix* Ks = new_aol_matrix(free_dof, free_dof);
+  struct vector* F = new_vector(free_dof);
+  struct csr_matrix* K;
+  struct skyline_matrix* S;
+  struct static_soln* sol;
+  struct coupling* Kc = NULL;
+  struct vector* Rc = NULL;
+  int* first;
+  precomputations(running_model->et_defs);
+  construct_ID(running_model->nodes, ndof,
+	       running_model->bc_mode == BC_ELIMINATE ?
+	       running_model->essential_bcs : NULL,
+	       model_node_order(running_model), ID);
+  lprintf("ID Matrix\n"), print_matrix(ID);
+  // Under BCMODE 1 and 2 the solve gives the reactions instead
+  if (running_model->bc_mode == BC_ELIMINATE)
+    Kc = new_coupling(ID, free_dof);
+  else
+    Rc = new_vector(running_model->essential_bcs->nitems);
+  assemble_K(running_model->nodes, running_model->elements,
+	     running_model->et_defs, ID, NULL, Ks, F,
+	     running_model->essential_bcs, Kc,
+	     model_element_order(running_model));
+  K = aol_to_csr(Ks);
+  free_aol_matrix(Ks);
+  first = construct_profile(running_model->elements, running_model->et_defs,
+			    ID, free_dof);
+  S = new_skyline_matrix(free_dof, first);
+  free(first);
+  skyline_scatter(S, K, S->vals);
+  lprintf("Stiffness matrix: %d equations, %d nonzeros, profile %ld\n",
+	  K->nrows, K->nnz, S->size);
+  free_csr_matrix(K);
+  construct_F(running_model->nodes, running_model->nodal_forces,
+	      ID, F, ndof);
+  lprintf("Force vector:\n"), print_vector(F);
+  if (skyline_solve(S, F, ID, running_model->essential_bcs,
+		    running_model->bc_mode, running_model->bc_scale, Rc) != 0){
+    lprintf("Error: Zero pivot in the sparse factorization\n");
+    free_skyline_matrix(S), free_matrix(ID), free_vector(F);
+    if (Kc != NULL)
+      free_coupling(Kc);
+    if (Rc != NULL)
+      free_vector(Rc);
+    return NULL;
+  }
+  free_skyline_matrix(S);
+  lprintf("Solution vector:\n"), print_vector(F);
+  sol = new_static_soln(ndof, ID, F);
+  if (Kc != NULL)
+    keep_coupling(sol, Kc, running_model->essential_bcs);
+  else
+    keep_constraint_forces(sol, running_model->essential_bcs, Rc);
+  return sol;
+}
+
+
+/***********************************************
+ * Constraints without elimination
+ */
+
+
+int skyline_solve(struct skyline_matrix* S, struct vector* F,
+		  struct matrix* ID, struct list* essential_bcs,
+		  int bc_mode, double bc_scale, struct vector* Rc){
+  // Factors S and overwrites F with the solution.  Under BC_PENALTY and
+  // BC_LAGRANGE the constrained dof have equations in ID and are only
+  // stiffened on the diagonal, so the profile is the same whichever dof
+  // are constrained.  Rc, if not NULL, receives the constraint force on
+  // each essential bc, the support reaction K u - F.  Returns nonzero on
+  // a zero pivot.
+  struct essential_bc* ebc;
+  int nebcs = bc_mode == BC_ELIMINATE ? 0 : essential_bcs->nitems;
+  int* P = malloc((nebcs > 0 ? nebcs : 1)*sizeof(int));
+  double* g = malloc((nebcs > 0 ? nebcs : 1)*sizeof(double));
+  double *lambda = NULL, *F0 = NULL, beta = 0.0, err, ref, d;
+  int i, iter;
+  for (i=0; i<S->n; i++)
+    beta = fmax(beta, fabs(S->vals[S->diag[i]]));
+  if (bc_scale <= 0.0)
+    bc_scale = bc_mode == BC_PENALTY ? PENALTY_SCALE : LAGRANGE_SCALE;
+  beta *= bc_scale;
+  for (i=0; i<nebcs; i++){
+    ebc = essential_bcs->array[i];
+    P[i] = ID->array[ebc->node_id][ebc->dof];
+    g[i] = ebc->value;
+    S->vals[S->diag[P[i]]] += beta;
+  }
+  if (nebcs > 0)
+    lprintf("Constraint stiffness %g on %d dof\n", beta, nebcs);
+  if (ldltMFA(S) != 0){
+    free(P), free(g);
+    return 1;
+  }
+  if (bc_mode == BC_LAGRANGE && nebcs > 0){
+    lambda = calloc(nebcs, sizeof(double));
+    F0 = malloc(S->n*sizeof(double));
+    memcpy(F0, F->array, S->n*sizeof(double));
+  }
+  for (iter=1; ; iter++){
+    for (i=0; i<nebcs; i++)
+      F->array[P[i]] += beta*g[i] - (lambda != NULL ? lambda[i] : 0.0);
+    ldltLSS(S, F);
+    if (lambda == NULL)
+      break;
+    // The multipliers converge to the negated support reactions
+    err = ref = 0.0;
+    for (i=0; i<nebcs; i++){
+      d = F->array[P[i]] - g[i];
+      err = fmax(err, fabs(d));
+      lambda[i] += beta*d;
+    }
+    for (i=0; i<S->n; i++)
+      ref = fmax(ref, fabs(F->array[i]));
+    lprintf("Augmented Lagrange iteration %d: constraint error %g\n",
+	    iter, err);
+    if (err <= BC_TOL*ref)
+      break;
+    if (iter == BC_MAXITER){
+      lprintf("Warning: Constraints did not converge\n");
+      break;
+    }
+    memcpy(F->array, F0, S->n*sizeof(double));
+  }
+  for (i=0; Rc != NULL && i<nebcs; i++)
+    Rc->array[i] = lambda != NULL ? -lambda[i] :
+      -beta*(F->array[P[i]] - g[i]);
+  free(P), free(g), free(lambda), free(F0);
+  return 0;
+}
+
+
+static double* rigid_body_modes(struct list* nodes, struct matrix* ID,
+				int ndof, int free_dof, int* node){
+  // Near null space of the free equations for AMG, row major.  Plane
+  // problems have two translations and the rotation about the centroid,
+  // thermal problems the constant temperature.  node[P] receives the
+  // node of equation P.
+  int nmodes = ndof == 2 ? 3 : 1;
+  double* B = calloc(free_dof*nmodes, sizeof(double));
+  double xc = 0.0, yc = 0.0;
+  struct node* n;
+  int i, j, P;
+  for (i=0; i<nodes->nitems; i++){
+    n = nodes->array[i];
+    xc += n->x/nodes->nitems, yc += n->y/nodes->nitems;
+  }
+  for (i=0; i<nodes->nitems; i++){
+    n = nodes->array[i];
+    for (j=0; j<ndof; j++){
+      P = ID->array[i][j];
+      if (P == -1)
+	continue;
+      node[P] = i;
+      if (ndof == 1)
+	B[P] = 1.0;
+      else{
+	B[P*nmodes+j] = 1.0;
+	B[P*nmodes+2] = j == 0 ? -(n->y-yc) : n->x-xc;
+      }
+    }
+  }
+  return B;
+}
+
+
+struct static_soln* amg_static_solver(struct model* running_model){
+  // Sparse assembly, solved by conjugate gradients with a smoothed
+  // aggregation AMG V-cycle as preconditioner
+  int ndof = running_model->ndof, free_dof = running_model->free_dof;
+  int nnodes = running_model->nodes->nitems, iterations;
+  struct matrix* ID = new_matrix(nnodes, ndof);
+  struct aol_matrix* Ks = new_aol_matrix(free_dof, free_dof);
+  struct vector* F = new_vector(free_dof);
+  struct vector* U = new_vector(free_dof);
+  struct csr_matrix* K;
+  struct amg_hierarchy* H;
+  int* node = malloc((free_dof > 0 ? free_dof : 1)*sizeof(int));
+  double* B;
+  precomputations(running_model->et_defs);
+  construct_ID(running_model->nodes, ndof, running_model->essential_bcs,
+	       model_node_order(running_model), ID);
+  lprintf("ID Matrix\n"), print_matrix(ID);
+  assemble_K(running_model->nodes, running_model->elements,
+	     running_model->et_defs, ID, NULL, Ks, F,
+	     running_model->essential_bcs, NULL,
+	     model_element_order(running_model));
+  K = aol_to_csr(Ks);
+  free_aol_matrix(Ks);
+  lprintf("Stiffness matrix: %d equations, %d nonzeros\n", K->nrows, K->nnz);
+  construct_F(running_model->nodes, running_model->nodal_forces,
+	      ID, F, ndof);
+  lprintf("Force vector:\n"), print_vector(F);
+  B = rigid_body_modes(running_model->nodes, ID, ndof, free_dof, node);
+  H = new_amg_hierarchy(K, node, nnodes, B, ndof == 2 ? 3 : 1);
+  free(node), free(B);
+  iterations = H != NULL ?
+    pcgLSS(K, F, U, amg_vcycle, H, CG_TOL, free_dof+1) : -1;
+  if (H != NULL)
+    free_amg_hierarchy(H);
+  free_csr_matrix(K), free_vector(F);
+  if (iterations < 0){
+    if (H != NULL)
+      lprintf("Error: Conjugate gradients did not converge\n");
+    free_matrix(ID), free_vector(U);
+    return NULL;
+  }
+  lprintf("Conjugate gradients converged in %d iterations\n", iterations);
+  lprintf("Solution vector:\n"), print_vector(U);
+  return new_static_soln(ndof, ID, U);
 }
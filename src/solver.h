@@ -1,8 +1,64 @@
+struct aol_matrix;
+struct csr_matrix;
+struct skyline_matrix;
+
+// Essential boundary condition enforcement
+#define BC_ELIMINATE 0  // Constrained dof left out of the equations
+#define BC_PENALTY 1    // Stiff springs to the prescribed values
+#define BC_LAGRANGE 2   // Augmented Lagrange, penalty with multiplier updates
+
+
 struct static_soln{
   int ndof;
   struct matrix* ID;
   struct vector* U;
+  struct matrix* LU;    // Factored free dof stiffness, NULL if not kept
+  struct vector* F0;    // Load from prescribed values and superelements
+  struct matrix* CID;   // Constrained dof numbers, -1 on free dof
+  struct vector* G;     // Prescribed values of U and F0, by CID
+  struct csr_matrix* Kc;  // K_cf and K_cc, NULL if not kept
+  struct vector* Fc;    // Superelement loads on the constrained dof
+  struct vector* Rc;    // Constraint forces by CID under BCMODE 1 and 2
+  void* map;            // Checkpoint mapping holding U, LU and F0, or NULL
+  size_t map_size;
 };
 
+struct static_soln* new_static_soln(int ndof, struct matrix* ID,
+				    struct vector* U);
 struct static_soln* dense_static_solver(struct model* running_model);
+struct static_soln* mixed_static_solver(struct model* running_model);
+struct static_soln* skyline_static_solver(struct model* running_model);
+struct static_soln* amg_static_solver(struct model* running_model);
+int resolve_static_soln(struct model* running_model,
+			struct static_soln* sol);
+void number_constrained_dof(struct static_soln* sol,
+			    struct list* essential_bcs);
+void construct_nodal_values(struct model* running_model,
+			    struct static_soln* sol, double* u);
+void keep_constraint_forces(struct static_soln* sol,
+			    struct list* essential_bcs, struct vector* Rc);
+int constrained_dof(struct static_soln* sol, int node, int dof);
+int construct_reactions(struct model* running_model,
+			struct static_soln* sol, double* u, double* R);
 void free_static_soln(struct static_soln* sol);
+
+// Assembly steps shared with other solution procedures
+int check_et_defs(struct list* et_defs);
+void precomputations(struct list* et_defs);
+void construct_ID(struct list* nodes, int ndof,
+		  struct list* essential_bcs, int* order, struct matrix* ID);
+void construct_K(struct list* nodes, struct list* elements,
+		 struct list* et_defs, struct matrix* ID,
+		 struct matrix* K, struct vector* F, int free_dof,
+		 struct list* essential_bcs);
+void construct_sparse_K(struct list* nodes, struct list* elements,
+			struct list* et_defs, struct matrix* ID,
+			struct aol_matrix* K, struct vector* F,
+			struct list* essential_bcs);
+void construct_F(struct list* nodes, struct list* nodal_forces,
+		 struct matrix* ID, struct vector* F, int ndof);
+int* construct_profile(struct list* elements, struct list* et_defs,
+		       struct matrix* ID, int free_dof);
+int skyline_solve(struct skyline_matrix* S, struct vector* F,
+		  struct matrix* ID, struct list* essential_bcs,
+		  int bc_mode, double bc_scale, struct vector* Rc);
@@ -0,0 +1,490 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "lib/log.h"
+#include "lib/list.h"
+#include "lib/linalg.h"
+#include "mesh.h"
+#include "element_types.h"
+#include "shape.h"
+#include "spatial.h"
+
+
+/***********************************************
+ * Uniform grids
+ */
+
+
+static struct grid* new_grid(double* boxes, int n){
+  // Bins n boxes {xmin, xmax, ymin, ymax} into every cell they overlap.
+  // Empty boxes (xmin > xmax) are left out.
+  struct grid* g = malloc(sizeof(struct grid));
+  double xmin = HUGE_VAL, xmax = -HUGE_VAL, ymin = HUGE_VAL, ymax = -HUGE_VAL;
+  double* b;
+  int i, j, k, c, i0, i1, j0, j1, ncells, pass, nitems = 0;
+  int* count;
+  for (k=0; k<n; k++){
+    b = boxes + 4*k;
+    if (b[0] > b[1])
+      continue;
+    xmin = fmin(xmin, b[0]), xmax = fmax(xmax, b[1]);
+    ymin = fmin(ymin, b[2]), ymax = fmax(ymax, b[3]);
+    nitems++;
+  }
+  if (nitems == 0)
+    xmin = xmax = ymin = ymax = 0.0;
+  g->x0 = xmin, g->y0 = ymin;
+  g->h = fmax(xmax-xmin, ymax-ymin)/sqrt(nitems > 0 ? nitems : 1);
+  if (g->h <= 0.0)
+    g->h = 1.0;
+  g->nx = (int) ((xmax-xmin)/g->h) + 1;
+  g->ny = (int) ((ymax-ymin)/g->h) + 1;
+  ncells = g->nx*g->ny;
+  count = calloc(ncells+1, sizeof(int));
+  // Two passes, counting and then filling the cells
+  for (pass=0; pass<2; pass++){
+    for (k=0; k<n; k++){
+      b = boxes + 4*k;
+      if (b[0] > b[1])
+	continue;
+      i0 = (b[0]-g->x0)/g->h, i1 = (b[1]-g->x0)/g->h;
+      j0 = (b[2]-g->y0)/g->h, j1 = (b[3]-g->y0)/g->h;
+      i1 = i1 < g->nx ? i1 : g->nx-1, j1 = j1 < g->ny ? j1 : g->ny-1;
+      for (j=j0; j<=j1; j++){
+	for (i=i0; i<=i1; i++){
+	  c = i + g->nx*j;
+	  if (pass == 0)
+	    count[c+1]++;
+	  else
+	    g->items[count[c]++] = k;
+	}
+      }
+    }
+    if (pass == 0){
+      for (c=0; c<ncells; c++)
+	count[c+1] += count[c];
+      g->start = malloc((ncells+1)*sizeof(int));
+      memcpy(g->start, count, (ncells+1)*sizeof(int));
+      g->items = malloc((count[ncells] > 0 ? count[ncells] : 1)*sizeof(int));
+    }
+  }
+  free(count);
+  return g;
+}
+
+
+static void free_grid(struct grid* g){
+  free(g->start), free(g->items);
+  free(g);
+}
+
+
+static int cell_index(struct grid* g, double v, double v0, int nv){
+  // Clamped to the grid
+  double c = floor((v-v0)/g->h);
+  return c < 0 ? 0 : c >= nv ? nv-1 : (int) c;
+}
+
+
+/***********************************************
+ * Index
+ */
+
+
+struct spatial_index* new_spatial_index(struct list* nodes,
+					struct list* elements){
+  struct spatial_index* si = malloc(sizeof(struct spatial_index));
+  double* boxes = malloc((nodes->nitems > 0 ? 4*nodes->nitems : 1)*
+			 sizeof(double));
+  struct node* nd;
+  int i;
+  for (i=0; i<nodes->nitems; i++){
+    nd = nodes->array[i];
+    boxes[4*i] = boxes[4*i+1] = nd->x;
+    boxes[4*i+2] = boxes[4*i+3] = nd->y;
+  }
+  si->nnodes = nodes->nitems;
+  si->nelems = elements->nitems;
+  si->nodes = new_grid(boxes, nodes->nitems);
+  si->elements = NULL;
+  si->boxes = NULL;
+  free(boxes);
+  lprintf("Indexed %d nodes in a %d x %d grid\n", si->nnodes,
+	  si->nodes->nx, si->nodes->ny);
+  return si;
+}
+
+
+void free_spatial_index(struct spatial_index* si){
+  free_grid(si->nodes);
+  if (si->elements != NULL)
+    free_grid(si->elements), free(si->boxes);
+  free(si);
+}
+
+
+static int compare_ids(const void* a, const void* b){
+  return *(const int*) a - *(const int*) b;
+}
+
+
+int select_box(struct spatial_index* si, struct list* nodes, double xmin,
+	       double xmax, double ymin, double ymax, int* ids){
+  // Fills ids, of room for every node, with the nodes in the closed box.
+  // Returns their number.
+  struct grid* g = si->nodes;
+  struct node* nd;
+  int i, j, k, n = 0;
+  if (xmin > xmax || ymin > ymax)
+    return 0;
+  for (j=cell_index(g, ymin, g->y0, g->ny);
+       j<=cell_index(g, ymax, g->y0, g->ny); j++){
+    for (i=cell_index(g, xmin, g->x0, g->nx);
+	 i<=cell_index(g, xmax, g->x0, g->nx); i++){
+      for (k=g->start[i+g->nx*j]; k<g->start[i+g->nx*j+1]; k++){
+	nd = nodes->array[g->items[k]];
+	if (nd->x >= xmin && nd->x <= xmax && nd->y >= ymin && nd->y <= ymax)
+	  ids[n++] = g->items[k];
+      }
+    }
+  }
+  qsort(ids, n, sizeof(int), compare_ids);
+  return n;
+}
+
+
+int select_line(struct spatial_index* si, struct list* nodes, double x1,
+		double y1, double x2, double y2, double tol, int* ids){
+  // Nodes within tol of the segment from (x1, y1) to (x2, y2)
+  struct node* nd;
+  double dx = x2-x1, dy = y2-y1, L2 = dx*dx + dy*dy, t, ex, ey;
+  int i, m = 0;
+  int n = select_box(si, nodes, fmin(x1, x2)-tol, fmax(x1, x2)+tol,
+		     fmin(y1, y2)-tol, fmax(y1, y2)+tol, ids);
+  for (i=0; i<n; i++){
+    nd = nodes->array[ids[i]];
+    t = L2 > 0.0 ? ((nd->x-x1)*dx + (nd->y-y1)*dy)/L2 : 0.0;
+    t = t < 0.0 ? 0.0 : t > 1.0 ? 1.0 : t;
+    ex = nd->x - (x1 + t*dx), ey = nd->y - (y1 + t*dy);
+    if (ex*ex + ey*ey <= tol*tol)
+      ids[m++] = ids[i];
+  }
+  return m;
+}
+
+
+int select_nearest(struct spatial_index* si, struct list* nodes,
+		   double x, double y){
+  // Searches rings of cells around the cell of the point until no cell
+  // further out can hold a closer node.  Returns -1 for an empty mesh.
+  struct grid* g = si->nodes;
+  struct node* nd;
+  int ci = cell_index(g, x, g->x0, g->nx);
+  int cj = cell_index(g, y, g->y0, g->ny);
+  int r, i, j, k, best = -1;
+  double d, dmin = HUGE_VAL;
+  for (r=0; r <= g->nx || r <= g->ny; r++){
+    for (j=cj-r; j<=cj+r; j++){
+      for (i=ci-r; i<=ci+r; i++){
+	if (i < 0 || j < 0 || i >= g->nx || j >= g->ny ||
+	    (abs(i-ci) != r && abs(j-cj) != r))
+	  continue;
+	for (k=g->start[i+g->nx*j]; k<g->start[i+g->nx*j+1]; k++){
+	  nd = nodes->array[g->items[k]];
+	  d = (nd->x-x)*(nd->x-x) + (nd->y-y)*(nd->y-y);
+	  if (d < dmin || (d == dmin && g->items[k] < best))
+	    dmin = d, best = g->items[k];
+	}
+      }
+    }
+    // Cells beyond ring r are at least r*h away
+    if (best != -1 && dmin <= (r*g->h)*(r*g->h))
+      break;
+  }
+  return best;
+}
+
+
+static void index_elements(struct spatial_index* si, struct list* nodes,
+			   struct list* elements, struct list* et_defs){
+  // Bounding boxes of the plane elements, which are the ones a point
+  // can be located in
+  struct element* e;
+  struct et_def* et;
+  struct node* nd;
+  double* b;
+  int i, a;
+  si->boxes = malloc((elements->nitems > 0 ? 4*elements->nitems : 1)*
+		     sizeof(double));
+  for (i=0; i<elements->nitems; i++){
+    e = elements->array[i];
+    et = get_et_def(et_defs, e->et_id);
+    b = si->boxes + 4*i;
+    b[0] = b[2] = HUGE_VAL, b[1] = b[3] = -HUGE_VAL;
+    if (!integrated_element(et->lib_id))
+      continue;
+    for (a=0; a<et->nenodes; a++){
+      nd = nodes->array[e->IEN[a]];
+      b[0] = fmin(b[0], nd->x), b[1] = fmax(b[1], nd->x);
+      b[2] = fmin(b[2], nd->y), b[3] = fmax(b[3], nd->y);
+    }
+  }
+  si->elements = new_grid(si->boxes, elements->nitems);
+}
+
+
+int find_element(struct spatial_index* si, struct list* nodes,
+		 struct list* elements, struct list* et_defs,
+		 double x, double y, struct vector** N){
+  // Returns the lowest numbered plane element holding the point, with
+  // its shape function values there in N, or -1.  The items of a cell
+  // are in element order.
+  struct grid* g;
+  struct element* e;
+  struct et_def* et;
+  struct matrix* COORDS;
+  double* b;
+  int c, k, i;
+  if (si->elements == NULL)
+    index_elements(si, nodes, elements, et_defs);
+  g = si->elements;
+  *N = NULL;
+  c = cell_index(g, x, g->x0, g->nx) + g->nx*cell_index(g, y, g->y0, g->ny);
+  for (k=g->start[c]; k<g->start[c+1]; k++){
+    i = g->items[k];
+    b = si->boxes + 4*i;
+    if (x < b[0] || x > b[1] || y < b[2] || y > b[3])
+      continue;
+    e = elements->array[i];
+    et = get_et_def(et_defs, e->et_id);
+    COORDS = construct_COORDS(nodes, e->IEN, et->nenodes);
+    *N = locate_point(et->lib_id, COORDS, x, y);
+    free_matrix(COORDS);
+    if (*N != NULL)
+      return i;
+  }
+  return -1;
+}
+
+
+/***********************************************
+ * Coincident nodes
+ */
+
+
+static int cell_slot(long long* cells, int* heads, int size, long long i,
+		     long long j){
+  // Slot holding cell (i, j), or the empty slot ending its probe
+  unsigned int h = (unsigned int) i*73856093u ^ (unsigned int) j*19349663u;
+  int s = h & (size-1);
+  while (heads[s] != -1 && (cells[2*s] != i || cells[2*s+1] != j))
+    s = (s+1) & (size-1);
+  return s;
+}
+
+
+int merge_nodes(struct list* nodes, double tol, int* map){
+  // Merges each node within tol of a kept node into the lowest numbered
+  // such node, and keeps the others.  Kept nodes are hashed by cells of
+  // size tol, so a node only meets those in the 3 x 3 cells around it,
+  // and cells need no grid over the bounding box.  Fills map with the
+  // new id of every old node, compacts the list in order and returns the
+  // number of nodes merged.
+  struct node *nd, *kept;
+  long long* cells;
+  int *heads, *next;
+  long long ci, cj;
+  int n = nodes->nitems, size = 1, i, k, di, dj, s, rep, m = 0;
+  while (size < 2*n)
+    size *= 2;
+  cells = malloc(2*size*sizeof(long long));
+  heads = malloc(size*sizeof(int));
+  next = malloc((n > 0 ? n : 1)*sizeof(int));
+  for (s=0; s<size; s++)
+    heads[s] = -1;
+  for (i=0; i<n; i++){
+    nd = nodes->array[i];
+    ci = (long long) floor(nd->x/tol), cj = (long long) floor(nd->y/tol);
+    rep = -1;
+    for (dj=-1; dj<=1; dj++){
+      for (di=-1; di<=1; di++){
+	s = cell_slot(cells, heads, size, ci+di, cj+dj);
+	for (k=heads[s]; k != -1; k=next[k]){
+	  // Kept node k already sits at its new place
+	  kept = nodes->array[map[k]];
+	  if ((rep == -1 || k < rep) &&
+	      hypot(kept->x - nd->x, kept->y - nd->y) <= tol)
+	    rep = k;
+	}
+      }
+    }
+    if (rep != -1){
+      map[i] = map[rep];
+      free(nd);
+      continue;
+    }
+    s = cell_slot(cells, heads, size, ci, cj);
+    cells[2*s] = ci, cells[2*s+1] = cj;
+    next[i] = heads[s];
+    heads[s] = i;
+    map[i] = m;
+    nodes->array[m++] = nd;
+  }
+  nodes->nitems = m;
+  free(cells), free(heads), free(next);
+  return n-m;
+}
+
+
+/***********************************************
+ * Space filling curves
+ */
+
+
+static unsigned int morton_key(unsigned int x, unsigned int y){
+  // Bits of x and y interleaved
+  unsigned int key = 0;
+  int b;
+  for (b=0; b<CURVE_BITS; b++)
+    key |= (x >> b & 1) << 2*b | (y >> b & 1) << (2*b+1);
+  return key;
+}
+
+
+static unsigned int hilbert_key(unsigned int x, unsigned int y){
+  // Distance along the Hilbert curve through the 2^CURVE_BITS square
+  unsigned int n = 1u << CURVE_BITS, s, rx, ry, t, key = 0;
+  for (s=n/2; s>0; s/=2){
+    rx = (x & s) > 0;
+    ry = (y & s) > 0;
+    key += s*s*((3*rx) ^ ry);
+    // Rotate the quadrant into the orientation of the whole curve
+    if (ry == 0){
+      if (rx == 1)
+	x = n-1 - x, y = n-1 - y;
+      t = x, x = y, y = t;
+    }
+  }
+  return key;
+}
+
+
+struct curve_item{
+  unsigned int key;
+  int id;
+};
+
+
+static int compare_keys(const void* a, const void* b){
+  const struct curve_item *p = a, *q = b;
+  if (p->key != q->key)
+    return p->key < q->key ? -1 : 1;
+  return p->id - q->id;
+}
+
+
+static int* curve_order(double* xy, int n, int curve){
+  // Ids of the n points sorted along the curve.  The points are scaled
+  // into a square over their bounding box, keeping the aspect ratio.
+  struct curve_item* items = malloc((n > 0 ? n : 1)*sizeof(struct curve_item));
+  int* order = malloc((n > 0 ? n : 1)*sizeof(int));
+  double xmin = HUGE_VAL, xmax = -HUGE_VAL, ymin = HUGE_VAL, ymax = -HUGE_VAL;
+  double scale;
+  unsigned int x, y;
+  int i;
+  for (i=0; i<n; i++){
+    xmin = fmin(xmin, xy[2*i]), xmax = fmax(xmax, xy[2*i]);
+    ymin = fmin(ymin, xy[2*i+1]), ymax = fmax(ymax, xy[2*i+1]);
+  }
+  scale = fmax(xmax-xmin, ymax-ymin);
+  scale = scale > 0.0 ? ((1u << CURVE_BITS) - 1)/scale : 0.0;
+  for (i=0; i<n; i++){
+    x = (xy[2*i]-xmin)*scale, y = (xy[2*i+1]-ymin)*scale;
+    items[i].key = curve == CURVE_MORTON ? morton_key(x, y) :
+      hilbert_key(x, y);
+    items[i].id = i;
+  }
+  qsort(items, n, sizeof(struct curve_item), compare_keys);
+  for (i=0; i<n; i++)
+    order[i] = items[i].id;
+  free(items);
+  return order;
+}
+
+
+struct mesh_order* new_mesh_order(struct list* nodes, struct list* elements,
+				  struct list* et_defs, int curve){
+  // Nodes by their coordinates, elements by their centroids
+  struct mesh_order* mo = malloc(sizeof(struct mesh_order));
+  int n = nodes->nitems > elements->nitems ? nodes->nitems :
+    elements->nitems;
+  double* xy = malloc((n > 0 ? 2*n : 1)*sizeof(double));
+  struct element* e;
+  struct et_def* et;
+  struct node* nd;
+  int i, a;
+  for (i=0; i<nodes->nitems; i++){
+    nd = nodes->array[i];
+    xy[2*i] = nd->x, xy[2*i+1] = nd->y;
+  }
+  mo->curve = curve;
+  mo->nnodes = nodes->nitems;
+  mo->nodes = curve_order(xy, nodes->nitems, curve);
+  for (i=0; i<elements->nitems; i++){
+    e = elements->array[i];
+    et = get_et_def(et_defs, e->et_id);
+    xy[2*i] = xy[2*i+1] = 0.0;
+    for (a=0; a<et->nenodes; a++){
+      nd = nodes->array[e->IEN[a]];
+      xy[2*i] += nd->x/et->nenodes, xy[2*i+1] += nd->y/et->nenodes;
+    }
+  }
+  mo->nelems = elements->nitems;
+  mo->elements = curve_order(xy, elements->nitems, curve);
+  free(xy);
+  return mo;
+}
+
+
+void free_mesh_order(struct mesh_order* mo){
+  free(mo->nodes), free(mo->elements);
+  free(mo);
+}
+
+
+/***********************************************
+ * Node sets
+ */
+
+
+struct node_set* new_node_set(char* name, int n, int* ids){
+  struct node_set* set = malloc(sizeof(struct node_set));
+  set->name = malloc(strlen(name)+1);
+  strcpy(set->name, name);
+  set->n = n;
+  set->ids = malloc((n > 0 ? n : 1)*sizeof(int));
+  memcpy(set->ids, ids, n*sizeof(int));
+  return set;
+}
+
+
+void free_node_set(void* set){
+  struct node_set* s = set;
+  free(s->name), free(s->ids);
+  free(s);
+}
+
+
+void renumber_node_set(struct node_set* set, int* map){
+  // Merged nodes appear once
+  int i, n = 0;
+  for (i=0; i<set->n; i++)
+    set->ids[i] = map[set->ids[i]];
+  qsort(set->ids, set->n, sizeof(int), compare_ids);
+  for (i=0; i<set->n; i++){
+    if (n == 0 || set->ids[i] != set->ids[n-1])
+      set->ids[n++] = set->ids[i];
+  }
+  set->n = n;
+}
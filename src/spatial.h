@@ -0,0 +1,76 @@
+/*
+Spatial index over the mesh, for selecting nodes by location and for
+finding the element under a point.  Nodes, and the bounding boxes of
+the plane elements, are binned in uniform grids of about one item per
+cell, so a query only visits the cells it overlaps.  The index is built
+on first use and rebuilt when the mesh has grown since.
+
+Coincident nodes are found by hashing the nodes into cells of the merge
+tolerance, in expected linear time.
+
+A mesh order lists the nodes and elements along a Morton (Z order) or
+Hilbert curve through the mesh.  Numbering the equations and assembling
+the elements in that order keeps neighbours close together in memory
+and in the stiffness matrix, whatever order the mesh was input in.
+*/
+
+#define CURVE_NONE 0
+#define CURVE_MORTON 1
+#define CURVE_HILBERT 2
+#define CURVE_BITS 16     // Curve resolution per axis
+
+
+struct grid{
+  double x0, y0;
+  double h;         // Cell size
+  int nx, ny;
+  int* start;       // Cell c = i+nx*j holds items[start[c]] onwards
+  int* items;
+};
+
+
+struct spatial_index{
+  int nnodes;
+  int nelems;
+  struct grid* nodes;
+  struct grid* elements;  // Built on the first point probe
+  double* boxes;          // xmin, xmax, ymin, ymax of each element
+};
+
+
+struct mesh_order{
+  int curve;
+  int nnodes;
+  int nelems;
+  int* nodes;       // Input node id at each position along the curve
+  int* elements;    // Input element id at each position
+};
+
+
+// Named node selection, for D and F
+struct node_set{
+  char* name;
+  int n;
+  int* ids;         // Ascending
+};
+
+
+struct spatial_index* new_spatial_index(struct list* nodes,
+					struct list* elements);
+void free_spatial_index(struct spatial_index* si);
+int select_box(struct spatial_index* si, struct list* nodes, double xmin,
+	       double xmax, double ymin, double ymax, int* ids);
+int select_line(struct spatial_index* si, struct list* nodes, double x1,
+		double y1, double x2, double y2, double tol, int* ids);
+int select_nearest(struct spatial_index* si, struct list* nodes,
+		   double x, double y);
+int find_element(struct spatial_index* si, struct list* nodes,
+		 struct list* elements, struct list* et_defs,
+		 double x, double y, struct vector** N);
+struct mesh_order* new_mesh_order(struct list* nodes, struct list* elements,
+				  struct list* et_defs, int curve);
+void free_mesh_order(struct mesh_order* mo);
+int merge_nodes(struct list* nodes, double tol, int* map);
+struct node_set* new_node_set(char* name, int n, int* ids);
+void free_node_set(void* set);
+void renumber_node_set(struct node_set* set, int* map);
@@ -6,11 +6,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include "lib/log.h"
 #include "lib/list.h"
 #include "lib/linalg.h"
 #include "mesh.h"
 #include "element_types.h"
 #include "shape.h"
+#include "superelement.h"
+#include "stiffness.h"
 
 
 /***********************************************************
@@ -61,9 +64,8 @@ static struct matrix* D_structural(struct et_def* et){
     cmmult(D, E/((1.0+v)*(1.0-2.0*v)));
   }
   else{
-    printf("KeyError: Bad key option: %d.  Failed to construct D.\n",
+    lprintf("Error: Bad key option: %d.  Failed to construct D.\n",
 	   et->opts[1]);
-    exit(1);
   }
   return D;
 }
@@ -87,7 +89,7 @@ struct matrix* construct_D(struct et_def* et){
   else if (et->lib_id >= 10 && et->lib_id < 20)
     return D_thermal(et);
 
-  printf("Error: Invalid library id\n");
+  lprintf("Error: Invalid library id\n");
   return NULL;
 }
 
@@ -103,7 +105,7 @@ static struct matrix* Bi_thermal(int i, struct matrix* NDERGLB){
   // Bi = grad(Ni) = { {Na,x}, {Na,y} }
   struct matrix* Bi = new_matrix(2, 1);
   Bi->array[0][0] = NDERGLB->array[i][0];
-  Bi->array[1][0] = NDERGLB->array[i][0];
+  Bi->array[1][0] = NDERGLB->array[i][1];
   return Bi;
 }
 
@@ -172,7 +174,7 @@ Isoparametric_KE(struct et_def* et, struct matrix* COORDS, int ndof,
   struct matrix* KE = new_matrix(et->ndof*et->nenodes, et->ndof*et->nenodes);
   struct matrix* D = et->sdata->D;
   struct matrix* NDERGLB;
-  printf("Constitutive matrix:\n"), print_matrix(D);
+  lprintf("Constitutive matrix:\n"), print_matrix(D);
   int i, j, k;
   double w, jacob;
   for (k=0; k<et->sdata->nint_pts; k++){
@@ -201,27 +203,180 @@ Isoparametric_KE(struct et_def* et, struct matrix* COORDS, int ndof,
 
 
 
+struct matrix* Affine_KE(struct et_def* et, struct matrix* COORDS){
+  // Fast path for elements with a constant Jacobian J.  The global
+  // derivative integrals are
+  //     G[p][q] = int Na,p*Nb,q dA = det(J)*sum_ij Ji[i][p]*Ji[j][q]*H[i][j]
+  // with Ji = inv(J) and H from construct_H, and KE follows from G and D
+  // directly.  Returns NULL when the element is not affine.
+  if (et->sdata->H == NULL || !affine_element(et->lib_id, COORDS))
+    return NULL;
+  int n = et->nenodes, ndof = et->ndof;
+  struct matrix* KE = new_matrix(ndof*n, ndof*n);
+  double** X = COORDS->array;
+  double** dN = ((struct matrix*) et->sdata->NDERNATs->array[0])->array;
+  double** D = et->sdata->D->array;
+  double J[2][2] = {{0.0}}, Ji[2][2], det, G[2][2];
+  const double* h;
+  int a, b, i, j, p, q;
+  for (a=0; a<n; a++){
+    for (i=0; i<2; i++){
+      J[0][i] += X[0][a]*dN[a][i];
+      J[1][i] += X[1][a]*dN[a][i];
+    }
+  }
+  det = J[0][0]*J[1][1] - J[1][0]*J[0][1];
+  Ji[0][0] = J[1][1]/det, Ji[0][1] = -J[0][1]/det;
+  Ji[1][0] = -J[1][0]/det, Ji[1][1] = J[0][0]/det;
+  det *= et->consts[1];  // Thickness
+  for (a=0; a<n; a++){
+    for (b=0; b<n; b++){
+      h = &et->sdata->H[(a*n+b)*4];
+      for (p=0; p<2; p++){
+	for (q=0; q<2; q++){
+	  G[p][q] = 0.0;
+	  for (i=0; i<2; i++){
+	    for (j=0; j<2; j++)
+	      G[p][q] += Ji[i][p]*Ji[j][q]*h[2*i+j];
+	  }
+	  G[p][q] *= det;
+	}
+      }
+      if (ndof == 2){
+	// Bi_structural products, D indexed {xx, yy, xy}
+	KE->array[2*a][2*b] = D[0][0]*G[0][0] + D[0][2]*G[0][1] +
+	  D[2][0]*G[1][0] + D[2][2]*G[1][1];
+	KE->array[2*a][2*b+1] = D[0][1]*G[0][1] + D[0][2]*G[0][0] +
+	  D[2][1]*G[1][1] + D[2][2]*G[1][0];
+	KE->array[2*a+1][2*b] = D[1][0]*G[1][0] + D[1][2]*G[1][1] +
+	  D[2][0]*G[0][0] + D[2][2]*G[0][1];
+	KE->array[2*a+1][2*b+1] = D[1][1]*G[1][1] + D[1][2]*G[1][0] +
+	  D[2][1]*G[0][1] + D[2][2]*G[0][0];
+      }
+      else
+	KE->array[a][b] = D[0][0]*G[0][0] + D[0][1]*G[0][1] +
+	  D[1][0]*G[1][0] + D[1][1]*G[1][1];
+    }
+  }
+  et->sdata->naffine++;
+  return KE;
+}
+
+
+static struct matrix*
+SPlane_KE(struct et_def* et, struct matrix* COORDS){
+  struct matrix* KE = Affine_KE(et, COORDS);
+  if (KE != NULL)
+    return KE;
+  KE = Isoparametric_KE(et, COORDS, 2, Bi_structural);
+  cmmult(KE, et->consts[1]);  // Thickness
+  return KE;
+}
+
+
+static struct matrix*
+TPlane_KE(struct et_def* et, struct matrix* COORDS){
+  struct matrix* KE = Affine_KE(et, COORDS);
+  if (KE != NULL)
+    return KE;
+  KE = Isoparametric_KE(et, COORDS, 1, Bi_thermal);
+  cmmult(KE, et->consts[1]);  // Thickness
+  return KE;
+}
+
+
+static double
+Tri3_gradients(struct matrix* COORDS, double b[3], double c[3]){
+  // Constant shape function gradients of the linear triangle,
+  // Ni,x = b[i]/(2A) and Ni,y = c[i]/(2A).  Returns the area A.
+  double** X = COORDS->array;
+  int i, j, k;
+  for (i=0; i<3; i++){
+    j = (i+1)%3, k = (i+2)%3;
+    b[i] = X[1][j] - X[1][k];
+    c[i] = X[0][k] - X[0][j];
+  }
+  return 0.5*(b[1]*c[2] - b[2]*c[1]);
+}
+
+
+static struct matrix*
+STri3_KE(struct et_def* et, struct matrix* COORDS){
+  // Constant strain triangle in closed form, KE = t*A*B^T*D*B
+  struct matrix* KE = new_matrix(6, 6);
+  double** D = et->sdata->D->array;
+  double b[3], c[3], r0[3], r1[3], scale;
+  int i, j, m;
+  scale = et->consts[1]/(4.0*fabs(Tri3_gradients(COORDS, b, c)));
+  for (i=0; i<3; i++){
+    for (m=0; m<3; m++){
+      r0[m] = (b[i]*D[0][m] + c[i]*D[2][m])*scale;
+      r1[m] = (c[i]*D[1][m] + b[i]*D[2][m])*scale;
+    }
+    for (j=0; j<3; j++){
+      KE->array[2*i][2*j] = r0[0]*b[j] + r0[2]*c[j];
+      KE->array[2*i][2*j+1] = r0[1]*c[j] + r0[2]*b[j];
+      KE->array[2*i+1][2*j] = r1[0]*b[j] + r1[2]*c[j];
+      KE->array[2*i+1][2*j+1] = r1[1]*c[j] + r1[2]*b[j];
+    }
+  }
+  return KE;
+}
+
+
+static struct matrix*
+TTri3_KE(struct et_def* et, struct matrix* COORDS){
+  // Linear conduction triangle in closed form
+  struct matrix* KE = new_matrix(3, 3);
+  double** D = et->sdata->D->array;
+  double b[3], c[3], scale;
+  int i, j;
+  scale = et->consts[1]/(4.0*fabs(Tri3_gradients(COORDS, b, c)));
+  for (i=0; i<3; i++){
+    for (j=0; j<3; j++)
+      KE->array[i][j] = (b[i]*(D[0][0]*b[j] + D[0][1]*c[j]) +
+			 c[i]*(D[1][0]*b[j] + D[1][1]*c[j]))*scale;
+  }
+  return KE;
+}
+
+
+static struct matrix*
+Super_KE(struct et_def* et, struct matrix* COORDS){
+  return Superelement_KE(et->sedata, COORDS);
+}
+
+
+KE_kernel select_KE_kernel(struct et_def* et){
+  // Dispatch on the library id once per element type rather than
+  // once per element
+  if (et->lib_id == 1)
+    return SBar_KE;
+
+  else if (et->lib_id == 3)
+    return STri3_KE;
+
+  else if (et->lib_id == 13)
+    return TTri3_KE;
+
+  else if (et->lib_id == 4 || et->lib_id == 6 || et->lib_id == 8)
+    return SPlane_KE;
+
+  else if (et->lib_id == 14 || et->lib_id == 16 || et->lib_id == 18)
+    return TPlane_KE;
+
+  else if (et->lib_id == 9 || et->lib_id == 19)
+    return Super_KE;
+
+  lprintf("Error: No stiffness matrix for library id %d\n", et->lib_id);
+  return NULL;
+}
+
+
 struct matrix* construct_KE(struct element* e, struct et_def* et,
 			    struct list* nodes){
-  struct matrix* KE;
   struct matrix* COORDS = construct_COORDS(nodes, e->IEN, et->nenodes);
-  
-  if (et->lib_id == 1)
-    KE = SBar_KE(et, COORDS);
-  
-  else if (et->lib_id == 4){
-    double t = et->consts[1]; // Thickness
-    KE = Isoparametric_KE(et, COORDS, 2, Bi_structural);
-    cmmult(KE, t);
-  }
-  
-  else if (et->lib_id == 14){
-    double t = et->consts[1]; // Thickness
-    KE = Isoparametric_KE(et, COORDS, 1, Bi_thermal);
-    cmmult(KE, t);
-  }
-	
+  struct matrix* KE = select_KE_kernel(et)(et, COORDS);
   free_matrix(COORDS);
-  
   return KE;
 }
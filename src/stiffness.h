@@ -1,3 +1,7 @@
+typedef struct matrix* (*KE_kernel)(struct et_def* et, struct matrix* COORDS);
+
 struct matrix* construct_D(struct et_def* et);
 struct matrix* construct_KE(struct element* e, struct et_def* et,
 			    struct list* nodes);
+KE_kernel select_KE_kernel(struct et_def* et);
+struct matrix* Affine_KE(struct et_def* et, struct matrix* COORDS);
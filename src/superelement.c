@@ -0,0 +1,347 @@
+/*
+Generation, instancing and expansion of superelements.
+
+Generation assembles the stiffness of an element group with the master
+equations numbered first, then condenses out the interior equations:
+     KR = Kmm - Kms*inv(Kss)*Ksm
+     FR = Fm - Kms*inv(Kss)*Fs
+Kss is factored once and the recovery data inv(Kss)*Ksm and inv(Kss)*Fs
+are kept so interior displacements of any instance can be expanded later.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include "lib/log.h"
+#include "lib/list.h"
+#include "lib/linalg.h"
+#include "mesh.h"
+#include "element_types.h"
+#include "bc_data.h"
+#include "model.h"
+#include "solver.h"
+#include "superelement.h"
+
+
+#define RIGID_TOL 1e-6
+
+
+/***********************************************
+ * Generation
+ */
+
+
+static int master_index(struct list* masters, int node_id){
+  int i;
+  for (i=0; i<masters->nitems; i++){
+    if (*(int*) masters->array[i] == node_id)
+      return i;
+  }
+  return -1;
+}
+
+
+static struct matrix* construct_SE_ID(struct list* nodes, int ndof,
+				      struct list* essential_bcs,
+				      struct list* masters, int* nm, int* ns){
+  // Master equations are numbered first, in the order the masters were
+  // given, followed by the interior equations.  Constrained dofs get -1.
+  // NULL if a master dof is constrained.
+  struct matrix* ID = new_matrix(nodes->nitems, ndof);
+  int i, j, m, eqn;
+  *nm = ndof*masters->nitems;
+  *ns = 0;
+  for (i=0; i<nodes->nitems; i++){
+    m = master_index(masters, i);
+    for (j=0; j<ndof; j++){
+      if (is_constrained(essential_bcs, i, j)){
+	if (m != -1){
+	  lprintf("Error: Master node %d dof %d is constrained\n", i, j);
+	  free_matrix(ID);
+	  return NULL;
+	}
+	ID->array[i][j] = -1;
+      }
+      else if (m != -1)
+	ID->array[i][j] = ndof*m+j;
+    }
+  }
+  eqn = *nm;
+  for (i=0; i<nodes->nitems; i++){
+    if (master_index(masters, i) != -1)
+      continue;
+    for (j=0; j<ndof; j++){
+      if (ID->array[i][j] != -1)
+	ID->array[i][j] = eqn++;
+    }
+  }
+  *ns = eqn - *nm;
+  return ID;
+}
+
+
+static int condense(struct superelement* se, struct matrix* K,
+		    struct vector* F){
+  // Returns 1 if the interior stiffness is singular
+  int nm = se->nm, ns = se->ns;
+  int i, j, k;
+  double sum;
+  struct matrix* Kss = new_matrix(ns, ns);
+  struct vector* col = new_vector(ns);
+  for (i=0; i<ns; i++){
+    for (j=0; j<ns; j++)
+      Kss->array[i][j] = K->array[nm+i][nm+j];
+  }
+  if (ns > 0 && luMFA(Kss) != 0){
+    lprintf("Error: Zero pivot in the superelement interior\n");
+    free_matrix(Kss), free_vector(col);
+    return 1;
+  }
+  // Recovery matrix, one column per master equation
+  se->TR = new_matrix(ns, nm);
+  for (j=0; j<nm; j++){
+    for (i=0; i<ns; i++)
+      col->array[i] = K->array[nm+i][j];
+    if (ns > 0)
+      luLSS(Kss, col);
+    for (i=0; i<ns; i++)
+      se->TR->array[i][j] = col->array[i];
+  }
+  se->US = new_vector(ns);
+  for (i=0; i<ns; i++)
+    se->US->array[i] = F->array[nm+i];
+  if (ns > 0)
+    luLSS(Kss, se->US);
+  // Condensed stiffness and load vector
+  se->KR = new_matrix(nm, nm);
+  se->FR = new_vector(nm);
+  for (i=0; i<nm; i++){
+    for (j=0; j<nm; j++){
+      sum = K->array[i][j];
+      for (k=0; k<ns; k++)
+	sum -= K->array[i][nm+k]*se->TR->array[k][j];
+      se->KR->array[i][j] = sum;
+    }
+    sum = F->array[i];
+    for (k=0; k<ns; k++)
+      sum -= K->array[i][nm+k]*se->US->array[k];
+    se->FR->array[i] = sum;
+  }
+  free_matrix(Kss), free_vector(col);
+  return 0;
+}
+
+
+struct superelement* new_superelement(int se_id, struct list* nodes,
+				      struct list* elements,
+				      struct list* et_defs,
+				      struct list* essential_bcs,
+				      struct list* nodal_forces,
+				      struct list* masters){
+  // Takes ownership of the nodes and essential boundary conditions
+  // of the generation pass.  They are needed again for expansion.
+  // NULL on failure, and they stay with the caller.
+  if (elements->nitems == 0 || masters->nitems == 0){
+    lprintf("Error: Superelement needs elements and master nodes\n");
+    return NULL;
+  }
+  if (check_et_defs(et_defs) != 0)
+    return NULL;
+  struct element* e = elements->array[0];
+  struct et_def* et = get_et_def(et_defs, e->et_id);
+  struct superelement* se = malloc(sizeof(struct superelement));
+  int i;
+  se->se_id = se_id;
+  se->ndof = et->ndof;
+  se->nmasters = masters->nitems;
+  se->masters = malloc(masters->nitems*sizeof(int));
+  for (i=0; i<masters->nitems; i++)
+    se->masters[i] = *(int*) masters->array[i];
+  se->ID = construct_SE_ID(nodes, se->ndof, essential_bcs, masters,
+			   &se->nm, &se->ns);
+  if (se->ID == NULL){
+    free(se->masters), free(se);
+    return NULL;
+  }
+  lprintf("Condensing %d interior equations to %d master equations\n",
+	 se->ns, se->nm);
+  struct matrix* K = new_matrix(se->nm+se->ns, se->nm+se->ns);
+  struct vector* F = new_vector(se->nm+se->ns);
+  precomputations(et_defs);
+  construct_K(nodes, elements, et_defs, se->ID, K, F, se->nm+se->ns,
+	      essential_bcs);
+  construct_F(nodes, nodal_forces, se->ID, F, se->ndof);
+  i = condense(se, K, F);
+  free_matrix(K), free_vector(F);
+  if (i != 0){
+    free_matrix(se->ID), free(se->masters), free(se);
+    return NULL;
+  }
+  se->nodes = nodes;
+  se->essential_bcs = essential_bcs;
+  return se;
+}
+
+
+struct superelement* get_superelement(struct list* superelements, int se_id){
+  int i;
+  struct superelement* se;
+  for (i=0; i<superelements->nitems; i++){
+    se = superelements->array[i];
+    if (se->se_id == se_id)
+      return se;
+  }
+  return NULL;
+}
+
+
+/***********************************************
+ * Instancing
+ */
+
+
+static int instance_rotation(struct superelement* se, struct matrix* COORDS,
+			     double* c, double* s){
+  // Finds the rotation taking the generation master positions onto
+  // the instance master positions.  Returns 1 if the placement is not
+  // rigid, which rigid_instance rules out as elements are created.
+  struct node *m0 = se->nodes->array[se->masters[0]], *m;
+  double X, Y, x, y, d, dmax = 0.0, theta = 0.0;
+  int i, far = 0;
+  for (i=1; i<se->nmasters; i++){
+    m = se->nodes->array[se->masters[i]];
+    d = hypot(m->x - m0->x, m->y - m0->y);
+    if (d > dmax)
+      dmax = d, far = i;
+  }
+  if (far != 0){
+    m = se->nodes->array[se->masters[far]];
+    theta = atan2(COORDS->array[1][far] - COORDS->array[1][0],
+		  COORDS->array[0][far] - COORDS->array[0][0])
+      - atan2(m->y - m0->y, m->x - m0->x);
+  }
+  *c = cos(theta), *s = sin(theta);
+  for (i=1; i<se->nmasters; i++){
+    m = se->nodes->array[se->masters[i]];
+    X = m->x - m0->x, Y = m->y - m0->y;
+    x = COORDS->array[0][i] - COORDS->array[0][0];
+    y = COORDS->array[1][i] - COORDS->array[1][0];
+    if (hypot(*c*X - *s*Y - x, *s*X + *c*Y - y) > RIGID_TOL*dmax){
+      lprintf("Error: Superelement %d instance is not a rigid placement\n",
+	     se->se_id);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+
+int rigid_instance(struct superelement* se, struct matrix* COORDS){
+  double c, s;
+  return instance_rotation(se, COORDS, &c, &s) == 0;
+}
+
+
+static struct matrix* construct_T(struct superelement* se, double c, double s){
+  // Maps instance (global) master dofs to generation frame master dofs
+  struct matrix* T = new_identity_matrix(se->nm);
+  int i;
+  if (se->ndof == 2){
+    for (i=0; i<se->nmasters; i++){
+      T->array[2*i][2*i] = c;
+      T->array[2*i][2*i+1] = s;
+      T->array[2*i+1][2*i] = -s;
+      T->array[2*i+1][2*i+1] = c;
+    }
+  }
+  return T;
+}
+
+
+struct matrix* Superelement_KE(struct superelement* se, struct matrix* COORDS){
+  double c, s;
+  instance_rotation(se, COORDS, &c, &s);
+  struct matrix* T = construct_T(se, c, s);
+  struct matrix* TT = mtranspose(T);
+  struct matrix* Q = mmmult(se->KR, T);
+  struct matrix* KE = mmmult(TT, Q);
+  free_matrix(T), free_matrix(TT), free_matrix(Q);
+  return KE;
+}
+
+
+struct vector* Superelement_FE(struct superelement* se, struct matrix* COORDS){
+  double c, s;
+  instance_rotation(se, COORDS, &c, &s);
+  struct matrix* T = construct_T(se, c, s);
+  struct matrix* TT = mtranspose(T);
+  struct vector* FE = mvmult(TT, se->FR);
+  free_matrix(T), free_matrix(TT);
+  return FE;
+}
+
+
+/***********************************************
+ * Expansion
+ */
+
+
+void expand_superelement(struct superelement* se, struct matrix* COORDS,
+			 struct vector* UE){
+  // Recovers and prints the displacements of every generation node for
+  // the instance with master displacements UE (instance frame)
+  double c, s, u[2], X, Y;
+  int i, j, P;
+  instance_rotation(se, COORDS, &c, &s);
+  struct matrix* T = construct_T(se, c, s);
+  struct vector* UM = mvmult(T, UE);
+  struct vector* TU = mvmult(se->TR, UM);
+  struct node *n, *m0 = se->nodes->array[se->masters[0]];
+  for (i=0; i<se->nodes->nitems; i++){
+    for (j=0; j<se->ndof; j++){
+      P = se->ID->array[i][j];
+      if (P == -1)
+	u[j] = get_essential_bc(se->essential_bcs, i, j);
+      else if (P < se->nm)
+	u[j] = UM->array[P];
+      else
+	u[j] = se->US->array[P-se->nm] - TU->array[P-se->nm];
+    }
+    n = se->nodes->array[i];
+    X = n->x - m0->x, Y = n->y - m0->y;
+    lprintf("Superelement node %d at (%g, %g):", i,
+	   COORDS->array[0][0] + c*X - s*Y, COORDS->array[1][0] + s*X + c*Y);
+    if (se->ndof == 2)
+      lprintf(" x deflection: %g y deflection: %g\n",
+	     c*u[0] - s*u[1], s*u[0] + c*u[1]);
+    else
+      lprintf(" value: %g\n", u[0]);
+  }
+  free_matrix(T), free_vector(UM), free_vector(TU);
+}
+
+
+void print_superelement(struct superelement* se){
+  lprintf("Superelement id: %d\n", se->se_id);
+  lprintf("\tMaster nodes: %d\n", se->nmasters);
+  lprintf("\tMaster equations: %d\n", se->nm);
+  lprintf("\tInterior equations: %d\n", se->ns);
+  lprintf("Condensed stiffness matrix:\n"), print_matrix(se->KR);
+  lprintf("Condensed load vector:\n"), print_vector(se->FR);
+}
+
+
+void free_superelement(void* se){
+  struct superelement* SE = se;
+  free(SE->masters);
+  free_items(SE->nodes, free);
+  free_list(SE->nodes);
+  free_items(SE->essential_bcs, free_essential_bc);
+  free_list(SE->essential_bcs);
+  free_matrix(SE->ID);
+  free_matrix(SE->KR);
+  free_vector(SE->FR);
+  free_matrix(SE->TR);
+  free_vector(SE->US);
+  free(SE);
+}
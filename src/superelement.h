@@ -0,0 +1,38 @@
+/*
+Superelements (substructures) built by static condensation of a group of
+elements to its master nodes.  A superelement is generated once and may
+then be instanced any number of times as a single element, each instance
+being a rigid placement (translation and rotation) of the original.
+*/
+
+struct superelement{
+  int se_id;
+  int ndof;
+  int nmasters;
+  int* masters;                // Generation node ids of the master nodes
+  int nm;                      // Number of master equations
+  int ns;                      // Number of interior equations
+  struct list* nodes;          // Generation pass nodes
+  struct list* essential_bcs;  // Generation pass constraints
+  struct matrix* ID;           // Generation node/dof -> equation number
+  struct matrix* KR;           // Condensed stiffness (nm x nm)
+  struct vector* FR;           // Condensed load vector (nm)
+  struct matrix* TR;           // Interior recovery matrix inv(Kss)*Ksm
+  struct vector* US;           // Interior displacements inv(Kss)*Fs
+};
+
+
+struct superelement* new_superelement(int se_id, struct list* nodes,
+				      struct list* elements,
+				      struct list* et_defs,
+				      struct list* essential_bcs,
+				      struct list* nodal_forces,
+				      struct list* masters);
+struct superelement* get_superelement(struct list* superelements, int se_id);
+int rigid_instance(struct superelement* se, struct matrix* COORDS);
+struct matrix* Superelement_KE(struct superelement* se, struct matrix* COORDS);
+struct vector* Superelement_FE(struct superelement* se, struct matrix* COORDS);
+void expand_superelement(struct superelement* se, struct matrix* COORDS,
+			 struct vector* UE);
+void print_superelement(struct superelement* se);
+void free_superelement(void* se);
@@ -0,0 +1,95 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include "../src/lib/linalg.h"
+#include "../src/lib/llist.h"
+#include "../src/lib/sparse_linalg.h"
+#include "../src/lib/amg.h"
+
+
+static struct csr_matrix* laplacian(int m){
+  // 5 point Laplacian on an m x m grid with Dirichlet boundaries
+  struct aol_matrix* A = new_aol_matrix(m*m, m*m);
+  struct csr_matrix* C;
+  int i, j, p;
+  for (i=0; i<m; i++){
+    for (j=0; j<m; j++){
+      p = i*m+j;
+      add_aol_element(A, p, p, 4.0);
+      if (i > 0) add_aol_element(A, p, p-m, -1.0);
+      if (i < m-1) add_aol_element(A, p, p+m, -1.0);
+      if (j > 0) add_aol_element(A, p, p-1, -1.0);
+      if (j < m-1) add_aol_element(A, p, p+1, -1.0);
+    }
+  }
+  C = aol_to_csr(A);
+  free_aol_matrix(A);
+  return C;
+}
+
+
+void test_csr_operations(){
+  // (A*A^T)*x against A*(A^T*x) for a rectangular matrix
+  printf("***Testing CSR operations\n");
+  struct aol_matrix* Aol = new_aol_matrix(3, 4);
+  struct csr_matrix *A, *At, *AAt;
+  double x[3] = {1.0, -2.0, 3.0}, y[4], z[3], w[3];
+  int i, same = 1;
+  add_aol_element(Aol, 0, 0, 1.0);
+  add_aol_element(Aol, 0, 3, 2.0);
+  add_aol_element(Aol, 1, 1, 3.0);
+  add_aol_element(Aol, 2, 0, 4.0);
+  add_aol_element(Aol, 2, 2, 5.0);
+  add_aol_element(Aol, 2, 2, 1.0);
+  A = aol_to_csr(Aol);
+  At = csr_transpose(A);
+  AAt = csr_mmmult(A, At);
+  csr_mvmult(At, x, y);
+  csr_mvmult(A, y, z);
+  csr_mvmult(AAt, x, w);
+  for (i=0; i<3; i++)
+    same = same && fabs(z[i] - w[i]) < 1e-14;
+  same = same && A->nnz == 5 && AAt->nnz == 5;
+  printf("%s\n", same ? "true" : "false");
+  free_aol_matrix(Aol);
+  free_csr_matrix(A), free_csr_matrix(At), free_csr_matrix(AAt);
+}
+
+
+void test_amg_pcg(){
+  // AMG preconditioned CG solves the Laplacian in far fewer iterations
+  // than plain CG, with the constant vector as near null space
+  printf("***Testing AMG preconditioned conjugate gradients\n");
+  int m = 40, n = m*m, i, plain, precond;
+  struct csr_matrix* A = laplacian(m);
+  struct vector *b = new_vector(n), *x = new_vector(n), *r = new_vector(n);
+  int* node = malloc(n*sizeof(int));
+  double* B = malloc(n*sizeof(double));
+  struct amg_hierarchy* H;
+  for (i=0; i<n; i++){
+    b->array[i] = 1.0;
+    node[i] = i;
+    B[i] = 1.0;
+  }
+  plain = pcgLSS(A, b, x, NULL, NULL, 1e-10, n);
+  H = new_amg_hierarchy(A, node, n, B, 1);
+  for (i=0; i<n; i++)
+    x->array[i] = 0.0;
+  precond = pcgLSS(A, b, x, amg_vcycle, H, 1e-10, n);
+  csr_mvmult(A, x->array, r->array);
+  for (i=0; i<n; i++)
+    r->array[i] -= b->array[i];
+  printf("%d plain and %d preconditioned iterations\n", plain, precond);
+  printf("%s\n", precond > 0 && 3*precond < plain &&
+	 vnorm_inf(r) < 1e-8 ? "true" : "false");
+  free_amg_hierarchy(H), free_csr_matrix(A);
+  free_vector(b), free_vector(x), free_vector(r);
+  free(node), free(B);
+}
+
+
+int main(){
+  test_csr_operations();
+  test_amg_pcg();
+  return 0;
+}
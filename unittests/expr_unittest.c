@@ -0,0 +1,29 @@
+#include <stdio.h>
+#include <math.h>
+#include "../src/expr.h"
+
+
+void test_expr(){
+  struct var_table* vars = new_var_table();
+  struct expr* e;
+  int i = define_var(vars, "i"), n = define_var(vars, "n");
+  vars->values[i] = 3.0, vars->values[n] = 4.0;
+  e = compile_expr("i*(n+1)-2^-1+sqrt(n)%2", vars);
+  printf("%s\n", e != NULL && eval_expr(e, vars->values) == 14.5 ?
+	 "true" : "false");
+  free_expr(e);
+  e = compile_expr("-n^2", vars);
+  printf("%s\n", eval_expr(e, vars->values) == -16.0 ? "true" : "false");
+  free_expr(e);
+  // Unknown variables and trailing text are not expressions
+  printf("%s\n", compile_expr("i+m", vars) == NULL &&
+	 compile_expr("res.vtu", vars) == NULL &&
+	 compile_expr("(i", vars) == NULL ? "true" : "false");
+  free_var_table(vars);
+}
+
+
+int main(){
+  test_expr();
+  return 0;
+}
@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "../src/lib/log.h"
+#include "../src/model.h"
+#include "../src/interpreter.h"
+
+// Built against the library:
+//   gcc interpreter_unittest.c ../src/libfea.a -lm -lpthread
+
+
+#define LOG_PATH "/tmp/myfea_interpreter_unittest.log"
+#define CHK_PATH "/tmp/../tmp/myfea_interpreter_unittest.chk"
+#define VTK_PATH "/tmp/./myfea_interpreter_unittest.vtk"
+
+
+static int run_text(char* text){
+  FILE* script = fmemopen(text, strlen(text), "r");
+  int status = run_script(new_model(), script);
+  fclose(script);
+  return status;
+}
+
+
+static int log_has(char* word){
+  char buffer[1000];
+  FILE* log = fopen(LOG_PATH, "r");
+  int found = 0;
+  while (!found && fgets(buffer, sizeof(buffer), log) != NULL)
+    found = strstr(buffer, word) != NULL;
+  fclose(log);
+  return found;
+}
+
+
+void test_path_arguments(){
+  // File names with operator characters are text, not failed expressions
+  char truss[] =
+    "*SET, f, 5e4\n"
+    "N, 0.0, 0.0\nN, 0.0, 3.0\nN, 3.0, 3.0\nN, 3.0, 0.0\n"
+    "ET, 1, SBAR\nR, 1, 1, 6e-4\nMP, 1, E, 2e11\n"
+    "E, 1, 0, 1\nE, 1, 0, 2\nE, 1, 0, 3\n"
+    "D, 1, ALL, 0.0\nD, 2, ALL, 0.0\nD, 3, ALL, 0.0\n"
+    "F, 0, Y, -f\nSOLVE, 0, 0\n"
+    "SAVE, " CHK_PATH "\n"
+    "OUTRES, VTK, " VTK_PATH "\n"
+    "FINISH\n";
+  char resume[] =
+    "RESUME, " CHK_PATH "\n"
+    "PRNSOL, U\n"
+    "FINISH\n";
+  FILE* log = fopen(LOG_PATH, "w");
+  int ok;
+  set_log_stream(log);
+  ok = run_text(truss) == 0 && run_text(resume) == 0;
+  set_log_stream(NULL);
+  fclose(log);
+  printf("%s\n", ok && access(CHK_PATH, F_OK) == 0 &&
+	 access(VTK_PATH, F_OK) == 0 ? "true" : "false");
+  printf("%s\n", !log_has("Warning") && !log_has("Error") &&
+	 log_has("Node 0: y deflection") ? "true" : "false");
+  unlink(CHK_PATH), unlink(VTK_PATH), unlink(LOG_PATH);
+}
+
+
+void test_keyword_arguments(){
+  // Variables named like keywords leave keyword positions alone
+  char truss[] =
+    "*SET, E, 2e11\n*SET, Y, 3.0\n*SET, ALL, 0.0\n"
+    "N, 0.0, 0.0\nN, 0.0, Y\nN, Y, Y\nN, Y, 0.0\n"
+    "ET, 1, SBAR\nR, 1, 1, 6e-4\nMP, 1, E, E\n"
+    "E, 1, 0, 1\nE, 1, 0, 2\nE, 1, 0, 3\n"
+    "D, 1, ALL, ALL\nD, 2, ALL, 0.0\nD, 3, ALL, 0.0\n"
+    "F, 0, Y, -5e4\nSOLVE, 0, 0\n"
+    "PRNSOL, U\n"
+    "FINISH\n";
+  FILE* log = fopen(LOG_PATH, "w");
+  int ok;
+  set_log_stream(log);
+  ok = run_text(truss) == 0;
+  set_log_stream(NULL);
+  fclose(log);
+  printf("%s\n", ok && !log_has("Error") &&
+	 log_has("Node 0: y deflection") ? "true" : "false");
+  unlink(LOG_PATH);
+}
+
+
+void test_invalid_numbers(){
+  // Numeric positions take no text, and integer ones no fractions
+  char undefined[] = "N, 2*q, 0\nFINISH\n";
+  char unbalanced[] = "N, 3*(1, 1\nFINISH\n";
+  char fraction[] = "N, 0, 0\nN, 1, 0\nET, 1, SBAR\n"
+    "E, 1, 0.5*3, 1\nFINISH\n";
+  char set_node[] = "N, 0, 0\nD, 1+Q, X, 0\nFINISH\n";
+  FILE* log = fopen(LOG_PATH, "w");
+  int ok;
+  set_log_stream(log);
+  ok = run_text(undefined) == 1 && run_text(unbalanced) == 1 &&
+    run_text(fraction) == 1 && run_text(set_node) == 1;
+  set_log_stream(NULL);
+  fclose(log);
+  printf("%s\n", ok && log_has("Invalid expression: 2*q") &&
+	 log_has("Integer expected for 0.5*3") ? "true" : "false");
+  unlink(LOG_PATH);
+}
+
+
+int main(){
+  test_path_arguments();
+  test_keyword_arguments();
+  test_invalid_numbers();
+  return 0;
+}
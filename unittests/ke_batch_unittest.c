@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "../src/lib/list.h"
+#include "../src/lib/linalg.h"
+#include "../src/mesh.h"
+#include "../src/element_types.h"
+#include "../src/stiffness.h"
+#include "../src/model.h"
+#include "../src/solver.h"
+#include "../src/ke_batch.h"
+
+
+double random_float(){
+  return ((double)rand())/((double)RAND_MAX);
+}
+
+
+void test_batch_KE(char* type_name, int lanes){
+  // Batched stiffness matrices must match the one at a time path
+  printf("***Testing %s batches of %d\n", type_name, lanes);
+  struct list* et_defs = new_list();
+  struct et_def* et = new_et_def(1, type_name);
+  set_real_constant(et, 1, 0.1);
+  set_matprop(et, "E", 200e9);
+  set_matprop(et, "V", 0.3);
+  set_matprop(et, "K", 45.0);
+  set_keyopt(et, 0, 1);
+  append(et_defs, et);
+  precomputations(et_defs);
+  struct list* nodes = new_list();
+  struct element* elements[KE_BATCH_MAX];
+  struct matrix* KEs[KE_BATCH_MAX];
+  struct matrix* KE;
+  int i, a, same = 1;
+  for (i=0; i<lanes; i++){
+    // Distorted unit squares
+    append(nodes, new_node(i + 0.2*random_float(), 0.2*random_float()));
+    append(nodes, new_node(i + 1.0 + 0.2*random_float(), 0.2*random_float()));
+    append(nodes, new_node(i + 1.0 + 0.2*random_float(), 1.0));
+    append(nodes, new_node(i + 0.2*random_float(), 1.0 + 0.2*random_float()));
+    int* IEN = malloc(4*sizeof(int));
+    for (a=0; a<4; a++)
+      IEN[a] = 4*i+a;
+    elements[i] = new_element(1, IEN);
+  }
+  set_ke_batch_width(lanes);
+  batch_KE(et, nodes, elements, lanes, KEs);
+  for (i=0; i<lanes; i++){
+    KE = construct_KE(elements[i], et, nodes);
+    same = same && mequal(KE, KEs[i]);
+    free_matrix(KE), free_matrix(KEs[i]), free_element(elements[i]);
+  }
+  printf("%s\n", same ? "true" : "false");
+  set_ke_batch_width(0);
+  free_items(nodes, free);
+  free_list(nodes);
+  free_et_def(et);
+  free_list(et_defs);
+}
+
+
+void test_affine_KE(char* type_name){
+  // The affine fast path must match quadrature on a parallelogram
+  printf("***Testing %s affine fast path\n", type_name);
+  struct list* et_defs = new_list();
+  struct et_def* et = new_et_def(1, type_name);
+  set_real_constant(et, 1, 0.1);
+  set_matprop(et, "E", 200e9);
+  set_matprop(et, "V", 0.3);
+  set_matprop(et, "K", 45.0);
+  set_keyopt(et, 0, 1);
+  append(et_defs, et);
+  precomputations(et_defs);
+  struct list* nodes = new_list();
+  struct element* e;
+  struct matrix *KE, *KEs[1];
+  double sx = 0.5*random_float();
+  int a, same;
+  append(nodes, new_node(0.0, 0.0));
+  append(nodes, new_node(2.0, 0.3));
+  append(nodes, new_node(2.0 + sx, 1.3));
+  append(nodes, new_node(sx, 1.0));
+  int* IEN = malloc(4*sizeof(int));
+  for (a=0; a<4; a++)
+    IEN[a] = a;
+  e = new_element(1, IEN);
+  set_ke_batch_width(1);
+  batch_KE(et, nodes, &e, 1, KEs);
+  KE = construct_KE(e, et, nodes);
+  same = mequal(KE, KEs[0]) && et->sdata->naffine == 1;
+  printf("%s\n", same ? "true" : "false");
+  set_ke_batch_width(0);
+  free_matrix(KE), free_matrix(KEs[0]), free_element(e);
+  free_items(nodes, free);
+  free_list(nodes);
+  free_et_def(et);
+  free_list(et_defs);
+}
+
+
+int main(){
+  test_batch_KE("SPLANE4", 1);
+  test_batch_KE("SPLANE4", 4);
+  test_batch_KE("SPLANE4", 8);
+  test_batch_KE("TPLANE4", 1);
+  test_batch_KE("TPLANE4", 4);
+  test_batch_KE("TPLANE4", 8);
+  test_affine_KE("SPLANE4");
+  test_affine_KE("TPLANE4");
+  return 0;
+}
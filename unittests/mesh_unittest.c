@@ -31,7 +31,28 @@ void test_mesh(){
 }
 
 
+void test_renumber_edge_map(){
+  // Nodes 3, 4 and 5 merge into 0, 1 and 2
+  struct edge_map* map = new_edge_map();
+  int* node_map = malloc(400*sizeof(int));
+  int i;
+  for (i=0; i<100; i++)
+    set_edge_node(map, 10+i, 11+i, 200+i);
+  set_edge_node(map, 0, 1, 2);
+  set_edge_node(map, 4, 3, 5);
+  for (i=0; i<400; i++)
+    node_map[i] = i < 6 ? i%3 : i;
+  renumber_edge_map(map, node_map);
+  int same = map->nitems == 101 && get_edge_node(map, 1, 0) == 2 &&
+    get_edge_node(map, 3, 4) == -1 && get_edge_node(map, 50, 51) == 240;
+  printf("%s\n", same ? "true" : "false");
+  free(node_map);
+  free_edge_map(map);
+}
+
+
 int main(){
   test_mesh();
+  test_renumber_edge_map();
   return 0;
 }
@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "../src/lib/log.h"
+#include "../src/model.h"
+
+// Built against the library:
+//   gcc model_unittest.c ../src/libfea.a -lm -lpthread
+
+
+#define NX 8
+#define NY 2
+
+
+static struct model* strip_model(double* xy, int* IEN, int copy,
+				 int bc_mode){
+  // NX x NY strip of SPLANE3 triangles, 2 x 1, in uniform tension of 1e6
+  struct model* m = new_model();
+  int left[NY+1], right[NY+1], i, j, a;
+  double f[NY+1];
+  for (j=0; j<=NY; j++){
+    for (i=0; i<=NX; i++){
+      xy[2*(j*(NX+1)+i)] = 2.0*i/NX;
+      xy[2*(j*(NX+1)+i)+1] = 1.0*j/NY;
+    }
+    left[j] = j*(NX+1), right[j] = j*(NX+1)+NX;
+    f[j] = j == 0 || j == NY ? 0.5e6/NY : 1e6/NY;
+  }
+  for (j=0; j<NY; j++){
+    for (i=0; i<NX; i++){
+      a = j*(NX+1)+i;
+      IEN[6*(j*NX+i)] = a, IEN[6*(j*NX+i)+1] = a+1;
+      IEN[6*(j*NX+i)+2] = a+NX+2, IEN[6*(j*NX+i)+3] = a;
+      IEN[6*(j*NX+i)+4] = a+NX+2, IEN[6*(j*NX+i)+5] = a+NX+1;
+    }
+  }
+  new_model_element_type(m, 1, "SPLANE3");
+  set_model_et_real_constant(m, 1, 1, 1.0);
+  set_model_et_matprop(m, 1, "E", 200e9);
+  set_model_et_matprop(m, 1, "V", 0.3);
+  add_model_nodes(m, xy, (NX+1)*(NY+1), copy);
+  add_model_elements(m, 1, IEN, 2*NX*NY, 3, copy);
+  add_model_essential_bcs(m, left, NY+1, "X", NULL);
+  add_model_essential_bcs(m, left, 1, "Y", NULL);
+  add_model_nodal_forces(m, right, NY+1, "X", f);
+  set_model_bc_mode(m, bc_mode, 0.0);
+  solve_model(m, 0, 1);
+  return m;
+}
+
+
+void test_arrays(){
+  double xy[2*(NX+1)*(NY+1)], u[2*(NX+1)*(NY+1)], R[2*(NX+1)*(NY+1)];
+  int IEN[6*NX*NY];
+  struct model* m = strip_model(xy, IEN, 0, 0);
+  double sum = 0.0;
+  int j;
+  printf("%s\n", get_model_result(m, "U", u) == 2 &&
+	 fabs(u[2*NX] - 1e-5) < 1e-15 &&
+	 fabs(u[2*((NY+1)*(NX+1)-1)] - 1e-5) < 1e-15 ? "true" : "false");
+  get_model_result(m, "RF", R);
+  for (j=0; j<=NY; j++)
+    sum += R[2*j*(NX+1)];
+  printf("%s\n", fabs(sum + 1e6) < 1e-4 ? "true" : "false");
+  // Merging copies the caller arrays, which are then free to change
+  merge_model_nodes(m, 0.0);
+  for (j=0; j<6*NX*NY; j++)
+    IEN[j] = 0;
+  solve_model(m, 0, 1);
+  get_model_result(m, "U", u);
+  printf("%s\n", fabs(u[2*NX] - 1e-5) < 1e-15 ? "true" : "false");
+  free_model(m);
+  m = strip_model(xy, IEN, 1, 0);
+  printf("%s\n", get_model_result(m, "U", u) == 2 &&
+	 fabs(u[2*NX] - 1e-5) < 1e-15 ? "true" : "false");
+  free_model(m);
+}
+
+
+void test_constraint_reactions(){
+  // Penalty and augmented Lagrange solves report the support reactions
+  double xy[2*(NX+1)*(NY+1)], R[2*(NX+1)*(NY+1)];
+  int IEN[6*NX*NY];
+  struct model* m;
+  double sum;
+  int mode, j;
+  for (mode=1; mode<=2; mode++){
+    m = strip_model(xy, IEN, 1, mode);
+    sum = 0.0;
+    if (get_model_result(m, "RF", R) == 2){
+      for (j=0; j<=NY; j++)
+	sum += R[2*j*(NX+1)];
+    }
+    printf("%s\n", fabs(sum + 1e6) < 1e-2 && fabs(R[1]) < 1e-2 &&
+	   R[2*NX] == 0.0 ? "true" : "false");
+    free_model(m);
+  }
+}
+
+
+int main(){
+  FILE* log = fopen("/dev/null", "w");
+  set_log_stream(log);
+  test_arrays();
+  test_constraint_reactions();
+  set_log_stream(NULL);
+  fclose(log);
+  return 0;
+}
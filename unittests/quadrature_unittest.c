@@ -0,0 +1,64 @@
+#include <stdio.h>
+#include <math.h>
+#include "../src/lib/quadrature.h"
+
+
+static double factorial(int n){
+  return n <= 1 ? 1.0 : n*factorial(n-1);
+}
+
+
+static double integrate(const struct quad_rule* rule, int i, int j){
+  double sum = 0.0;
+  int k;
+  for (k=0; k<rule->npts; k++)
+    sum += rule->wts[k]*pow(rule->pts[k][0], i)*pow(rule->pts[k][1], j);
+  return sum;
+}
+
+
+void test_gauss_rules(){
+  // n x n points integrate x^i*y^j exactly on [-1, 1]^2 for i, j < 2n
+  printf("***Testing Gauss-Legendre rules\n");
+  const struct quad_rule* rule;
+  double exact;
+  int n, i, j, same = 1;
+  for (n=1; n<=QUAD_MAXORDER; n++){
+    rule = gauss_rule(n);
+    same = same && rule->npts == n*n;
+    for (i=0; i<2*n; i++){
+      for (j=0; j<2*n; j++){
+	exact = (i%2 ? 0.0 : 2.0/(i+1))*(j%2 ? 0.0 : 2.0/(j+1));
+	same = same && fabs(integrate(rule, i, j) - exact) < 1e-14;
+      }
+    }
+  }
+  same = same && gauss_rule(0) == NULL && gauss_rule(QUAD_MAXORDER+1) == NULL;
+  printf("%s\n", same ? "true" : "false");
+}
+
+
+void test_triangle_rules(){
+  // Order p integrates r^i*s^j exactly on the unit triangle for i+j <= p
+  printf("***Testing triangle rules\n");
+  const struct quad_rule* rule;
+  double exact;
+  int p, i, j, same = 1;
+  for (p=1; p<=QUAD_MAXORDER; p++){
+    rule = triangle_rule(p);
+    for (i=0; i<=p; i++){
+      for (j=0; i+j<=p; j++){
+	exact = factorial(i)*factorial(j)/factorial(i+j+2);
+	same = same && fabs(integrate(rule, i, j) - exact) < 1e-15;
+      }
+    }
+  }
+  printf("%s\n", same ? "true" : "false");
+}
+
+
+int main(){
+  test_gauss_rules();
+  test_triangle_rules();
+  return 0;
+}
@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "../src/lib/log.h"
+#include "../src/server.h"
+
+// Built against the library:
+//   gcc server_unittest.c ../src/libfea.a -lm -lpthread
+
+
+#define SOCKET_PATH "/tmp/myfea_server_unittest.sock"
+#define MAXREPLY 100000
+
+
+static void* server_main(void* log){
+  set_log_stream(log);
+  run_server(SOCKET_PATH);
+  set_log_stream(NULL);
+  return NULL;
+}
+
+
+static FILE* connect_client(){
+  struct sockaddr_un addr;
+  int fd, i;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, SOCKET_PATH);
+  for (i=0; i<100; i++){
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connect(fd, (struct sockaddr*) &addr, sizeof(addr)) == 0)
+      return fdopen(fd, "r+");
+    close(fd);
+    usleep(10000);
+  }
+  return NULL;
+}
+
+
+static int send_line(FILE* client, char* line, char* reply){
+  // Returns the END status of the line, its output left in reply
+  char buffer[1000];
+  int status = -1;
+  reply[0] = '\0';
+  fprintf(client, "%s\n", line);
+  fflush(client);
+  while (fgets(buffer, sizeof(buffer), client) != NULL){
+    if (sscanf(buffer, "END %d", &status) == 1)
+      break;
+    if (strlen(reply) + strlen(buffer) < MAXREPLY)
+      strcat(reply, buffer);
+  }
+  return status;
+}
+
+
+void test_bad_lines(){
+  // Malformed lines from one client fail their command, and the model
+  // of another client still answers
+  static char reply[MAXREPLY];
+  char* truss[] = {
+    "MODEL, a", "N, 0.0, 0.0", "N, 0.0, 3.0", "N, 3.0, 3.0", "N, 3.0, 0.0",
+    "ET, 1, SBAR", "R, 1, 1, 6e-4", "MP, 1, E, 2e11",
+    "E, 1, 0, 1", "E, 1, 0, 2", "E, 1, 0, 3",
+    "D, 1, ALL, 0.0", "D, 2, ALL, 0.0", "D, 3, ALL, 0.0",
+    "F, 0, Y, -50000", "SOLVE, 0, 0"};
+  char* bad[] = {
+    "ET, 1", "KEYOPT, 1, 1", "NLSOLVE, 1", "ET, 2, SPLANE5",
+    "KEYOPT, 1, 1, 5", "R, 1, 1, 0.0", "E, 1, 0, 1, 2, 3", "D, 99, X, 0.0",
+    "DDOPT, 0", "SOLVE, 0, 2", "SOLVE, 0, 1", "PRNSOL, U"};
+  int i, n, ok;
+  FILE* a = connect_client();
+  FILE* b = connect_client();
+  ok = a != NULL && b != NULL;
+  for (i=0; ok && i<sizeof(truss)/sizeof(truss[0]); i++)
+    ok = send_line(a, truss[i], reply) == 0;
+  printf("%s\n", ok ? "true" : "false");
+  // A model left with an element type, but no elements or bcs
+  ok = send_line(b, "MODEL, b", reply) == 0 &&
+    send_line(b, "ET, 1, SPLANE4", reply) == 0;
+  for (i=0; ok && i<sizeof(bad)/sizeof(bad[0]); i++)
+    ok = send_line(b, bad[i], reply) == 1;
+  // The truss again with beams, which have no stiffness matrix
+  ok = ok && send_line(b, "MODEL, c", reply) == 0;
+  n = sizeof(truss)/sizeof(truss[0]);
+  for (i=1; ok && i<n-1; i++)
+    ok = send_line(b, strcmp(truss[i], "ET, 1, SBAR") == 0 ?
+		   "ET, 1, SBEAM" : truss[i], reply) == 0;
+  ok = ok && send_line(b, truss[n-1], reply) == 1;
+  printf("%s\n", ok ? "true" : "false");
+  ok = send_line(a, "PRNSOL, U", reply) == 0 &&
+    strstr(reply, "Node 0: y deflection") != NULL;
+  printf("%s\n", ok ? "true" : "false");
+  send_line(b, "SHUTDOWN", reply);
+  fclose(a), fclose(b);
+}
+
+
+int main(){
+  pthread_t server;
+  FILE* log = fopen("/dev/null", "w");
+  set_log_stream(log);
+  pthread_create(&server, NULL, server_main, log);
+  test_bad_lines();
+  pthread_join(server, NULL);
+  set_log_stream(NULL);
+  fclose(log);
+  return 0;
+}
@@ -1,3 +1,7 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include "../src/lib/linalg.h"
 #include "../src/lib/sparse_linalg.h"
 
 
@@ -16,7 +20,42 @@ void test_aol_matrix(){
 }
 
 
+void test_skyline(){
+  // LDL^T in skyline storage against the dense LU solution, on a
+  // symmetric positive definite matrix with a ragged profile
+  printf("***Testing skyline LDL^T factorization\n");
+  int n = 6, i, j, same = 1;
+  int first[6] = {0, 0, 1, 0, 2, 3};
+  struct aol_matrix* Aol = new_aol_matrix(n, n);
+  struct matrix* A = new_matrix(n, n);
+  struct vector *b = new_vector(n), *x;
+  struct csr_matrix* C;
+  struct skyline_matrix* S = new_skyline_matrix(n, first);
+  for (j=0; j<n; j++){
+    for (i=first[j]; i<=j; i++){
+      A->array[i][j] = A->array[j][i] = i == j ? 10.0+j : 1.0+0.5*(i+j);
+      add_aol_element(Aol, i, j, A->array[i][j]);
+      if (i != j)
+	add_aol_element(Aol, j, i, A->array[i][j]);
+    }
+    b->array[j] = 1.0 - j;
+  }
+  C = aol_to_csr(Aol);
+  skyline_scatter(S, C, S->vals);
+  x = copy_vector(b);
+  luMFA(A), luLSS(A, b);
+  same = ldltMFA(S) == 0 && S->size == 15;
+  ldltLSS(S, x);
+  for (i=0; i<n; i++)
+    same = same && fabs(x->array[i] - b->array[i]) < 1e-14;
+  printf("%s\n", same ? "true" : "false");
+  free_aol_matrix(Aol), free_csr_matrix(C), free_skyline_matrix(S);
+  free_matrix(A), free_vector(b), free_vector(x);
+}
+
+
 int main(){
   test_aol_matrix();
+  test_skyline();
   return 0;
 }